@@ -0,0 +1,286 @@
+#pragma once
+
+// 协程接口需要C++20, 低于C++20编译时本文件为空, 不影响C++14的构建
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "safe_map.h"
+
+/*
+    * @brief 执行器: 把任务放到执行器的线程上运行, 不能在调用线程上直接运行任务
+*/
+using AsyncExecutor = std::function<void(std::function<void()>)>;
+
+/*
+    * @brief 协程互斥锁: 获取失败时挂起协程而不是阻塞线程, 释放时把锁直接交给队首的等待者
+    * 等待者的后续操作投递回它自己的执行器, 不在释放锁的线程上运行, 释放锁的协程不会被其他协程的工作拖住
+*/
+class AsyncMutex {
+public:
+    AsyncMutex() : _locked(false) {}
+
+    AsyncMutex(const AsyncMutex&) = delete;
+    AsyncMutex& operator=(const AsyncMutex&) = delete;
+
+    bool try_lock() {
+        std::lock_guard<std::mutex> lock(_queue_mutex);
+
+        if (_locked) {
+            return false;
+        }
+        _locked = true;
+        return true;
+    }
+
+    /*
+        * @brief 加入等待队列
+        * @param resume 获得锁后调用, 应把协程的后续操作投递到它的执行器
+        * @return 已入队返回true; 锁恰好已释放时直接获得锁并返回false, 不会调用resume
+    */
+    bool lock_or_enqueue(std::function<void()> resume) {
+        std::lock_guard<std::mutex> lock(_queue_mutex);
+
+        if (!_locked) {
+            _locked = true;
+            return false;
+        }
+        _waiters.push_back(std::move(resume));
+        return true;
+    }
+
+    /*
+        * @brief 释放锁, 有等待者时锁的所有权直接交给队首的等待者
+    */
+    void unlock() {
+        std::function<void()> next;
+        {
+            std::lock_guard<std::mutex> lock(_queue_mutex);
+
+            if (_waiters.empty()) {
+                _locked = false;
+                return;
+            }
+            next = std::move(_waiters.front());
+            _waiters.pop_front();
+        }
+        next();
+    }
+
+private:
+    std::mutex _queue_mutex;
+    bool _locked;
+    std::deque<std::function<void()>> _waiters;
+};
+
+/*
+    * @brief SafeMap的协程接口, co_await map.async_get(key) 等操作不会阻塞执行器线程
+    * 协程之间通过AsyncMutex排队, 拿到锁的协程调用SafeMap的try_*接口; _mutex被同步调用者或tick线程占用时,
+    * 协程保持挂起, 后续操作停放在等待线程上, 等待线程阻塞到_mutex释放后才把重试投递回执行器, 执行器线程不会反复重试
+    * 协程总是在执行器的线程上恢复; 不拥有SafeMap, 生命周期不能超过SafeMap, 析构前所有操作都应已完成
+*/
+template<typename K, typename V>
+class AsyncSafeMap {
+public:
+    AsyncSafeMap(SafeMap<K, V>& map, AsyncExecutor executor) : _map(map), _executor(std::move(executor)), _stopping(false) {}
+
+    AsyncSafeMap(const AsyncSafeMap&) = delete;
+    AsyncSafeMap& operator=(const AsyncSafeMap&) = delete;
+
+    ~AsyncSafeMap() {
+        {
+            std::lock_guard<std::mutex> lock(_park_mutex);
+
+            _stopping = true;
+        }
+        _park_cv.notify_all();
+        if (_unlock_waiter.joinable()) {
+            _unlock_waiter.join();
+        }
+    }
+
+    /*
+        * @brief 持有AsyncMutex时执行func(map, result)的awaitable, 结果由co_await返回
+        * func返回false表示_mutex被占用, 等_mutex释放后在执行器上重试
+    */
+    template<typename Result, typename Func>
+    class Operation {
+    public:
+        Operation(AsyncSafeMap& owner, Func func) : _owner(owner), _func(std::move(func)), _holding(false) {}
+
+        // 锁都空闲时不挂起
+        bool await_ready() {
+            _holding = _owner._mutex.try_lock();
+            return _holding && try_run();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            _handle = handle;
+            if (!_holding) {
+                if (_owner._mutex.lock_or_enqueue([this] { post_attempt(); })) {
+                    // 入队后其他线程随时可能恢复协程, 不能再访问成员
+                    return true;
+                }
+                if (try_run()) {
+                    return false;
+                }
+            }
+            // 持有AsyncMutex但_mutex被占用(await_ready中已尝试过), 停放到_mutex释放
+            park();
+            return true;
+        }
+
+        Result await_resume() {
+            if (_exception) {
+                std::rethrow_exception(_exception);
+            }
+            return std::move(_result);
+        }
+
+    private:
+        /*
+            * @brief 持有AsyncMutex时尝试一次, 完成后释放AsyncMutex
+            * @return 完成返回true, _mutex被占用返回false
+        */
+        bool try_run() {
+            bool done = true;
+            try {
+                done = _func(_owner._map, _result);
+            } catch (...) {
+                _exception = std::current_exception();
+            }
+            if (done) {
+                _owner._mutex.unlock();
+            }
+            return done;
+        }
+
+        /*
+            * @brief 持有AsyncMutex时在执行器上尝试一次, _mutex仍被占用时重新停放
+        */
+        void post_attempt() {
+            _owner._executor([this] {
+                if (try_run()) {
+                    _handle.resume();
+                } else {
+                    park();
+                }
+            });
+        }
+
+        void park() {
+            _owner.park_until_unlocked([this] { post_attempt(); });
+        }
+
+        AsyncSafeMap& _owner;
+        Func _func;
+        bool _holding;
+        std::coroutine_handle<> _handle;
+        Result _result;
+        std::exception_ptr _exception;
+    };
+
+    /*
+        * @brief 在持有AsyncMutex时调用SafeMap的try_*接口
+        * @param func bool(SafeMap<K, V>&, Result&), 获得_mutex并完成时返回true, _mutex被占用时返回false
+    */
+    template<typename Result, typename Func>
+    Operation<Result, Func> async_call(Func func) {
+        return Operation<Result, Func>(*this, std::move(func));
+    }
+
+    auto async_insert(K key, V value, int expire_time_interval = -1) {
+        return async_call<bool>([key = std::move(key), value = std::move(value), expire_time_interval](SafeMap<K, V>& map, bool& inserted) {
+            return map.try_insert(key, value, expire_time_interval, inserted);
+        });
+    }
+
+    auto async_get(K key) {
+        return async_call<std::optional<V>>([key = std::move(key)](SafeMap<K, V>& map, std::optional<V>& result) {
+            V value;
+            bool found = false;
+            if (!map.try_get_by_key(key, value, found)) {
+                return false;
+            }
+            result = found ? std::optional<V>(std::move(value)) : std::nullopt;
+            return true;
+        });
+    }
+
+    auto async_erase(K key) {
+        return async_call<bool>([key = std::move(key)](SafeMap<K, V>& map, bool& erased) {
+            return map.try_erase_by_key(key, erased);
+        });
+    }
+
+    auto async_get_by_time_range(TimeStamp start_time, TimeStamp end_time, bool asc = true) {
+        return async_call<std::vector<KeyValue<K, V>>>([start_time, end_time, asc](SafeMap<K, V>& map, std::vector<KeyValue<K, V>>& result) {
+            return map.try_get_by_time_range(start_time, end_time, asc, result);
+        });
+    }
+
+private:
+    /*
+        * @brief 停放一个后续操作, 等待线程在_mutex释放后调用它; 等待线程在第一次停放时创建
+        * @param resume 后续操作, 应把重试投递到执行器
+    */
+    void park_until_unlocked(std::function<void()> resume) {
+        {
+            std::lock_guard<std::mutex> lock(_park_mutex);
+
+            _parked.push_back(std::move(resume));
+            if (!_unlock_waiter.joinable()) {
+                _unlock_waiter = std::thread([this] { loop_unlock_waiter(); });
+            }
+        }
+        _park_cv.notify_one();
+    }
+
+    /*
+        * @brief 等待线程: 有停放的后续操作时阻塞到_mutex空闲, 然后全部取出调用
+        * _mutex可能在重试前又被占用, 此时重试失败会再次停放, 每次_mutex释放最多重试一轮
+    */
+    void loop_unlock_waiter() {
+        std::unique_lock<std::mutex> lock(_park_mutex);
+        while (true) {
+            _park_cv.wait(lock, [this] {
+                return _stopping || !_parked.empty();
+            });
+            if (_stopping) {
+                break;
+            }
+            std::deque<std::function<void()>> parked;
+            parked.swap(_parked);
+            lock.unlock();
+            _map.wait_for_unlock();
+            for (auto& resume : parked) {
+                resume();
+            }
+            lock.lock();
+        }
+    }
+
+    SafeMap<K, V>& _map;
+    AsyncExecutor _executor;
+    AsyncMutex _mutex;
+
+    // 保护_parked和_stopping
+    std::mutex _park_mutex;
+    std::condition_variable _park_cv;
+    // 等待_mutex释放的后续操作; 只有持有AsyncMutex的协程会停放, 通常最多一个
+    std::deque<std::function<void()>> _parked;
+    bool _stopping;
+    // 等待线程, 第一次停放时创建
+    std::thread _unlock_waiter;
+};
+
+#endif
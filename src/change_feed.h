@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "change_record.h"
+
+const size_t kDefaultChangeFeedCapacity = 1 << 16; // 默认变更环形缓冲区大小
+
+/*
+    * @brief 变更流中的一条记录, publish_time用于计算复制延迟
+*/
+template<typename K, typename V>
+struct ChangeFeedRecord {
+    ChangeRecord<K, V> record;
+    TimeStamp publish_time;
+};
+
+/*
+    * @brief 读取变更流的结果
+    * kOk 读取成功, 可能没有新记录
+    * kLagged 需要的记录已被覆盖或流已被重置, 消费者需要先通过快照重新同步
+*/
+enum class ChangeFeedStatus {
+    kOk,
+    kLagged,
+};
+
+/*
+    * @brief 变更环形缓冲区, 单生产者(SafeMap在持有_mutex时发布)多消费者
+    * 消费者不加锁读取, 各自维护读取位置, 落后超过容量时返回kLagged
+*/
+template<typename K, typename V>
+class ChangeFeed {
+public:
+    using RecordPtr = std::shared_ptr<const ChangeFeedRecord<K, V>>;
+
+    explicit ChangeFeed(size_t capacity)
+        : _slots(capacity)
+        , _head(0)
+        , _base(0)
+        , _waiters(0) {}
+
+    /*
+        * @brief 发布一条记录, record.sequence必须比上一条大1
+        * @param record 记录
+    */
+    void publish(RecordPtr record) {
+        uint64_t sequence = record->record.sequence;
+        std::atomic_store(&_slots[sequence % _slots.size()], std::move(record));
+        _head.store(sequence);
+
+        if (_waiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(_wait_mutex);
+            _wait_cv.notify_all();
+        }
+    }
+
+    /*
+        * @brief 重置变更流, 之后的第一条记录序号为sequence + 1, 所有消费者都需要重新同步
+        * @param sequence 当前最后一条变更的序号
+    */
+    void reset(uint64_t sequence) {
+        _base.store(sequence);
+        _head.store(sequence);
+    }
+
+    /*
+        * @brief 读取从from_sequence开始的最多max_count条记录
+        * @param from_sequence 第一条要读取的记录序号
+        * @param max_count 最多读取的条数
+        * @param records 输出记录, 追加在末尾
+        * @return kOk 或 kLagged
+    */
+    ChangeFeedStatus read(uint64_t from_sequence, size_t max_count, std::vector<RecordPtr>& records) const {
+        uint64_t head = _head.load();
+        uint64_t base = _base.load();
+        // 请求的位置超出已发布的范围说明流被重置过
+        if (from_sequence <= base || from_sequence > head + 1 || head - from_sequence + 1 > _slots.size()) {
+            return ChangeFeedStatus::kLagged;
+        }
+
+        for (uint64_t sequence = from_sequence; sequence <= head && records.size() < max_count; ++sequence) {
+            auto record = std::atomic_load(&_slots[sequence % _slots.size()]);
+            // 读取期间被生产者覆盖
+            if (!record || record->record.sequence != sequence) {
+                return ChangeFeedStatus::kLagged;
+            }
+            records.push_back(std::move(record));
+        }
+        return ChangeFeedStatus::kOk;
+    }
+
+    /*
+        * @brief 等待序号为sequence的记录发布, 超时返回
+        * @param sequence 等待的记录序号
+        * @param timeout_ms 超时时间, 单位ms
+        * @return 记录已发布返回true, 超时返回false
+    */
+    bool wait(uint64_t sequence, int timeout_ms) {
+        _waiters.fetch_add(1);
+        bool published;
+        {
+            std::unique_lock<std::mutex> lock(_wait_mutex);
+            published = _wait_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, sequence] {
+                return _head.load() >= sequence;
+            });
+        }
+        _waiters.fetch_sub(1);
+        return published;
+    }
+
+    /*
+        * @brief 最后一条已发布记录的序号
+    */
+    uint64_t head() const {
+        return _head.load();
+    }
+
+private:
+    // 按 sequence % capacity 存放记录, 通过std::atomic_load/atomic_store访问
+    std::vector<RecordPtr> _slots;
+
+    // 最后一条已发布记录的序号
+    std::atomic<uint64_t> _head;
+
+    // 重置时的序号, 不大于该序号的记录不可读
+    std::atomic<uint64_t> _base;
+
+    // 等待新记录的消费者, 没有等待者时发布不需要加锁
+    std::atomic<int> _waiters;
+    std::mutex _wait_mutex;
+    std::condition_variable _wait_cv;
+};
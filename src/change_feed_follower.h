@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "safe_map.h"
+
+const size_t kFollowerBatchSize = 1024; // 每次从变更流读取的最大记录数
+const int kFollowerWaitMs = 100; // 没有新记录时的等待时间, 单位ms
+
+/*
+    * @brief 变更流的消费者, 把primary的变更按序应用到replica
+    * 启动时以及落后超过环形缓冲区容量时, 通过primary的快照重新同步
+*/
+template<typename K, typename V>
+class ChangeFeedFollower {
+public:
+    /*
+        * @brief 构造时启动同步线程, primary需要已经开启变更流
+        * @param primary 被复制的map
+        * @param replica 副本, 原有数据会被替换
+    */
+    ChangeFeedFollower(SafeMap<K, V>& primary, SafeMap<K, V>& replica)
+        : _primary(primary)
+        , _replica(replica)
+        , _applied_sequence(0)
+        , _lag_us(0)
+        , _resync_count(0)
+        , _is_running(true) {
+        _follow_thread = std::thread([this]{loop_follow();});
+    }
+
+    ChangeFeedFollower(const ChangeFeedFollower&) = delete;
+    ChangeFeedFollower& operator=(const ChangeFeedFollower&) = delete;
+
+    ~ChangeFeedFollower() {
+        _is_running = false;
+        _follow_thread.join();
+    }
+
+    /*
+        * @brief 已应用到replica的最后一条变更的序号
+    */
+    uint64_t applied_sequence() const {
+        return _applied_sequence.load();
+    }
+
+    /*
+        * @brief 最近一批变更从primary发布到应用到replica的延迟, 单位us
+    */
+    int64_t lag_us() const {
+        return _lag_us.load();
+    }
+
+    /*
+        * @brief 通过快照重新同步的次数, 包括启动时的第一次
+    */
+    int resync_count() const {
+        return _resync_count.load();
+    }
+
+private:
+    void loop_follow() {
+        auto feed = _primary.get_change_feed();
+        if (!feed) {
+            return;
+        }
+
+        resync();
+        std::vector<typename ChangeFeed<K, V>::RecordPtr> records;
+        while (_is_running) {
+            uint64_t next = _applied_sequence.load() + 1;
+            records.clear();
+            if (feed->read(next, kFollowerBatchSize, records) == ChangeFeedStatus::kLagged) {
+                resync();
+                continue;
+            }
+            if (records.empty()) {
+                feed->wait(next, kFollowerWaitMs);
+                continue;
+            }
+
+            for (auto& record : records) {
+                _replica.apply_change(record->record);
+            }
+            auto now = std::chrono::system_clock::now();
+            _lag_us = std::chrono::duration_cast<std::chrono::microseconds>(now - records.back()->publish_time).count();
+            _applied_sequence = records.back()->record.sequence;
+        }
+    }
+
+    /*
+        * @brief 复制primary的全部数据到replica, 之后从快照对应的序号继续读取变更流
+    */
+    void resync() {
+        std::vector<KeyValue<K, V>> entries;
+        uint64_t sequence = _primary.snapshot_for_replication(entries);
+        _replica.restore_entries(std::move(entries), sequence);
+        _applied_sequence = sequence;
+        ++_resync_count;
+    }
+
+    SafeMap<K, V>& _primary;
+    SafeMap<K, V>& _replica;
+
+    std::atomic<uint64_t> _applied_sequence;
+    std::atomic<int64_t> _lag_us;
+    std::atomic<int> _resync_count;
+
+    std::thread _follow_thread;
+    std::atomic<bool> _is_running;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "key_value.h"
+#include "snapshot.h"
+
+/*
+    * @brief 数据变更类型
+    * kInsert 插入一条完整的数据, 已存在的key会被替换
+    * kErase 删除key
+    * kSetExpire 原地修改过期时间
+    * kExpire 数据过期被删除
+*/
+enum class ChangeType : uint8_t {
+    kInsert = 1,
+    kErase = 2,
+    kSetExpire = 3,
+    kExpire = 4,
+};
+
+/*
+    * @brief 一条数据变更, sequence在SafeMap内严格递增
+    * kErase/kExpire 只使用key, kSetExpire 不使用value和insert_time
+*/
+template<typename K, typename V>
+struct ChangeRecord {
+    uint64_t sequence;
+    ChangeType type;
+    K key;
+    V value;
+    TimeStamp insert_time;
+    TimeStamp expire_time;
+    int expire_time_interval;
+};
+
+/*
+    * @brief 序列化一条变更, 格式为 sequence type insert_time expire_time expire_time_interval key [value]
+    * 直接从KeyValue编码, 避免在锁内复制key和value
+    * @param out 输出
+    * @param sequence 变更序号
+    * @param type 变更类型
+    * @param map_value 变更后的数据, kErase/kExpire时为被删除的数据
+*/
+template<typename KeySerializer, typename ValueSerializer, typename K, typename V>
+void write_change_record(std::string& out, uint64_t sequence, ChangeType type, const KeyValue<K, V>& map_value) {
+    Serializer<uint64_t>::write(out, sequence);
+    Serializer<uint8_t>::write(out, static_cast<uint8_t>(type));
+    Serializer<int64_t>::write(out, to_nanoseconds(map_value.get_insert_time()));
+    Serializer<int64_t>::write(out, to_nanoseconds(map_value.get_expire_time()));
+    Serializer<int32_t>::write(out, map_value.get_expire_time_interval());
+    KeySerializer::write(out, map_value.get_key());
+    if (type == ChangeType::kInsert) {
+        ValueSerializer::write(out, map_value.get_value());
+    }
+}
+
+/*
+    * @brief 反序列化一条变更
+    * @param data 读取位置, 成功后指向下一条数据
+    * @param end 数据结尾
+    * @param record 输出变更
+    * @return 成功返回true, 数据不完整返回false
+*/
+template<typename KeySerializer, typename ValueSerializer, typename K, typename V>
+bool read_change_record(const char*& data, const char* end, ChangeRecord<K, V>& record) {
+    uint8_t type;
+    int64_t insert_time;
+    int64_t expire_time;
+    int32_t expire_time_interval;
+    if (!Serializer<uint64_t>::read(data, end, record.sequence) || !Serializer<uint8_t>::read(data, end, type)
+        || !Serializer<int64_t>::read(data, end, insert_time) || !Serializer<int64_t>::read(data, end, expire_time)
+        || !Serializer<int32_t>::read(data, end, expire_time_interval) || !KeySerializer::read(data, end, record.key)) {
+        return false;
+    }
+    record.type = static_cast<ChangeType>(type);
+    record.insert_time = from_nanoseconds(insert_time);
+    record.expire_time = from_nanoseconds(expire_time);
+    record.expire_time_interval = expire_time_interval;
+    if (record.type == ChangeType::kInsert) {
+        return ValueSerializer::read(data, end, record.value);
+    }
+    return true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lz_codec.h"
+
+const uint64_t kColdReadMergeGap = 4096; // 批量读取时间隔不超过该字节数的相邻记录合并为一次pread
+
+const uint8_t kColdRecordRaw = 0; // 冷数据记录未压缩
+const uint8_t kColdRecordLz = 1; // 冷数据记录经过LzCodec压缩
+
+struct ColdTierOptions {
+    std::shared_ptr<const LzCodec> codec; // 冷数据的压缩编解码器, 为空时不压缩
+    size_t compress_threshold = 512; // 序列化后不小于该字节数的value才压缩, 单位字节
+};
+
+/*
+    * @brief 冷存储统计, 用于评估压缩率和压缩/解压的CPU开销
+*/
+struct ColdTierStats {
+    uint64_t spilled_count = 0; // 转移到冷存储的数据条数
+    uint64_t raw_bytes = 0; // value序列化后的总大小
+    uint64_t stored_bytes = 0; // 实际写入文件的总大小
+    uint64_t compressed_count = 0; // 被压缩的数据条数
+    uint64_t compress_ns = 0; // 压缩总耗时
+    uint64_t decompress_count = 0; // 解压次数
+    uint64_t decompress_ns = 0; // 解压总耗时
+};
+
+/*
+    * @brief 冷数据的只追加存储文件, 只保存序列化后的value, 偏移和长度由内存中的节点记录
+    * append 之间互斥; read 使用pread, 可以在任意线程并发调用
+*/
+class ColdStore {
+public:
+    ColdStore() : _fd(-1), _end(0) {}
+
+    ColdStore(const ColdStore&) = delete;
+    ColdStore& operator=(const ColdStore&) = delete;
+
+    ~ColdStore() {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    /*
+        * @brief 创建存储文件, 已存在的文件会被清空, 冷数据只在本次运行中有效
+        * @param path 文件路径
+        * @return 成功返回true, 否则返回false
+    */
+    bool open(const std::string& path) {
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        return _fd >= 0;
+    }
+
+    /*
+        * @brief 追加一批数据到文件末尾
+        * @param data 数据
+        * @param offset 输出数据在文件中的起始偏移
+        * @return 成功返回true, 否则返回false
+    */
+    bool append(const std::string& data, uint64_t& offset) {
+        std::lock_guard<std::mutex> lock(_append_mutex);
+
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::pwrite(_fd, data.data() + written, data.size() - written, _end + written);
+            if (n < 0) {
+                return false;
+            }
+            written += n;
+        }
+        offset = _end;
+        _end += data.size();
+        return true;
+    }
+
+    /*
+        * @brief 读取一条数据
+        * @param offset 偏移
+        * @param size 长度
+        * @param out 输出
+        * @return 成功返回true, 否则返回false
+    */
+    bool read(uint64_t offset, uint32_t size, std::string& out) const {
+        out.resize(size);
+        return read_fully(offset, &out[0], size);
+    }
+
+    /*
+        * @brief 批量读取, 偏移相近的记录合并为一次pread
+        * @param ranges 每条记录的偏移和长度, 需要按偏移从小到大排列
+        * @param out 输出, 与ranges一一对应
+        * @return 全部读取成功返回true, 否则返回false
+    */
+    bool read_batch(const std::vector<std::pair<uint64_t, uint32_t>>& ranges, std::vector<std::string>& out) const {
+        out.resize(ranges.size());
+        std::string span;
+        size_t first = 0;
+        while (first < ranges.size()) {
+            uint64_t start = ranges[first].first;
+            uint64_t end = start + ranges[first].second;
+            size_t last = first + 1;
+            while (last < ranges.size() && ranges[last].first <= end + kColdReadMergeGap) {
+                end = std::max(end, ranges[last].first + ranges[last].second);
+                ++last;
+            }
+
+            span.resize(end - start);
+            if (!read_fully(start, &span[0], span.size())) {
+                return false;
+            }
+            for (size_t i = first; i < last; ++i) {
+                out[i].assign(span, ranges[i].first - start, ranges[i].second);
+            }
+            first = last;
+        }
+        return true;
+    }
+
+    /*
+        * @brief 文件中已写入的字节数, 包括已被删除或替换的数据
+    */
+    uint64_t size() {
+        std::lock_guard<std::mutex> lock(_append_mutex);
+
+        return _end;
+    }
+
+private:
+    bool read_fully(uint64_t offset, char* data, size_t size) const {
+        size_t read_size = 0;
+        while (read_size < size) {
+            ssize_t n = ::pread(_fd, data + read_size, size - read_size, offset + read_size);
+            if (n <= 0) {
+                return false;
+            }
+            read_size += n;
+        }
+        return true;
+    }
+
+    int _fd;
+
+    // 文件末尾, 由_append_mutex保护
+    uint64_t _end;
+    std::mutex _append_mutex;
+};
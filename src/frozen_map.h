@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "key_value.h"
+
+const size_t kFrozenBucketLoad = 4; // 完美哈希平均每个桶的key个数
+const uint32_t kFrozenMaxSeed = 65535; // 每个桶尝试的种子上限, 种子用uint16保存
+const int kFrozenMaxAttempts = 8; // 构建失败时更换全局盐值重试的次数
+const size_t kFrozenSlotLoad = 99; // 下标数组的装载率(%), 留少量空位使最后的桶也能很快找到种子
+
+/*
+    * @brief 只读的SafeMap快照, 构建后不再修改, 所有读取都不加锁, 可以在任意线程并发调用
+    * 数据按insert_time从小到大平铺在数组中; key通过完美哈希(CHD, hash and displace)映射到下标, 再由下标找到数组中的位置
+    * 下标数组装载率为kFrozenSlotLoad%, 每个key约占4字节下标和 2/kFrozenBucketLoad 字节的桶种子, 不保存哈希表节点
+    * 过期在读取时判断, 已过期的数据不会被返回但仍占用空间
+*/
+template<typename K, typename V, typename Hash = std::hash<K>>
+class FrozenMap {
+    using SystemClock = std::chrono::system_clock;
+
+public:
+    FrozenMap() : _salt(0) {}
+
+    /*
+        * @brief 从一组数据构建, 替换原有内容
+        * @param entries 数据, 需要按insert_time从小到大排列, key不能重复
+        * @return 构建成功返回true; key重复或哈希值完全相同导致无法构建时返回false, 原有内容不变
+    */
+    bool build(std::vector<KeyValue<K, V>> entries) {
+        std::vector<Entry> flat;
+        flat.reserve(entries.size());
+        for (auto& entry : entries) {
+            flat.push_back(Entry{entry.get_key(), entry.get_value(), entry.get_insert_time(), entry.get_expire_time(),
+                                 entry.get_expire_time_interval()});
+        }
+
+        std::vector<uint16_t> seeds;
+        std::vector<uint32_t> slots;
+        for (int attempt = 0; attempt < kFrozenMaxAttempts; ++attempt) {
+            uint64_t salt = mix(0x9e3779b97f4a7c15ULL * (attempt + 1));
+            int result = build_perfect_hash(flat, salt, seeds, slots);
+            if (result == kBuildDuplicate) {
+                return false;
+            }
+            if (result == kBuildOk) {
+                _entries.swap(flat);
+                _seeds.swap(seeds);
+                _slots.swap(slots);
+                _salt = salt;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+        * @brief 获取某个key的值
+        * @param key 键
+        * @param value 值
+        * @return 存在且未过期返回true, 否则返回false
+    */
+    bool get_by_key(const K& key, V& value) const {
+        const Entry* entry = find(key);
+        if (entry == nullptr || is_expire(*entry)) {
+            return false;
+        }
+        value = entry->value;
+        return true;
+    }
+
+    /*
+        * @brief 获取某个时间范围内的数据
+        * @param start_time 起始时间
+        * @param end_time 结束时间
+        * @param asc 是否按照插入时间升序排列
+        * @return 返回某个时间范围内未过期的数据
+    */
+    std::vector<KeyValue<K, V>> get_by_time_range(const TimeStamp& start_time, const TimeStamp& end_time, bool asc = true) const {
+        if (start_time > end_time) {
+            return {};
+        }
+
+        auto low = std::lower_bound(_entries.begin(), _entries.end(), start_time, [](const Entry& entry, const TimeStamp& time) {
+            return entry.insert_time < time;
+        });
+        auto high = std::upper_bound(_entries.begin(), _entries.end(), end_time, [](const TimeStamp& time, const Entry& entry) {
+            return time < entry.insert_time;
+        });
+
+        std::vector<KeyValue<K, V>> result;
+        for (auto it = low; it != high; ++it) {
+            if (!is_expire(*it)) {
+                result.push_back(to_key_value(*it));
+            }
+        }
+        if (!asc) {
+            std::reverse(result.begin(), result.end());
+        }
+        return result;
+    }
+
+    /*
+        * @brief 获取insert_time最大或最小前的N条数据
+        * @param n N
+        * @param asc 是否按照插入时间升序排列
+        * @return 返回N条未过期的数据
+    */
+    std::vector<KeyValue<K, V>> get_by_order(int n, bool asc = true) const {
+        std::vector<KeyValue<K, V>> result;
+        auto lambda = [&result, n](const Entry& entry) {
+            if (!is_expire(entry)) {
+                result.push_back(to_key_value(entry));
+            }
+            return static_cast<int>(result.size()) < n;
+        };
+
+        if (asc) {
+            for (auto it = _entries.begin(); it != _entries.end() && lambda(*it); ++it) {}
+        } else {
+            for (auto it = _entries.rbegin(); it != _entries.rend() && lambda(*it); ++it) {}
+        }
+        return result;
+    }
+
+    /*
+        * @brief 数据条数, 包括已过期的数据
+    */
+    size_t size() const {
+        return _entries.size();
+    }
+
+    /*
+        * @brief 占用的字节数, 不包括K和V自身在堆上分配的内存
+    */
+    size_t memory_usage() const {
+        return _entries.capacity() * sizeof(Entry) + _seeds.capacity() * sizeof(uint16_t) + _slots.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    struct Entry {
+        K key;
+        V value;
+        TimeStamp insert_time;
+        TimeStamp expire_time;
+        int expire_time_interval;
+    };
+
+    enum BuildResult {
+        kBuildOk,
+        kBuildRetry, // 某个桶找不到种子, 更换盐值重试
+        kBuildDuplicate, // key重复或哈希值完全相同, 无法构建
+    };
+
+    static uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    uint64_t key_hash(const K& key, uint64_t salt) const {
+        return mix(static_cast<uint64_t>(Hash()(key)) ^ salt);
+    }
+
+    static size_t slot_of(uint64_t hash, uint32_t seed, size_t slot_count) {
+        return mix(hash + seed * 0x9e3779b97f4a7c15ULL) % slot_count;
+    }
+
+    /*
+        * @brief 先按桶分组, 从大到小为每个桶寻找一个种子, 使桶内所有key都落在未占用的下标上
+        * @param entries 数据
+        * @param salt 全局盐值
+        * @param seeds 输出每个桶的种子
+        * @param slots 输出每个下标对应的数据位置
+        * @return BuildResult
+    */
+    int build_perfect_hash(const std::vector<Entry>& entries, uint64_t salt, std::vector<uint16_t>& seeds, std::vector<uint32_t>& slots) const {
+        size_t count = entries.size();
+        size_t bucket_count = std::max<size_t>(1, (count + kFrozenBucketLoad - 1) / kFrozenBucketLoad);
+        size_t slot_count = count * 100 / kFrozenSlotLoad + 1;
+        seeds.assign(bucket_count, 0);
+        // 空位指向任意数据, 查找时比较key
+        slots.assign(slot_count, 0);
+        if (count == 0) {
+            return kBuildOk;
+        }
+
+        std::vector<uint64_t> hashes(count);
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = key_hash(entries[i].key, salt);
+            buckets[hashes[i] % bucket_count].push_back(static_cast<uint32_t>(i));
+        }
+
+        std::vector<uint32_t> order(bucket_count);
+        for (size_t b = 0; b < bucket_count; ++b) {
+            order[b] = static_cast<uint32_t>(b);
+        }
+        std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+            return buckets[lhs].size() > buckets[rhs].size();
+        });
+
+        std::vector<bool> taken(slot_count, false);
+        std::vector<size_t> candidate;
+        for (uint32_t b : order) {
+            auto& bucket = buckets[b];
+            if (bucket.empty()) {
+                break;
+            }
+            // 哈希值完全相同的两个key无论种子和盐值是多少都会冲突
+            for (size_t x = 0; x < bucket.size(); ++x) {
+                for (size_t y = x + 1; y < bucket.size(); ++y) {
+                    if (hashes[bucket[x]] == hashes[bucket[y]]) {
+                        return kBuildDuplicate;
+                    }
+                }
+            }
+
+            bool placed = false;
+            for (uint32_t seed = 0; seed <= kFrozenMaxSeed && !placed; ++seed) {
+                candidate.clear();
+                placed = true;
+                for (uint32_t index : bucket) {
+                    size_t slot = slot_of(hashes[index], seed, slot_count);
+                    if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                        placed = false;
+                        break;
+                    }
+                    candidate.push_back(slot);
+                }
+                if (placed) {
+                    seeds[b] = static_cast<uint16_t>(seed);
+                    for (size_t k = 0; k < bucket.size(); ++k) {
+                        taken[candidate[k]] = true;
+                        slots[candidate[k]] = bucket[k];
+                    }
+                }
+            }
+            if (!placed) {
+                return kBuildRetry;
+            }
+        }
+        return kBuildOk;
+    }
+
+    const Entry* find(const K& key) const {
+        if (_entries.empty()) {
+            return nullptr;
+        }
+        uint64_t hash = key_hash(key, _salt);
+        size_t slot = slot_of(hash, _seeds[hash % _seeds.size()], _slots.size());
+        // 不在集合中的key也会映射到某个下标, 需要比较key
+        const Entry& entry = _entries[_slots[slot]];
+        return entry.key == key ? &entry : nullptr;
+    }
+
+    static bool is_expire(const Entry& entry) {
+        // 与KeyValue::is_expire()相同, 永不过期的数据不读取时钟
+        return entry.expire_time_interval != -1 && SystemClock::now() > entry.expire_time;
+    }
+
+    static KeyValue<K, V> to_key_value(const Entry& entry) {
+        return KeyValue<K, V>(entry.key, entry.value, entry.insert_time, entry.expire_time, entry.expire_time_interval);
+    }
+
+    // 按insert_time从小到大排列
+    std::vector<Entry> _entries;
+    // 每个桶的种子
+    std::vector<uint16_t> _seeds;
+    // 完美哈希下标 -> _entries中的位置
+    std::vector<uint32_t> _slots;
+    uint64_t _salt;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+    * @brief 热点key及其估计的访问次数
+*/
+template<typename K>
+struct HotKey {
+    K key;
+    uint64_t count; // 估计的访问次数, 已按采样率放大, 可能偏大
+    uint64_t error; // count的最大高估量, count - error 是访问次数的下界
+};
+
+/*
+    * @brief Space-Saving算法统计访问最频繁的key, 只保存capacity个计数器
+    * 平均每sample_rate次访问采样一次, 未采样的访问只修改线程局部状态, 不写任何共享内存; 采样的访问使用独立的锁, 不占用SafeMap的_mutex
+    * 是否采样由线程局部序号与实例盐值混合后的哈希决定, 同一线程交替访问多个实例时各实例的采样互不影响
+    * 访问次数超过总访问次数 1/capacity 的key一定会被保留
+*/
+template<typename K>
+class HeavyHitter {
+public:
+    /*
+        * @param capacity 计数器个数
+        * @param sample_rate 采样间隔, 向上取整为2的幂, 1表示记录每次访问
+    */
+    HeavyHitter(size_t capacity, uint32_t sample_rate) : _capacity(std::max<size_t>(1, capacity)), _sample_mask(0), _salt(next_salt()) {
+        uint32_t rate = 1;
+        while (rate < sample_rate) {
+            rate <<= 1;
+        }
+        _sample_mask = rate - 1;
+    }
+
+    void record(const K& key) {
+        if ((sample_hash() & _sample_mask) != 0) {
+            return;
+        }
+
+        size_t hash = std::hash<K>()(key);
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // 计数器很少, 一次线性扫描同时查找key和计数最小的位置, 比哈希表少一次节点分配和释放
+        size_t min_index = 0;
+        for (size_t i = 0; i < _counters.size(); ++i) {
+            Counter& slot = _counters[i];
+            if (slot.hash == hash && slot.key == key) {
+                ++slot.count;
+                return;
+            }
+            if (slot.count < _counters[min_index].count) {
+                min_index = i;
+            }
+        }
+        if (_counters.size() < _capacity) {
+            _counters.push_back(Counter{key, hash, 1, 0});
+            return;
+        }
+        // 替换计数最小的key, 新key继承其计数作为误差
+        Counter& victim = _counters[min_index];
+        victim.key = key;
+        victim.hash = hash;
+        victim.error = victim.count;
+        ++victim.count;
+    }
+
+    /*
+        * @brief 访问最频繁的n个key, 按估计次数从大到小排列
+        * @param n 个数
+    */
+    std::vector<HotKey<K>> top(size_t n) {
+        std::vector<HotKey<K>> result;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            uint64_t scale = static_cast<uint64_t>(_sample_mask) + 1;
+            for (auto& counter : _counters) {
+                result.push_back(HotKey<K>{counter.key, counter.count * scale, counter.error * scale});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const HotKey<K>& lhs, const HotKey<K>& rhs) {
+            return lhs.count > rhs.count;
+        });
+        if (result.size() > n) {
+            result.resize(n);
+        }
+        return result;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _counters.clear();
+    }
+
+private:
+    /*
+        * @brief 线程局部序号(Weyl序列)与盐值混合后做murmur3 finalizer, 低位近似均匀分布
+    */
+    uint32_t sample_hash() const {
+        static thread_local uint32_t sequence = 0;
+        sequence += 0x9e3779b9u;
+        uint32_t hash = sequence ^ _salt;
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    static uint32_t next_salt() {
+        static std::atomic<uint32_t> salt(0);
+        return salt.fetch_add(0x6a09e667u, std::memory_order_relaxed);
+    }
+
+    struct Counter {
+        K key;
+        size_t hash;
+        uint64_t count;
+        uint64_t error;
+    };
+
+    size_t _capacity;
+    uint32_t _sample_mask;
+
+    // 实例盐值, 使同一线程的访问序号在不同实例上得到互不相关的采样结果
+    uint32_t _salt;
+
+    std::mutex _mutex;
+    std::vector<Counter> _counters;
+};
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+const size_t kKeyIndexMinCapacity = 16; // 哈希表最小容量
+const uint64_t kKeyIndexDenseMinSpan = 1024; // 整数key直接寻址数组的长度不超过该值时总是允许
+const uint64_t kKeyIndexDenseRatio = 4; // 整数key直接寻址数组的长度不超过key个数的该倍数
+
+/*
+    * @brief key只保存一份的哈希索引, key存放在节点中(通过node->get_key()获取), 索引只保存节点指针和缓存的哈希值
+    * 开放寻址+线性探测, 删除时向前移动后续元素, 不需要墓碑; 比较key之前先比较缓存的哈希值
+    * 不加锁, 由SafeMap在持有_mutex时调用
+    * 整数key使用下面的特化版本
+*/
+template<typename K, typename T, typename Hash = std::hash<K>, bool Integral = std::is_integral<K>::value>
+class KeyIndex {
+public:
+    using Pointer = std::shared_ptr<T>;
+
+    KeyIndex() : _size(0) {}
+
+    /*
+        * @brief 查找key对应的节点
+        * @param key 键
+        * @return 节点指针的地址, 可以原地替换为相同key的节点; 不存在返回nullptr
+    */
+    Pointer* find(const K& key) {
+        size_t i = find_slot(key);
+        return i != kNotFound ? &_slots[i].value : nullptr;
+    }
+
+    size_t count(const K& key) {
+        return find(key) != nullptr ? 1 : 0;
+    }
+
+    /*
+        * @brief 插入节点, key已存在时替换
+        * @param value 节点
+    */
+    void assign(Pointer value) {
+        if ((_size + 1) * 4 > _slots.size() * 3) {
+            rehash(std::max(kKeyIndexMinCapacity, _slots.size() * 2));
+        }
+        size_t hash = mix(Hash()(value->get_key()));
+        size_t mask = _slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot& slot = _slots[i];
+            if (!slot.value) {
+                slot.hash = hash;
+                slot.value = std::move(value);
+                ++_size;
+                return;
+            }
+            if (slot.hash == hash && slot.value->get_key() == value->get_key()) {
+                slot.value = std::move(value);
+                return;
+            }
+        }
+    }
+
+    /*
+        * @brief 删除key
+        * @param key 键
+        * @return 删除成功返回true, 不存在返回false
+    */
+    bool erase(const K& key) {
+        size_t hole = find_slot(key);
+        if (hole == kNotFound) {
+            return false;
+        }
+        size_t mask = _slots.size() - 1;
+        // 把探测链上可以前移的元素移到空位, 保证查找不会提前遇到空槽
+        for (size_t i = (hole + 1) & mask; _slots[i].value; i = (i + 1) & mask) {
+            size_t home = _slots[i].hash & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                _slots[hole] = std::move(_slots[i]);
+                hole = i;
+            }
+        }
+        _slots[hole].value.reset();
+        --_size;
+        return true;
+    }
+
+    /*
+        * @brief 遍历所有节点, 遍历期间不能插入或删除
+        * @param func void(Pointer&)
+    */
+    template<typename Func>
+    void for_each(Func func) {
+        for (auto& slot : _slots) {
+            if (slot.value) {
+                func(slot.value);
+            }
+        }
+    }
+
+    void reserve(size_t count) {
+        // count * 4会溢出时任何容量都无法满足, 只作为提示忽略
+        if (count > std::numeric_limits<size_t>::max() / 4) {
+            return;
+        }
+        size_t capacity = kKeyIndexMinCapacity;
+        while (capacity * 3 < count * 4) {
+            capacity <<= 1;
+        }
+        if (capacity > _slots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    /*
+        * @brief 大量删除后按当前元素个数缩小哈希表
+    */
+    void shrink_to_fit() {
+        if (_size == 0) {
+            std::vector<Slot>().swap(_slots);
+            return;
+        }
+        size_t capacity = kKeyIndexMinCapacity;
+        while (capacity * 3 < _size * 4) {
+            capacity <<= 1;
+        }
+        if (capacity < _slots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    void swap(KeyIndex& other) {
+        _slots.swap(other._slots);
+        std::swap(_size, other._size);
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    /*
+        * @brief 索引本身占用的字节数, 不包括节点
+    */
+    size_t memory_usage() const {
+        return _slots.capacity() * sizeof(Slot);
+    }
+
+private:
+    static const size_t kNotFound = static_cast<size_t>(-1);
+
+    struct Slot {
+        Pointer value;
+        size_t hash = 0;
+    };
+
+    /*
+        * @brief std::hash对整数是恒等映射, 打散后再取低位, 避免规律的key聚集在相邻的槽中
+    */
+    static size_t mix(size_t hash) {
+        uint64_t value = hash;
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        return static_cast<size_t>(value);
+    }
+
+    size_t find_slot(const K& key) const {
+        if (_size == 0) {
+            return kNotFound;
+        }
+        size_t hash = mix(Hash()(key));
+        size_t mask = _slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = _slots[i];
+            if (!slot.value) {
+                return kNotFound;
+            }
+            if (slot.hash == hash && slot.value->get_key() == key) {
+                return i;
+            }
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old_slots(capacity);
+        old_slots.swap(_slots);
+        size_t mask = capacity - 1;
+        for (auto& slot : old_slots) {
+            if (!slot.value) {
+                continue;
+            }
+            size_t i = slot.hash & mask;
+            while (_slots[i].value) {
+                i = (i + 1) & mask;
+            }
+            _slots[i] = std::move(slot);
+        }
+    }
+
+    std::vector<Slot> _slots;
+    size_t _size;
+};
+
+/*
+    * @brief 整数key的索引: 连续范围内的key直接用 key - base 作为下标存放在数组中, 不计算哈希
+    * 数组长度不超过 max(kKeyIndexDenseMinSpan, kKeyIndexDenseRatio * 数组中的key个数), 放不下的稀疏key回退到哈希表
+    * 落在数组范围内的key只会出现在数组中, 数组扩大时把哈希表中落入新范围的key移到数组
+*/
+template<typename K, typename T, typename Hash>
+class KeyIndex<K, T, Hash, true> {
+public:
+    using Pointer = std::shared_ptr<T>;
+
+    KeyIndex() : _base(0), _dense_size(0) {}
+
+    Pointer* find(const K& key) {
+        uint64_t offset = ordinal(key) - _base;
+        if (offset < _dense.size()) {
+            return _dense[offset] ? &_dense[offset] : nullptr;
+        }
+        return _sparse.find(key);
+    }
+
+    size_t count(const K& key) {
+        return find(key) != nullptr ? 1 : 0;
+    }
+
+    void assign(Pointer value) {
+        uint64_t key = ordinal(value->get_key());
+        if (key - _base >= _dense.size()) {
+            grow_dense(key);
+        }
+        uint64_t offset = key - _base;
+        if (offset >= _dense.size()) {
+            _sparse.assign(std::move(value));
+            return;
+        }
+        if (!_dense[offset]) {
+            ++_dense_size;
+        }
+        _dense[offset] = std::move(value);
+    }
+
+    bool erase(const K& key) {
+        uint64_t offset = ordinal(key) - _base;
+        if (offset >= _dense.size()) {
+            return _sparse.erase(key);
+        }
+        if (!_dense[offset]) {
+            return false;
+        }
+        _dense[offset].reset();
+        --_dense_size;
+        return true;
+    }
+
+    template<typename Func>
+    void for_each(Func func) {
+        for (auto& value : _dense) {
+            if (value) {
+                func(value);
+            }
+        }
+        _sparse.for_each(func);
+    }
+
+    /*
+        * @brief 数组随key扩大, 预留时不知道key是否稠密, 不做任何事
+    */
+    void reserve(size_t) {}
+
+    void swap(KeyIndex& other) {
+        _dense.swap(other._dense);
+        std::swap(_base, other._base);
+        std::swap(_dense_size, other._dense_size);
+        _sparse.swap(other._sparse);
+    }
+
+    size_t size() const {
+        return _dense_size + _sparse.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t memory_usage() const {
+        return _dense.capacity() * sizeof(Pointer) + _sparse.memory_usage();
+    }
+
+private:
+    /*
+        * @brief 把key映射到保持大小顺序的uint64, 有符号数翻转符号位
+    */
+    static uint64_t ordinal(K key) {
+        if (std::is_signed<K>::value) {
+            return static_cast<uint64_t>(static_cast<int64_t>(key)) ^ (uint64_t(1) << 63);
+        }
+        return static_cast<uint64_t>(key);
+    }
+
+    /*
+        * @brief 尝试扩大数组使其包含key, 新范围过于稀疏时保持不变
+        * @param key ordinal(key)
+    */
+    void grow_dense(uint64_t key) {
+        // 只按数组中已有的key计算上限, 稀疏key再多也不会让数组变稀疏
+        uint64_t limit = std::max<uint64_t>(kKeyIndexDenseMinSpan, kKeyIndexDenseRatio * (_dense_size + 1));
+        // 数组已空时重新选择范围
+        if (_dense_size == 0) {
+            std::vector<Pointer>().swap(_dense);
+        }
+        uint64_t span = _dense.size();
+        uint64_t low = span == 0 ? key : std::min(_base, key);
+        uint64_t high = span == 0 ? key : std::max(_base + span - 1, key);
+        // 每次至少翻倍, 扩大次数不超过64次, 复制数组和迁移稀疏key均摊O(1); 向key所在的方向扩展
+        if (high - low >= limit || span * 2 > limit) {
+            return;
+        }
+        uint64_t new_span = std::max(high - low + 1, span * 2);
+        uint64_t new_base;
+        if (span > 0 && key < _base) {
+            new_base = high >= new_span - 1 ? high - (new_span - 1) : 0;
+        } else {
+            uint64_t max_base = std::numeric_limits<uint64_t>::max() - (new_span - 1);
+            new_base = std::min(low, max_base);
+        }
+
+        std::vector<Pointer> dense(new_span);
+        for (uint64_t i = 0; i < span; ++i) {
+            dense[_base + i - new_base] = std::move(_dense[i]);
+        }
+        _dense.swap(dense);
+        _base = new_base;
+
+        if (_sparse.empty()) {
+            return;
+        }
+        std::vector<Pointer> moved;
+        _sparse.for_each([this, &moved](Pointer& value) {
+            if (ordinal(value->get_key()) - _base < _dense.size()) {
+                moved.push_back(value);
+            }
+        });
+        for (auto& value : moved) {
+            _sparse.erase(value->get_key());
+            _dense[ordinal(value->get_key()) - _base] = std::move(value);
+            ++_dense_size;
+        }
+        _sparse.shrink_to_fit();
+    }
+
+    // 数组覆盖 [_base, _base + _dense.size()), 以ordinal(key)计
+    std::vector<Pointer> _dense;
+    uint64_t _base;
+    size_t _dense_size;
+
+    KeyIndex<K, T, Hash, false> _sparse;
+};
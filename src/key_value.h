@@ -1,7 +1,9 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
+#include <utility>
 
 
 using TimeStamp = std::chrono::system_clock::time_point;
@@ -21,7 +23,10 @@ public:
         , _insert_time(SystemClock::now())
         , _expire_time(_insert_time + std::chrono::milliseconds(expire_time_interval))
         , _expire_time_interval(expire_time_interval) // 传入expire_time_interval计算过期时间
-        , _is_delete(false) {}
+        , _is_delete(false)
+        , _cold_offset(-1)
+        , _cold_size(0)
+        , _version(0) {}
 
     KeyValue(const K& key, const V& value, const TimeStamp& expire_time)
         : _key(key)
@@ -29,7 +34,21 @@ public:
         , _insert_time(SystemClock::now())
         , _expire_time(expire_time)
         , _expire_time_interval(0) // 0表示会过期, 过期时间为expire_time
-        , _is_delete(false) {}
+        , _is_delete(false)
+        , _cold_offset(-1)
+        , _cold_size(0)
+        , _version(0) {}
+
+    KeyValue(K key, V value, const TimeStamp& insert_time, const TimeStamp& expire_time, int expire_time_interval)
+        : _key(std::move(key))
+        , _value(std::move(value))
+        , _insert_time(insert_time)
+        , _expire_time(expire_time)
+        , _expire_time_interval(expire_time_interval) // 从快照等外部来源恢复, 保留原有的时间戳
+        , _is_delete(false)
+        , _cold_offset(-1)
+        , _cold_size(0)
+        , _version(0) {}
 
     static KeyValueSharedPtr create(const K& key, const V& value, int expire_time_interval = -1) {
         return std::make_shared<KeyValue<K, V>>(key, value, expire_time_interval);
@@ -54,6 +73,24 @@ public:
         _expire_time = std::chrono::system_clock::now() + std::chrono::milliseconds(_expire_time_interval);
     }
     
+    /*
+        * @brief 在当前过期时间的基础上延长过期时间, 不修改expire_time_interval
+        * @param delta_ms 延长的时间, 单位ms, 可以为负数
+    */
+    void extend_expire_time(int delta_ms) {
+        _expire_time += std::chrono::milliseconds(delta_ms);
+    }
+
+    /*
+        * @brief 直接设置过期时间, 用于重放变更
+        * @param expire_time 过期时间
+        * @param expire_time_interval 过期时间间隔, -1表示永不过期
+    */
+    void set_expire_time(const TimeStamp& expire_time, int expire_time_interval) {
+        _expire_time = expire_time;
+        _expire_time_interval = expire_time_interval;
+    }
+
     /*
         * @brief 判断是否过期
         * @return 过期返回true, 否则返回false
@@ -73,6 +110,46 @@ public:
         _is_delete = true;
     }
 
+    /*
+        * @brief 清除删除标志, 用于把已移出容器的数据交还给调用者
+    */
+    void undelete_value() {
+        _is_delete = false;
+    }
+
+    /*
+        * @brief 标记数据的value已写入冷存储文件, 此时节点中的value为默认值
+        * @param offset value在冷存储文件中的偏移
+        * @param size value序列化后的长度
+    */
+    void set_cold(int64_t offset, uint32_t size) {
+        _cold_offset = offset;
+        _cold_size = size;
+    }
+
+    bool is_cold() const {
+        return _cold_offset >= 0;
+    }
+
+    int64_t get_cold_offset() const {
+        return _cold_offset;
+    }
+
+    uint32_t get_cold_size() const {
+        return _cold_size;
+    }
+
+    /*
+        * @brief 设置版本号, 由SafeMap在数据加入容器时分配, 同一个SafeMap中严格递增
+    */
+    void set_version(uint64_t version) {
+        _version = version;
+    }
+
+    uint64_t get_version() const {
+        return _version;
+    }
+
     const V& get_value() const {
         return _value;
     }
@@ -99,4 +176,7 @@ private:
     TimeStamp _expire_time;
     int _expire_time_interval;
     bool _is_delete;
+    int64_t _cold_offset; // 冷存储文件中的偏移, -1表示value在内存中
+    uint32_t _cold_size;
+    uint64_t _version; // 0表示尚未加入SafeMap
 };
\ No newline at end of file
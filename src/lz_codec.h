@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+const size_t kLzMinMatch = 4; // 最短匹配长度
+const size_t kLzMaxOffset = 65535; // 最大匹配距离, 字典和输入合计
+const int kLzHashBits = 12; // 压缩时哈希表大小为 1 << kLzHashBits
+const size_t kLzMaxDictionarySize = 32 * 1024; // 字典最大长度, 保证输入开头部分也能引用到整个字典
+const size_t kLzTrainKmer = 8; // 训练字典时统计的子串长度
+const size_t kLzTrainSegment = 64; // 训练字典时选取的片段长度
+const size_t kLzMaxExpansion = 255; // 每个压缩字节最多展开的原始字节数, 由扩展长度字节的最大值决定
+
+/*
+    * @brief LZ4风格的LZ77编解码器, 适合重复度高的短文本(如JSON)
+    * 格式: uint32原始长度 + 若干序列, 每个序列为 token(高4位字面量长度, 低4位匹配长度-4) 字面量 uint16距离 扩展长度
+    * 最后一个序列只有字面量; 可选的字典视为位于输入之前, 匹配可以引用字典中的内容
+    * 设置字典后只读, 可以在多个线程中并发压缩和解压
+*/
+class LzCodec {
+public:
+    LzCodec() : _dict_table(1 << kLzHashBits, 0) {}
+
+    /*
+        * @brief 设置字典, 超过kLzMaxDictionarySize时只保留末尾部分
+        * @param dictionary 字典, 通常由train_dictionary生成
+    */
+    void set_dictionary(std::string dictionary) {
+        if (dictionary.size() > kLzMaxDictionarySize) {
+            dictionary.erase(0, dictionary.size() - kLzMaxDictionarySize);
+        }
+        _dictionary = std::move(dictionary);
+        std::fill(_dict_table.begin(), _dict_table.end(), 0);
+        // 后面的位置覆盖前面的位置, 距离输入越近匹配距离越短
+        for (size_t i = 0; i + kLzMinMatch <= _dictionary.size(); ++i) {
+            _dict_table[hash(read32(_dictionary.data() + i))] = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+    const std::string& get_dictionary() const {
+        return _dictionary;
+    }
+
+    /*
+        * @brief 压缩
+        * @param data 输入
+        * @param size 输入长度
+        * @param out 输出, 追加在末尾
+    */
+    void compress(const char* data, size_t size, std::string& out) const {
+        write32(out, static_cast<uint32_t>(size));
+
+        // 下标+1, 0表示空
+        std::vector<uint32_t> table(1 << kLzHashBits, 0);
+        const char* dict = _dictionary.data();
+        size_t dict_size = _dictionary.size();
+
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i + kLzMinMatch <= size) {
+            uint32_t sequence = read32(data + i);
+            uint32_t h = hash(sequence);
+            uint32_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(i + 1);
+
+            size_t offset = 0;
+            size_t match = 0;
+            if (candidate != 0 && i - (candidate - 1) <= kLzMaxOffset && read32(data + candidate - 1) == sequence) {
+                size_t from = candidate - 1;
+                offset = i - from;
+                match = kLzMinMatch;
+                while (i + match < size && data[from + match] == data[i + match]) {
+                    ++match;
+                }
+            } else if (_dict_table[h] != 0) {
+                size_t from = _dict_table[h] - 1;
+                offset = i + dict_size - from;
+                if (offset <= kLzMaxOffset && read32(dict + from) == sequence) {
+                    // 只在字典内部延伸, 不跨到输入中
+                    match = kLzMinMatch;
+                    while (from + match < dict_size && i + match < size && dict[from + match] == data[i + match]) {
+                        ++match;
+                    }
+                }
+            }
+
+            if (match < kLzMinMatch) {
+                ++i;
+                continue;
+            }
+            write_sequence(out, data + anchor, i - anchor, offset, match);
+            i += match;
+            anchor = i;
+        }
+        write_literals(out, data + anchor, size - anchor);
+    }
+
+    /*
+        * @brief 解压
+        * @param data 压缩数据
+        * @param size 压缩数据长度
+        * @param out 输出, 覆盖原有内容
+        * @return 成功返回true, 数据损坏返回false
+    */
+    bool decompress(const char* data, size_t size, std::string& out) const {
+        const uint8_t* ip = reinterpret_cast<const uint8_t*>(data);
+        const uint8_t* end = ip + size;
+        if (size < 4) {
+            return false;
+        }
+        uint32_t raw_size;
+        std::memcpy(&raw_size, ip, 4);
+        ip += 4;
+        // 原始长度来自不可信的数据, 超过压缩数据能展开的上限时在分配内存前拒绝
+        if (raw_size > (size - 4) * kLzMaxExpansion) {
+            return false;
+        }
+        out.resize(raw_size);
+        char* op = &out[0];
+        size_t pos = 0;
+
+        while (ip < end) {
+            uint8_t token = *ip++;
+            size_t literals = token >> 4;
+            if (literals == 15 && !read_length(ip, end, literals)) {
+                return false;
+            }
+            if (static_cast<size_t>(end - ip) < literals || raw_size - pos < literals) {
+                return false;
+            }
+            std::memcpy(op + pos, ip, literals);
+            ip += literals;
+            pos += literals;
+            if (ip == end) {
+                // 只有字面量的最后一个序列, 缺少它说明数据被截断
+                return pos == raw_size;
+            }
+
+            if (end - ip < 2) {
+                return false;
+            }
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            size_t match = token & 15;
+            if (match == 15 && !read_length(ip, end, match)) {
+                return false;
+            }
+            match += kLzMinMatch;
+            if (offset == 0 || offset > pos + _dictionary.size() || raw_size - pos < match) {
+                return false;
+            }
+
+            if (offset > pos) {
+                // 前一部分来自字典
+                size_t from = _dictionary.size() - (offset - pos);
+                size_t count = std::min(match, _dictionary.size() - from);
+                std::memcpy(op + pos, _dictionary.data() + from, count);
+                pos += count;
+                match -= count;
+            }
+            if (offset >= match) {
+                std::memcpy(op + pos, op + pos - offset, match);
+                pos += match;
+                continue;
+            }
+            // 匹配区域与输出重叠, 逐字节复制
+            for (size_t k = 0; k < match; ++k, ++pos) {
+                op[pos] = op[pos - offset];
+            }
+        }
+        return false;
+    }
+
+    /*
+        * @brief 从样本中训练字典: 统计在多个样本中出现的子串, 贪心选取覆盖最多高频子串的片段
+        * 先选中的片段放在字典末尾, 离输入最近
+        * @param samples 样本
+        * @param dictionary_size 字典大小, 不超过kLzMaxDictionarySize
+        * @return 字典
+    */
+    static std::string train_dictionary(const std::vector<std::string>& samples, size_t dictionary_size) {
+        dictionary_size = std::min(dictionary_size, kLzMaxDictionarySize);
+
+        // 每个子串出现在多少个样本中, 只出现在一个样本中的子串由LZ匹配本身处理
+        std::unordered_map<uint64_t, uint32_t> frequency;
+        std::unordered_set<uint64_t> seen;
+        for (auto& sample : samples) {
+            seen.clear();
+            for (size_t i = 0; i + kLzTrainKmer <= sample.size(); ++i) {
+                uint64_t kmer = read64(sample.data() + i);
+                if (seen.insert(kmer).second) {
+                    ++frequency[kmer];
+                }
+            }
+        }
+
+        struct Segment {
+            uint64_t score;
+            size_t sample;
+            size_t offset;
+
+            bool operator<(const Segment& other) const {
+                return score < other.score;
+            }
+        };
+        auto score = [&samples, &frequency](size_t sample, size_t offset) {
+            uint64_t total = 0;
+            const std::string& text = samples[sample];
+            for (size_t i = offset; i + kLzTrainKmer <= offset + kLzTrainSegment && i + kLzTrainKmer <= text.size(); ++i) {
+                auto it = frequency.find(read64(text.data() + i));
+                if (it != frequency.end() && it->second > 1) {
+                    total += it->second;
+                }
+            }
+            return total;
+        };
+
+        std::priority_queue<Segment> heap;
+        for (size_t s = 0; s < samples.size(); ++s) {
+            for (size_t offset = 0; offset < samples[s].size(); offset += kLzTrainSegment / 2) {
+                uint64_t value = score(s, offset);
+                if (value > 0) {
+                    heap.push(Segment{value, s, offset});
+                }
+            }
+        }
+
+        // 选中片段后清零其中子串的频率, 其他包含这些子串的片段在出堆时重新计算分数
+        std::vector<std::string> picked;
+        size_t total_size = 0;
+        while (!heap.empty() && total_size < dictionary_size) {
+            Segment top = heap.top();
+            heap.pop();
+            uint64_t value = score(top.sample, top.offset);
+            if (value == 0) {
+                continue;
+            }
+            if (value < top.score && !heap.empty() && value < heap.top().score) {
+                heap.push(Segment{value, top.sample, top.offset});
+                continue;
+            }
+
+            const std::string& text = samples[top.sample];
+            std::string segment = text.substr(top.offset, std::min(kLzTrainSegment, dictionary_size - total_size));
+            for (size_t i = 0; i + kLzTrainKmer <= segment.size(); ++i) {
+                frequency.erase(read64(segment.data() + i));
+            }
+            total_size += segment.size();
+            picked.push_back(std::move(segment));
+        }
+
+        std::string dictionary;
+        dictionary.reserve(total_size);
+        for (auto it = picked.rbegin(); it != picked.rend(); ++it) {
+            dictionary.append(*it);
+        }
+        return dictionary;
+    }
+
+private:
+    static uint32_t read32(const char* data) {
+        uint32_t value;
+        std::memcpy(&value, data, 4);
+        return value;
+    }
+
+    static uint64_t read64(const char* data) {
+        uint64_t value;
+        std::memcpy(&value, data, 8);
+        return value;
+    }
+
+    static void write32(std::string& out, uint32_t value) {
+        out.append(reinterpret_cast<const char*>(&value), 4);
+    }
+
+    static uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - kLzHashBits);
+    }
+
+    static void write_length(std::string& out, size_t length) {
+        while (length >= 255) {
+            out.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    static bool read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+        uint8_t byte;
+        do {
+            if (ip == end) {
+                return false;
+            }
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    static void write_sequence(std::string& out, const char* literals, size_t literal_size, size_t offset, size_t match) {
+        size_t match_code = match - kLzMinMatch;
+        out.push_back(static_cast<char>((std::min<size_t>(literal_size, 15) << 4) | std::min<size_t>(match_code, 15)));
+        if (literal_size >= 15) {
+            write_length(out, literal_size - 15);
+        }
+        out.append(literals, literal_size);
+        out.push_back(static_cast<char>(offset & 0xff));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (match_code >= 15) {
+            write_length(out, match_code - 15);
+        }
+    }
+
+    static void write_literals(std::string& out, const char* literals, size_t literal_size) {
+        out.push_back(static_cast<char>(std::min<size_t>(literal_size, 15) << 4));
+        if (literal_size >= 15) {
+            write_length(out, literal_size - 15);
+        }
+        out.append(literals, literal_size);
+    }
+
+    std::string _dictionary;
+
+    // 字典中每个4字节序列最后出现的位置, 下标+1, 0表示空
+    std::vector<uint32_t> _dict_table;
+};
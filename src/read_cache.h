@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "key_value.h"
+
+const size_t kReadCacheStripes = 1024; // 版本号分片个数, 写入某个key只使同一分片的缓存失效
+const size_t kReadCacheSlots = 64; // 每个线程每种<K, V>缓存的数据条数, 直接映射
+
+/*
+    * @brief SafeMap::get_by_key的线程局部读缓存, 命中时不加锁, 只读取一个分片版本号
+    * 每个分片有一个版本号, 写线程在_mutex内修改数据后递增key所在分片的版本号; 缓存的数据记录填充时的分片版本号, 读取时版本号不同则视为未命中
+    * 版本号只在写入时修改, 没有写入时所在的缓存行在各个核上保持共享状态, 读热点key不会产生缓存行争用
+    * 一个槽位连续两次未命中同一个key时才填充, 只读一次的key不会挤掉热点key, 也不多复制一次值
+*/
+template<typename K, typename V>
+class ReadCache {
+    using SystemClock = std::chrono::system_clock;
+
+public:
+    ReadCache() : _id(next_id()), _versions(new std::atomic<uint64_t>[kReadCacheStripes]) {
+        for (size_t i = 0; i < kReadCacheStripes; ++i) {
+            _versions[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ReadCache(const ReadCache&) = delete;
+    ReadCache& operator=(const ReadCache&) = delete;
+
+    /*
+        * @brief 从当前线程的缓存读取
+        * @param key 键
+        * @param hash key的哈希值
+        * @param value 值
+        * @return 缓存的数据仍是最新且未过期时返回true, 否则返回false
+    */
+    bool get(const K& key, size_t hash, V& value) const {
+        uint64_t version = _versions[hash % kReadCacheStripes].load(std::memory_order_acquire);
+        const Slot& slot = slots()[hash % kReadCacheSlots];
+        if (slot.owner != _id || slot.hash != hash || slot.version != version || !(slot.key == key)) {
+            return false;
+        }
+        // 与KeyValue::is_expire()相同, 永不过期的数据不读取时钟
+        if (slot.expire_time_interval != -1 && SystemClock::now() > slot.expire_time) {
+            return false;
+        }
+        value = slot.value;
+        return true;
+    }
+
+    /*
+        * @brief 把锁内读到的数据放入当前线程的缓存, 调用者需持有SafeMap的_mutex
+        * @param key 键
+        * @param hash key的哈希值
+        * @param map_value 数据, 值必须在内存中
+    */
+    void fill(const K& key, size_t hash, const KeyValue<K, V>& map_value) const {
+        Slot& slot = slots()[hash % kReadCacheSlots];
+        bool refresh = slot.owner == _id && slot.hash == hash && slot.key == key;
+        if (!refresh && slot.candidate != hash) {
+            slot.candidate = hash;
+            return;
+        }
+        slot.owner = _id;
+        slot.hash = hash;
+        slot.version = _versions[hash % kReadCacheStripes].load(std::memory_order_relaxed);
+        slot.key = key;
+        slot.value = map_value.get_value();
+        slot.expire_time = map_value.get_expire_time();
+        slot.expire_time_interval = map_value.get_expire_time_interval();
+    }
+
+    /*
+        * @brief key被插入、删除或修改过期时间后使其缓存失效, 调用者需持有SafeMap的_mutex
+        * @param key 键
+    */
+    void invalidate(const K& key) {
+        _versions[std::hash<K>()(key) % kReadCacheStripes].fetch_add(1, std::memory_order_release);
+    }
+
+    /*
+        * @brief 所有数据被替换后使全部缓存失效, 调用者需持有SafeMap的_mutex
+    */
+    void invalidate_all() {
+        for (size_t i = 0; i < kReadCacheStripes; ++i) {
+            _versions[i].fetch_add(1, std::memory_order_release);
+        }
+    }
+
+private:
+    struct Slot {
+        Slot() : owner(0), hash(0), candidate(0), version(0), expire_time_interval(-1) {}
+
+        uint64_t owner; // 填充该槽位的ReadCache的_id, 0表示空
+        size_t hash;
+        size_t candidate; // 上一次未命中但没有填充的key的哈希值
+        uint64_t version;
+        K key;
+        V value;
+        TimeStamp expire_time;
+        int expire_time_interval;
+    };
+
+    // 同一线程中相同<K, V>的所有SafeMap共用一组槽位, 以_id区分
+    static Slot* slots() {
+        thread_local Slot cache[kReadCacheSlots];
+        return cache;
+    }
+
+    // id不复用, 已销毁的SafeMap留在槽位中的数据永远不会被新的SafeMap命中
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> id(0);
+        return ++id;
+    }
+
+    uint64_t _id;
+    std::unique_ptr<std::atomic<uint64_t>[]> _versions;
+};
@@ -3,6 +3,12 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <initializer_list>
 #include <iostream>
 #include <iterator>
@@ -10,15 +16,41 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <set>
 #include <thread>
 #include <unordered_map>
 #include <utility>
 #include <thread>
 
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "change_feed.h"
+#include "change_record.h"
+#include "cold_store.h"
+#include "frozen_map.h"
+#include "heavy_hitter.h"
+#include "key_index.h"
 #include "key_value.h"
+#include "read_cache.h"
+#include "snapshot.h"
+#include "time_window.h"
+#include "transaction.h"
+#include "value_interner.h"
+#include "wal.h"
+#include "window_aggregate.h"
+#include "worker_pool.h"
 
 const int kCheckAllTimes = 100; // 间隔多少次全量检查一次过期数据
 const int kDefaultCheckInterval = 5; // 默认检查间隔, 单位ms
+const int kScanChunkSize = 4096; // erase_if/count_if 每次加锁最多取出的数据条数
+const int kMaxScanWorkers = 8; // erase_if/count_if 最多使用的线程数
+const size_t kSnapshotWriteBufferSize = 1 << 20; // 快照写文件的缓冲区大小, 单位字节
+const size_t kColdSpillBatchSize = 4096; // 每次最多转移到冷存储的数据条数
+const size_t kKeyWaitStripes = 64; // wait_for_key按key哈希分片的条件变量个数
+const size_t kDefaultHotKeyCapacity = 64; // 热点key统计默认的计数器个数
+const uint32_t kDefaultHotKeySampleRate = 256; // 热点key统计默认平均每多少次访问采样一次
 
 using TimeStamp = std::chrono::system_clock::time_point;
 
@@ -26,8 +58,12 @@ template<typename K, typename V>
 class SafeMap {
     using SystemClock = std::chrono::system_clock;
     using KeyValueSharedPtr = std::shared_ptr<KeyValue<K, V>>;
+    struct ExpireCompare;
+    using DataMap = KeyIndex<K, KeyValue<K, V>>;
+    using TimeQueue = std::deque<KeyValueSharedPtr>;
+    using ExpireIndex = std::set<KeyValueSharedPtr, ExpireCompare>;
 public:
-    SafeMap() : _is_running(true) {
+    SafeMap() : _next_aggregate_id(0), _next_time_window_id(0), _change_sequence(0), _next_version(0), _applying_change(false), _snapshot_pid(-1), _cold_age_ms(0), _track_checkpoint_changes(false), _key_waiters(), _key_waiter_count(0), _next_watch_id(0), _hot_keys(nullptr), _scan_worker_count(0), _read_cache(nullptr), _is_running(true) {
         _tick_thread = std::thread([this]{loop_tick();});
     }
 
@@ -40,19 +76,37 @@ public:
     ~SafeMap() {
         std::cout << "SafeMap destructor" << std::endl;
         _is_running = false;
-        
+        // tick线程会访问成员变量, 必须在析构成员之前退出
+        _tick_thread.join();
+        {
+            // 唤醒wait_for_key的等待者并等待它们离开, 之后才能析构条件变量和数据
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (auto& cv : _key_wait_cvs) {
+                cv.notify_all();
+            }
+            _key_wait_done_cv.wait(lock, [this] {
+                return _key_waiter_count == 0;
+            });
+            _watch_cv.notify_all();
+        }
+        // 正在执行的监听回调结束后通知线程才退出, 尚未执行的通知被丢弃
+        if (_watch_thread.joinable()) {
+            _watch_thread.join();
+        }
+        _scan_pool.reset();
+        // 回收后台快照子进程
+        wait_snapshot_background();
+
         decltype(_data_map) temp_map;
-        decltype(_min_expire_heap) temp_heap;
+        decltype(_expire_index) temp_index;
         decltype(_queue) temp_queue;
 
         {
             std::lock_guard<std::mutex> lock(_mutex);
             _data_map.swap(temp_map);
-            _min_expire_heap.swap(temp_heap);
+            _expire_index.swap(temp_index);
             _queue.swap(temp_queue);
         }
-        
-        _tick_thread.detach();
     }
 
     /*
@@ -60,24 +114,58 @@ public:
         * @param key 键
         * @param value 值
         * @param expire_time_interval 过期时间, 单位ms, -1表示永不过期
-        * @return 插入成功返回true, 否则返回false
+        * @return 插入成功返回true, key已存在或预写日志已失败返回false
     */
     bool insert(const K& key, const V& value, int expire_time_interval = -1) {
+        record_access(key);
         auto map_value = KeyValue<K, V>::create(key, value, expire_time_interval);
 
         std::lock_guard<std::mutex> lock(_mutex);
 
+        if (wal_failed_without_lock()) {
+            return false;
+        }
+        // 在锁内重新记录插入时间, 保证_queue严格按insert_time有序
+        map_value->update_insert_time();
         return insert_without_lock(key, map_value);
     }
 
+    /*
+        * @brief 线程安全插入, 并返回新数据的版本号
+        * @param key 键
+        * @param value 值
+        * @param expire_time_interval 过期时间, 单位ms, -1表示永不过期
+        * @param version 插入成功时为新数据的版本号, 否则为0
+        * @return 插入成功返回true, 否则返回false
+    */
+    bool insert(const K& key, const V& value, int expire_time_interval, uint64_t& version) {
+        record_access(key);
+        auto map_value = KeyValue<K, V>::create(key, value, expire_time_interval);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        version = 0;
+        if (wal_failed_without_lock()) {
+            return false;
+        }
+        map_value->update_insert_time();
+        bool inserted = insert_without_lock(key, map_value);
+        version = inserted ? map_value->get_version() : 0;
+        return inserted;
+    }
+
     /*
         * @brief 线程安全删除
         * @param key 键
         * @return 删除成功返回true, 否则返回false
     */
     bool erase_by_key(const K& key) {
+        record_access(key);
         std::lock_guard<std::mutex> lock(_mutex);
-        
+
+        if (wal_failed_without_lock()) {
+            return false;
+        }
         return erase_without_lock(key);
     }
 
@@ -94,6 +182,9 @@ public:
 
         std::lock_guard<std::mutex> lock(_mutex);
 
+        if (wal_failed_without_lock()) {
+            return 0;
+        }
         auto pair = get_range(_queue, start_time, end_time);
 
         int erase_count = 0;
@@ -118,6 +209,9 @@ public:
 
         std::lock_guard<std::mutex> lock(_mutex);
 
+        if (wal_failed_without_lock()) {
+            return 0;
+        }
         int count = 0;
         auto lambda = [&count, n, this](KeyValueSharedPtr map_value) {
             if (!map_value->is_expire()) {
@@ -149,6 +243,110 @@ public:
         return count;
     }
 
+    /*
+        * @brief 取出某个时间段内的数据, 一次遍历完成删除并返回被删除的数据
+        * @param start_time 开始时间
+        * @param end_time 结束时间
+        * @param asc 是否按照插入时间升序排列
+        * @return 被删除的数据
+    */
+    std::vector<KeyValue<K, V>> drain_by_time_range(const TimeStamp& start_time, const TimeStamp& end_time, bool asc = true) {
+        if (start_time > end_time) {
+            return {};
+        }
+
+        std::vector<KeyValue<K, V>> result;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (wal_failed_without_lock()) {
+                return result;
+            }
+            auto pair = get_range(_queue, start_time, end_time);
+            auto low = _queue.begin() + (pair.first - _queue.cbegin());
+            auto high = _queue.begin() + (pair.second - _queue.cbegin());
+
+            for (auto it = low; it != high; ++it) {
+                drain_without_lock(std::move(*it), result);
+            }
+            // 范围内的数据已全部删除, 直接从_queue中移除, 不需要等待tick_all()
+            _queue.erase(low, high);
+        }
+        load_cold_values(result);
+
+        if (!asc) {
+            std::reverse(result.begin(), result.end());
+        }
+        return result;
+    }
+
+    /*
+        * @brief 取出insert_time最大或最小前的N条数据, 一次遍历完成删除并返回被删除的数据
+        * @param n N
+        * @param asc 是否按照插入时间升序排列
+        * @return 被删除的数据
+    */
+    std::vector<KeyValue<K, V>> drain_by_order(int n, bool asc = true) {
+        std::vector<KeyValue<K, V>> result;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (wal_failed_without_lock()) {
+                return result;
+            }
+            while (!_queue.empty() && static_cast<int>(result.size()) < n) {
+                if (asc) {
+                    auto map_value = std::move(_queue.front());
+                    _queue.pop_front();
+                    drain_without_lock(std::move(map_value), result);
+                } else {
+                    auto map_value = std::move(_queue.back());
+                    _queue.pop_back();
+                    drain_without_lock(std::move(map_value), result);
+                }
+            }
+        }
+        load_cold_values(result);
+
+        return result;
+    }
+
+    /*
+        * @brief 并行删除满足条件的数据, 每次只在取出或删除一批数据时短暂持有锁
+        * @param pred 判断条件, bool(const K&, const V&), 在不持有锁的情况下并行执行, 可以调用同一个map的接口;
+        * pred中嵌套的erase_if/count_if在本map的池中的线程上只在当前线程中扫描; 嵌套扫描其他map时也不会等待被占满的线程池
+        * @return 删除的数据个数
+    */
+    template<typename Predicate>
+    int erase_if(Predicate pred) {
+        return scan_if(pred, true);
+    }
+
+    /*
+        * @brief 并行统计满足条件的数据个数, 每次只在取出一批数据时短暂持有锁
+        * @param pred 判断条件, bool(const K&, const V&), 在不持有锁的情况下并行执行, 限制同erase_if
+        * @return 满足条件的数据个数
+    */
+    template<typename Predicate>
+    int count_if(Predicate pred) {
+        return scan_if(pred, false);
+    }
+
+    /*
+        * @brief 设置erase_if/count_if使用的线程数, 包括调用线程, 默认为核数; 线程池在第一次并行扫描时创建, 之后不能修改
+        * @param count 线程数, 1表示只在调用线程中扫描, 超过kMaxScanWorkers时取kMaxScanWorkers
+        * @return 设置成功返回true, count不大于0或线程池已创建返回false
+    */
+    bool set_scan_workers(int count) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (count <= 0 || _scan_pool) {
+            return false;
+        }
+        _scan_worker_count = std::min(count, kMaxScanWorkers);
+        return true;
+    }
+
     /*
         * @brief 线程安全更新
         * @param key 键
@@ -157,28 +355,64 @@ public:
         * @return 更新成功返回true, 否则返回false
     */
     bool update_value(const K& key, const V& value, int expire_time_interval = 0) {
+        record_access(key);
         std::lock_guard<std::mutex> lock(_mutex);
 
-        if (_data_map.count(key) == 0) {
+        if (wal_failed_without_lock()) {
             return false;
-        } else {
-            // 先删除旧的数据, 再插入新的数据
-            auto old_map_value = _data_map[key];
-            decltype(old_map_value) map_value;
-            if (expire_time_interval == 0) {
-                if (old_map_value->get_expire_time_interval() == -1) {
-                    map_value = KeyValue<K, V>::create(key, value, -1);
-                } else {
-                    map_value = KeyValue<K, V>::create(key, value, old_map_value->get_expire_time_interval());
-                }
-            } else {
-                map_value = KeyValue<K, V>::create(key, value, expire_time_interval);
-            }
-            old_map_value->delete_value();
-            erase_without_lock(old_map_value->get_key());
-            insert_without_lock(key, map_value);
+        }
+        return update_value_without_lock(key, value, expire_time_interval) != 0;
+    }
+
+    /*
+        * @brief 当key的当前版本号等于expected_version时写入value, 校验和写入在同一次加锁中完成
+        * @param key 键
+        * @param expected_version 期望的版本号, 0表示期望key不存在(已过期视为不存在), 此时插入一条永不过期的数据
+        * @param value 值, 覆盖时保留原来的过期时间间隔
+        * @param version 写入成功时为新数据的版本号, 否则为key的当前版本号
+        * @return 版本号一致并写入返回true, 版本号不一致或预写日志已失败返回false
+    */
+    bool compare_and_set(const K& key, uint64_t expected_version, const V& value, uint64_t& version) {
+        record_access(key);
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        version = get_version_without_lock(key);
+        if (version != expected_version || wal_failed_without_lock()) {
+            return false;
+        }
+        if (expected_version != 0) {
+            version = update_value_without_lock(key, value, 0);
             return true;
         }
+        // 已过期但还未清理的数据会阻止插入
+        if (_data_map.find(key) != nullptr) {
+            erase_without_lock(key, ChangeType::kExpire);
+        }
+        auto map_value = KeyValue<K, V>::create(key, value, -1);
+        insert_without_lock(key, map_value);
+        version = map_value->get_version();
+        return true;
+    }
+
+    bool compare_and_set(const K& key, uint64_t expected_version, const V& value) {
+        uint64_t version;
+        return compare_and_set(key, expected_version, value, version);
+    }
+
+    /*
+        * @brief 当key的当前版本号等于expected_version时删除
+        * @param key 键
+        * @param expected_version 期望的版本号
+        * @return 版本号一致并删除返回true, 否则返回false
+    */
+    bool erase_if_version(const K& key, uint64_t expected_version) {
+        record_access(key);
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (expected_version == 0 || get_version_without_lock(key) != expected_version || wal_failed_without_lock()) {
+            return false;
+        }
+        return erase_without_lock(key);
     }
 
     /*
@@ -188,18 +422,197 @@ public:
         * @return 获取成功返回true, 否则返回false
     */
     bool get_by_key(const K& key, V& value) {
+        ReadCache<K, V>* cache = _read_cache.load(std::memory_order_acquire);
+        if (cache != nullptr) {
+            return get_through_cache(*cache, key, value);
+        }
+        uint64_t version;
+        return get_with_version(key, value, version);
+    }
+
+    /*
+        * @brief 线程安全获取, 同时返回版本号, 用于compare_and_set/erase_if_version
+        * @param key 键
+        * @param value 值
+        * @param version 版本号, 不存在或已过期时为0
+        * @return 获取成功返回true, 否则返回false
+    */
+    bool get_by_key(const K& key, V& value, uint64_t& version) {
+        return get_with_version(key, value, version);
+    }
+
+    /*
+        * @brief 等待key出现, 不轮询: 等待者挂在按key哈希分片的条件变量上, 由插入/更新该key的线程唤醒
+        * @param key 键
+        * @param value 值
+        * @param timeout_ms 超时时间, 单位ms, -1表示一直等待
+        * @return key存在且未过期返回true, 超时或SafeMap正在析构返回false
+    */
+    bool wait_for_key(const K& key, V& value, int timeout_ms) {
+        uint64_t version;
+        return wait_for_version(key, 0, value, version, timeout_ms);
+    }
+
+    /*
+        * @brief 等待key被插入或更新为比after_version更新的版本
+        * @param key 键
+        * @param after_version 已知的版本号, 通常来自上一次get_by_key/wait_for_version; 0表示只要key存在即可
+        * @param value 值
+        * @param version 新的版本号
+        * @param timeout_ms 超时时间, 单位ms, -1表示一直等待
+        * @return 等到新版本返回true, 超时或SafeMap正在析构返回false
+    */
+    bool wait_for_version(const K& key, uint64_t after_version, V& value, uint64_t& version, int timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        size_t stripe = key_stripe(key);
+        KeyValueSharedPtr cold_value;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            while (true) {
+                auto found = _data_map.find(key);
+                if (found != nullptr && !(*found)->is_expire() && (*found)->get_version() > after_version) {
+                    version = (*found)->get_version();
+                    if (!(*found)->is_cold()) {
+                        value = (*found)->get_value();
+                        return true;
+                    }
+                    cold_value = *found;
+                    break;
+                }
+
+                if (!_is_running) {
+                    version = 0;
+                    return false;
+                }
+                ++_key_waiters[stripe];
+                ++_key_waiter_count;
+                bool timeout = false;
+                if (timeout_ms < 0) {
+                    _key_wait_cvs[stripe].wait(lock);
+                } else {
+                    timeout = _key_wait_cvs[stripe].wait_until(lock, deadline) == std::cv_status::timeout;
+                }
+                --_key_waiters[stripe];
+                --_key_waiter_count;
+                if (!_is_running) {
+                    // 析构函数在等待所有等待者离开, 下一轮循环返回false
+                    _key_wait_done_cv.notify_all();
+                }
+                if (timeout) {
+                    version = 0;
+                    return false;
+                }
+            }
+        }
+        return read_cold_value(*cold_value, value);
+    }
+
+    using WatchCallback = std::function<void(const KeyValue<K, V>&)>;
+
+    /*
+        * @brief 监听key的插入和更新, 回调由专门的通知线程在不持有锁的情况下按发生顺序执行
+        * @param key 键
+        * @param callback 回调, 参数为插入或更新后的数据
+        * @return 监听id, 用于unwatch
+    */
+    int watch(const K& key, WatchCallback callback) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        int id = _next_watch_id++;
+        _watches.emplace(id, std::make_pair(key, std::make_shared<WatchCallback>(std::move(callback))));
+        _watched_keys[key].push_back(id);
+        if (!_watch_thread.joinable()) {
+            _watch_thread = std::thread([this]{loop_watch();});
+        }
+        return id;
+    }
+
+    /*
+        * @brief 取消监听, 尚未执行的通知会被丢弃, 但正在执行的回调可能在返回后才结束
+        * @param id 监听id
+        * @return 取消成功返回true, id不存在返回false
+    */
+    bool unwatch(int id) {
         std::lock_guard<std::mutex> lock(_mutex);
 
-        if (_data_map.count(key) == 0) {
+        auto it = _watches.find(id);
+        if (it == _watches.end()) {
             return false;
+        }
+        auto keys = _watched_keys.find(it->second.first);
+        keys->second.erase(std::remove(keys->second.begin(), keys->second.end(), id), keys->second.end());
+        if (keys->second.empty()) {
+            _watched_keys.erase(keys);
+        }
+        _watches.erase(it);
+        return true;
+    }
+
+    /*
+        * @brief 开启热点key统计, 在读写路径上采样key, 使用Space-Saving算法保存访问最频繁的key; 已开启时清空统计
+        * @param capacity 计数器个数, 只在第一次开启时生效
+        * @param sample_rate 平均每sample_rate次访问采样一次, 只在第一次开启时生效
+    */
+    void enable_hot_key_tracking(size_t capacity = kDefaultHotKeyCapacity, uint32_t sample_rate = kDefaultHotKeySampleRate) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_hot_key_tracker) {
+            _hot_key_tracker.reset(new HeavyHitter<K>(capacity, sample_rate));
         } else {
-            if (_data_map[key]->is_expire()) {
-                _data_map.erase(key);
-                return false;
-            }
-            value = _data_map[key]->get_value();
-            return true;
+            _hot_key_tracker->clear();
+        }
+        _hot_keys.store(_hot_key_tracker.get(), std::memory_order_release);
+    }
+
+    /*
+        * @brief 关闭热点key统计, 已有的统计结果保留
+    */
+    void disable_hot_key_tracking() {
+        _hot_keys.store(nullptr, std::memory_order_release);
+    }
+
+    /*
+        * @brief 访问最频繁的n个key, 按估计的访问次数从大到小排列
+        * @param n 个数
+        * @return 热点key, 从未开启统计时为空
+    */
+    std::vector<HotKey<K>> top_hot_keys(size_t n) {
+        HeavyHitter<K>* tracker;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            tracker = _hot_key_tracker.get();
+        }
+        return tracker != nullptr ? tracker->top(n) : std::vector<HotKey<K>>();
+    }
+
+    /*
+        * @brief 开启线程局部读缓存, 之后get_by_key(key, value)读取热点key时不加锁, 见ReadCache
+        * 写入时需要递增分片版本号; 带版本号的读取和事务不经过缓存
+    */
+    void enable_read_cache() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_read_cache_owner) {
+            _read_cache_owner.reset(new ReadCache<K, V>());
         }
+        _read_cache.store(_read_cache_owner.get(), std::memory_order_release);
+    }
+
+    /*
+        * @brief 关闭读缓存, 写入仍会递增版本号, 重新开启时已缓存的旧数据不会被命中
+    */
+    void disable_read_cache() {
+        _read_cache.store(nullptr, std::memory_order_release);
+    }
+
+    /*
+        * @brief 开始一个乐观事务, 见Transaction
+        * @return 事务, 只能在当前线程中使用, 生命周期不能超过SafeMap
+    */
+    Transaction<K, V> begin_transaction() {
+        return Transaction<K, V>(*this);
     }
 
     /*
@@ -215,20 +628,17 @@ public:
         }
 
         std::vector<KeyValue<K, V>> result;
-        decltype(_queue) temp_queue;
         {
+            // KeyValue的过期时间可能被原地修改, 只在锁内复制范围内的数据
             std::lock_guard<std::mutex> lock(_mutex);
-            temp_queue = _queue;
-        }
-
-        auto pair = get_range(temp_queue, start_time, end_time);
 
-        for (auto it = pair.first; it != pair.second; ++it) {
-            if (!(*it)->is_expire()) {
-                result.push_back(*(*it));
-            }
+            collect_range_without_lock(start_time, end_time, result);
         }
+        load_cold_values(result);
 
+        if (!asc) {
+            std::reverse(result.begin(), result.end());
+        }
         return result;
     }
 
@@ -240,11 +650,8 @@ public:
     */
     std::vector<KeyValue<K, V>> get_by_order(int n, bool asc = true) {
         std::vector<KeyValue<K, V>> result;
-        decltype(_queue) temp_queue;
-        {
-            std::lock_guard<std::mutex> lock(_mutex);
-            temp_queue = _queue;
-        }
+        // KeyValue的过期时间可能被原地修改, 只在锁内复制需要的数据
+        std::unique_lock<std::mutex> lock(_mutex);
 
         int count = 0;
         auto lambda = [&result, &count, n](KeyValueSharedPtr map_value) {
@@ -259,67 +666,1896 @@ public:
         };
 
         if (asc) {
-            for (auto it = temp_queue.begin(); it != temp_queue.end(); ++it) {
+            for (auto it = _queue.begin(); it != _queue.end(); ++it) {
                 if (!lambda(*it)) {
                     break;
                 }
             }
         } else {
-            for (auto it = temp_queue.rbegin(); it != temp_queue.rend(); ++it) {
+            for (auto it = _queue.rbegin(); it != _queue.rend(); ++it) {
                 if (!lambda(*it)) {
                     break;
                 }
             }
         }
+        lock.unlock();
+        load_cold_values(result);
 
         return result;
     }
 
-private:
     /*
-        * @brief 不加锁插入
+        * @brief 不等待_mutex的插入, 供协程接口使用: 锁被占用时立即返回, 由调用者挂起后重试
         * @param key 键
-        * @param map_value 值
-        * @return 插入成功返回true, 否则返回false
+        * @param value 值
+        * @param expire_time_interval 过期时间, 单位ms, -1表示永不过期
+        * @param inserted 获得锁时为插入结果
+        * @return 获得锁返回true, _mutex被占用返回false
     */
-    bool insert_without_lock(const K& key, KeyValueSharedPtr map_value) {
-        if (_data_map.count(key) > 0) {
-            return false;
-        }
-        _min_expire_heap.push(map_value);
-
-        _queue.push_back(map_value);
-        
-        _data_map[key] = map_value;
+    bool try_insert(const K& key, const V& value, int expire_time_interval, bool& inserted) {
+        auto map_value = KeyValue<K, V>::create(key, value, expire_time_interval);
+        {
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return false;
+            }
 
+            map_value->update_insert_time();
+            inserted = !wal_failed_without_lock() && insert_without_lock(key, map_value);
+        }
+        // 只统计真正执行的访问, 重试不重复计数
+        record_access(key);
         return true;
     }
 
     /*
-        * @brief 不加锁删除
+        * @brief 不等待_mutex的删除
         * @param key 键
-        * @return 删除成功返回true, 否则返回false
+        * @param erased 获得锁时为删除结果
+        * @return 获得锁返回true, _mutex被占用返回false
     */
-    bool erase_without_lock(const K& key) {
-        if (_data_map.count(key) == 0) {
-            return false;
-        } else {
-            // 标记删除, 后续标记删除的数据会在tick()中被延迟删除
-            _data_map[key]->delete_value();
-            // 从map中删除
-            _data_map.erase(key);
-            return true;
+    bool try_erase_by_key(const K& key, bool& erased) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return false;
+            }
+
+            erased = !wal_failed_without_lock() && erase_without_lock(key);
         }
+        record_access(key);
+        return true;
     }
 
     /*
-        * @brief 获取start_time到end_time对应在_queue中的两个迭代器
-        * @param temp_queue 临时队列
-        * @param start_time 起始时间
-        * @param end_time 结束时间
-        * @return std::pair<low, high> low为大于等于start_time的第一个元素, high为大于end_time的第一个元素
+        * @brief 不等待_mutex的获取, 冷数据在锁外读取
+        * @param key 键
+        * @param value 值
+        * @param found 获得锁时为获取结果
+        * @return 获得锁返回true, _mutex被占用返回false
     */
-    auto get_range(const std::deque<KeyValueSharedPtr>& temp_queue, const TimeStamp& start_time, const TimeStamp& end_time) {
+    bool try_get_by_key(const K& key, V& value, bool& found) {
+        KeyValueSharedPtr cold_value;
+        {
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return false;
+            }
+
+            uint64_t version;
+            found = lookup_without_lock(key, value, version, cold_value);
+        }
+        record_access(key);
+        if (found && cold_value != nullptr) {
+            found = read_cold_value(*cold_value, value);
+        }
+        return true;
+    }
+
+    /*
+        * @brief 不等待_mutex的范围查询
+        * @param start_time 起始时间
+        * @param end_time 结束时间
+        * @param asc 是否按照插入时间升序排列
+        * @param result 获得锁时为某个时间范围内的数据
+        * @return 获得锁返回true, _mutex被占用返回false
+    */
+    bool try_get_by_time_range(const TimeStamp& start_time, const TimeStamp& end_time, bool asc,
+                               std::vector<KeyValue<K, V>>& result) {
+        result.clear();
+        if (start_time > end_time) {
+            return true;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return false;
+            }
+
+            collect_range_without_lock(start_time, end_time, result);
+        }
+        load_cold_values(result);
+
+        if (!asc) {
+            std::reverse(result.begin(), result.end());
+        }
+        return true;
+    }
+
+    /*
+        * @brief 阻塞直到_mutex空闲, 不读写任何数据
+        * 协程接口的try_*失败后在专用线程上调用, 等同步调用者释放锁后再重试, 不在执行器上反复重试
+    */
+    void wait_for_unlock() {
+        std::lock_guard<std::mutex> lock(_mutex);
+    }
+
+    /*
+        * @brief 延长某个插入时间范围内所有数据的过期时间, 一次加锁原地修改
+        * @param start_time 起始时间
+        * @param end_time 结束时间
+        * @param delta_ms 延长的时间, 单位ms, 可以为负数; 永不过期的数据不受影响
+        * @return 修改的数据个数
+    */
+    int extend_ttl_by_time_range(const TimeStamp& start_time, const TimeStamp& end_time, int delta_ms) {
+        if (start_time > end_time) {
+            return 0;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (wal_failed_without_lock()) {
+            return 0;
+        }
+        auto pair = get_range(_queue, start_time, end_time);
+
+        int count = 0;
+        for (auto it = pair.first; it != pair.second; ++it) {
+            auto& map_value = *it;
+            if (map_value->is_expire() || map_value->get_expire_time_interval() == -1) {
+                continue;
+            }
+            // expire_time是过期索引的排序键, 修改前先移出索引
+            _expire_index.erase(map_value);
+            map_value->extend_expire_time(delta_ms);
+            _expire_index.insert(map_value);
+            invalidate_read_cache_without_lock(map_value->get_key());
+            record_change_without_lock(ChangeType::kSetExpire, *map_value);
+            ++count;
+        }
+
+        return count;
+    }
+
+    /*
+        * @brief 批量设置过期时间, 一次加锁原地修改
+        * @param keys 键
+        * @param expire_time_interval 过期时间, 单位ms, 从当前时间开始计算, -1表示永不过期
+        * @return 修改的数据个数
+    */
+    int set_ttl_batch(const std::vector<K>& keys, int expire_time_interval) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (wal_failed_without_lock()) {
+            return 0;
+        }
+        int count = 0;
+        for (auto& key : keys) {
+            auto found = _data_map.find(key);
+            if (found == nullptr || (*found)->is_expire()) {
+                continue;
+            }
+            auto map_value = *found;
+            _expire_index.erase(map_value);
+            map_value->update_expire_time(expire_time_interval);
+            if (expire_time_interval != -1) {
+                _expire_index.insert(map_value);
+            }
+            invalidate_read_cache_without_lock(key);
+            record_change_without_lock(ChangeType::kSetExpire, *map_value);
+            ++count;
+        }
+
+        return count;
+    }
+
+    /*
+        * @brief 获取expire_time在某个时间范围内的数据, O(log n + k)
+        * @param start_time 起始时间
+        * @param end_time 结束时间
+        * @param asc 是否按照过期时间升序排列
+        * @return 返回过期时间在[start_time, end_time]内且尚未过期的数据
+    */
+    std::vector<KeyValue<K, V>> get_by_expire_range(const TimeStamp& start_time, const TimeStamp& end_time, bool asc = true) {
+        if (start_time > end_time) {
+            return {};
+        }
+
+        std::vector<KeyValue<K, V>> result;
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        auto low = _expire_index.lower_bound(start_time);
+        auto high = _expire_index.upper_bound(end_time);
+        for (auto it = low; it != high; ++it) {
+            if (!(*it)->is_expire()) {
+                result.push_back(*(*it));
+            }
+        }
+        lock.unlock();
+        load_cold_values(result);
+
+        if (!asc) {
+            std::reverse(result.begin(), result.end());
+        }
+        return result;
+    }
+
+    /*
+        * @brief 获取最快过期的N条数据, 按过期时间升序排列, O(log n + N)
+        * @param n N
+        * @return 返回N条数据
+    */
+    std::vector<KeyValue<K, V>> get_soonest_expiring(int n) {
+        std::vector<KeyValue<K, V>> result;
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        for (auto it = _expire_index.begin(); it != _expire_index.end() && static_cast<int>(result.size()) < n; ++it) {
+            if (!(*it)->is_expire()) {
+                result.push_back(*(*it));
+            }
+        }
+        lock.unlock();
+        load_cold_values(result);
+
+        return result;
+    }
+
+    /*
+        * @brief 保存快照, 只在复制数据指针时持有锁, 序列化和写文件在锁外进行
+        * 先写入path.tmp再重命名, 保证快照文件总是完整的
+        * @param path 快照文件路径
+        * @return 保存成功返回true, 否则返回false
+    */
+    template<typename KeySerializer = Serializer<K>, typename ValueSerializer = Serializer<V>>
+    bool save_snapshot(const std::string& path) {
+        std::vector<SnapshotEntry> entries;
+        uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            sequence = _change_sequence;
+            collect_snapshot_entries_without_lock(entries);
+        }
+
+        return write_snapshot_file<KeySerializer, ValueSerializer>(path, entries, sequence);
+    }
+
+    /*
+        * @brief 在后台保存快照, 与Redis BGSAVE相同, fork()出的子进程通过写时复制得到一致的内存镜像并写入文件
+        * 调用线程只在fork()期间持有锁, 之后map可以继续读写
+        * @param path 快照文件路径
+        * @return 子进程启动成功返回true, 已有后台快照在进行或fork失败返回false
+    */
+    template<typename KeySerializer = Serializer<K>, typename ValueSerializer = Serializer<V>>
+    bool save_snapshot_background(const std::string& path) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_snapshot_pid > 0) {
+            return false;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            return false;
+        }
+        if (pid == 0) {
+            // 子进程只有当前线程, _mutex的副本由本线程持有, 可以直接读取数据
+            // 其他线程在fork时持有的锁在子进程中永远不会释放, 子进程只能按下面的约定使用锁:
+            // - 不调用SafeMap的任何公开接口, 也不通知key的等待者和watch, 它们会再次加_mutex或_key_waiters等锁
+            // - 不碰WAL的缓冲区和变更流, 它们的锁可能正被写线程或提交线程持有; 不记录热点key
+            // - 不向WorkerPool提交任务, 池的线程在子进程中不存在, _mutex也可能被某个工作线程持有
+            // - 冷数据只通过ColdStore的pread读取, 不碰ColdStore::_append_mutex; 压缩编解码器不加锁
+            // - 解码Interned值会加驻留表的分片锁, ValueInterner在fork()期间持有全部分片锁, 子进程中这些锁都未被持有
+            // - malloc由glibc在fork()时处理, 可以分配内存
+            std::vector<SnapshotEntry> entries;
+            collect_snapshot_entries_without_lock(entries);
+            bool ok = write_snapshot_file<KeySerializer, ValueSerializer>(path, entries, _change_sequence);
+            // 不执行析构函数和atexit, 避免操作从父进程复制来的线程和文件
+            _exit(ok ? 0 : 1);
+        }
+
+        _snapshot_pid = pid;
+        return true;
+    }
+
+    /*
+        * @brief 等待后台快照结束
+        * @return 快照保存成功返回true, 没有后台快照或保存失败返回false
+    */
+    bool wait_snapshot_background() {
+        pid_t pid;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            pid = _snapshot_pid;
+        }
+        if (pid <= 0) {
+            return false;
+        }
+
+        int status = 0;
+        pid_t result;
+        do {
+            result = waitpid(pid, &status, 0);
+        } while (result < 0 && errno == EINTR);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _snapshot_pid = -1;
+        return result == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    /*
+        * @brief 加载快照并替换当前所有数据, 已过期的数据会被跳过
+        * 通过mmap读取文件, 在锁外按插入时间顺序批量构建索引, 最后在锁内一次性替换
+        * @param path 快照文件路径
+        * @return 加载成功返回true, 文件不存在或格式错误返回false
+    */
+    template<typename KeySerializer = Serializer<K>, typename ValueSerializer = Serializer<V>>
+    bool load_snapshot(const std::string& path) {
+        return load_checkpoints<KeySerializer, ValueSerializer>(path, {});
+    }
+
+    /*
+        * @brief 开启增量检查点, 之后每条变更的key和序号都会被记录, 供checkpoint_since()使用
+        * @return 当前的变更序号, 作为第一次checkpoint_since()的since; 之后保存的全量快照都可以作为基础
+    */
+    uint64_t enable_incremental_checkpoint() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _track_checkpoint_changes = true;
+        return _change_sequence;
+    }
+
+    /*
+        * @brief 保存增量检查点, 包含序号大于since的变更涉及的key: 仍然存在的写入当前数据, 已删除或过期的写入删除记录
+        * 以变更序号而不是时间划分, 与上一个检查点之间不会遗漏或重复, 不受系统时钟回拨影响
+        * 需要先调用enable_incremental_checkpoint(), 序号不大于since的记录会被清理
+        * load_snapshot()/restore_entries()替换全部数据后需要重新保存全量快照
+        * @param since 上一个检查点的序号
+        * @param path 检查点文件路径
+        * @param checkpoint_sequence 输出本次检查点的序号, 作为下一次调用的since
+        * @return 保存成功返回true, 未开启增量检查点或写入失败返回false
+    */
+    template<typename KeySerializer = Serializer<K>, typename ValueSerializer = Serializer<V>>
+    bool checkpoint_since(uint64_t since, const std::string& path, uint64_t& checkpoint_sequence) {
+        std::vector<SnapshotEntry> entries;
+        std::vector<K> tombstones;
+        uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (!_track_checkpoint_changes) {
+                return false;
+            }
+            sequence = _change_sequence;
+            checkpoint_sequence = sequence;
+
+            for (auto it = _checkpoint_changes.begin(); it != _checkpoint_changes.end();) {
+                if (it->second <= since) {
+                    it = _checkpoint_changes.erase(it);
+                    continue;
+                }
+                // 同一个key的多次变更只写入最终状态
+                auto found = _data_map.find(it->first);
+                if (found != nullptr && !(*found)->is_expire()) {
+                    entries.push_back(SnapshotEntry{*found, (*found)->get_expire_time(), (*found)->get_expire_time_interval()});
+                } else {
+                    tombstones.push_back(it->first);
+                }
+                ++it;
+            }
+        }
+
+        AtomicFileWriter file;
+        if (!file.open(path)) {
+            return false;
+        }
+
+        std::string buffer;
+        Serializer<SnapshotHeader>::write(buffer, SnapshotHeader{kCheckpointMagic, kSnapshotVersion, entries.size(), sequence});
+        Serializer<uint64_t>::write(buffer, tombstones.size());
+        for (auto& key : tombstones) {
+            KeySerializer::write(buffer, key);
+        }
+        V cold_value;
+        for (auto& entry : entries) {
+            const V* value = resolve_value(*entry.map_value, cold_value);
+            if (value == nullptr) {
+                return false;
+            }
+            write_snapshot_entry<KeySerializer, ValueSerializer>(buffer, *entry.map_value, *value, entry.expire_time, entry.expire_time_interval);
+            if (buffer.size() >= kSnapshotWriteBufferSize) {
+                if (!file.write(buffer)) {
+                    return false;
+                }
+                buffer.clear();
+            }
+        }
+        return file.write(buffer) && file.commit();
+    }
+
+    /*
+        * @brief 加载一个全量快照和若干增量检查点并替换当前所有数据
+        * 按顺序应用每个增量检查点: 先删除其中的key, 再用其中的数据覆盖, 最后统一构建索引
+        * @param base_path 全量快照文件路径
+        * @param delta_paths 增量检查点文件路径, 按保存顺序排列
+        * @return 加载成功返回true, 任一文件不存在或格式错误返回false
+    */
+    template<typename KeySerializer = Serializer<K>, typename ValueSerializer = Serializer<V>>
+    bool load_checkpoints(const std::string& base_path, const std::vector<std::string>& delta_paths) {
+        DataMap new_map;
+        TimeQueue new_queue;
+        uint64_t sequence = 0;
+
+        if (!read_checkpoint_file<KeySerializer, ValueSerializer>(base_path, kSnapshotMagic, new_map, new_queue, sequence)) {
+            return false;
+        }
+        for (auto& path : delta_paths) {
+            if (!read_checkpoint_file<KeySerializer, ValueSerializer>(path, kCheckpointMagic, new_map, new_queue, sequence)) {
+                return false;
+            }
+        }
+
+        // 增量中的数据可能早于已有数据, 需要重新按insert_time排序
+        build_and_replace(new_map, new_queue, sequence, !delta_paths.empty());
+        return true;
+    }
+
+    /*
+        * @brief 开启变更流, 之后的插入/删除/修改过期时间/过期都会带序号发布到环形缓冲区
+        * 已开启时不做任何操作: 消费者持有的是第一次开启时的变更流, 替换后它们将收不到新的变更
+        * @param capacity 环形缓冲区大小, 落后超过该数量的消费者需要重新同步, 只在第一次开启时生效
+        * @return 本次开启返回true, 已开启返回false
+    */
+    bool enable_change_feed(size_t capacity = kDefaultChangeFeedCapacity) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_change_feed) {
+            return false;
+        }
+        _change_feed = std::make_shared<ChangeFeed<K, V>>(capacity);
+        _change_feed->reset(_change_sequence);
+        return true;
+    }
+
+    /*
+        * @brief 获取变更流, 未开启时为空
+    */
+    std::shared_ptr<ChangeFeed<K, V>> get_change_feed() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _change_feed;
+    }
+
+    /*
+        * @brief 把当前所有未过期数据构建为只读的FrozenMap, 之后读取不需要加锁
+        * 只在复制数据时持有锁, 冷数据在锁外读取, 完美哈希在锁外构建; 之后对SafeMap的修改不影响frozen
+        * @param frozen 输出
+        * @return 构建成功返回true, 否则返回false, frozen不变
+    */
+    template<typename Hash = std::hash<K>>
+    bool freeze(FrozenMap<K, V, Hash>& frozen) {
+        std::vector<KeyValue<K, V>> entries;
+        snapshot_for_replication(entries);
+        return frozen.build(std::move(entries));
+    }
+
+    /*
+        * @brief 复制所有未过期数据, 用于消费者落后于变更流时重新同步
+        * @param entries 输出数据, 按insert_time从小到大排列
+        * @return 与数据一致的最后一条变更的序号, 消费者应从该序号+1继续读取变更流
+    */
+    uint64_t snapshot_for_replication(std::vector<KeyValue<K, V>>& entries) {
+        entries.clear();
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        entries.reserve(_data_map.size());
+        for (auto& map_value : _queue) {
+            if (!map_value->is_expire()) {
+                entries.push_back(*map_value);
+            }
+        }
+        uint64_t sequence = _change_sequence;
+        lock.unlock();
+        load_cold_values(entries);
+
+        return sequence;
+    }
+
+    /*
+        * @brief 用一组数据替换当前所有数据, 保留数据中的时间戳, 已过期的数据会被跳过
+        * @param entries 数据
+        * @param sequence 数据对应的最后一条变更的序号
+    */
+    void restore_entries(std::vector<KeyValue<K, V>> entries, uint64_t sequence) {
+        DataMap new_map;
+        TimeQueue new_queue;
+        new_map.reserve(entries.size());
+        for (auto& entry : entries) {
+            auto map_value = std::make_shared<KeyValue<K, V>>(std::move(entry));
+            auto found = new_map.find(map_value->get_key());
+            if (found != nullptr) {
+                (*found)->delete_value();
+            }
+            new_map.assign(map_value);
+            new_queue.push_back(std::move(map_value));
+        }
+
+        build_and_replace(new_map, new_queue, sequence, true);
+    }
+
+    /*
+        * @brief 开启冷存储, insert_time早于cold_age_ms之前且未过期的数据会被转移到文件中, 内存中只保留key和时间戳
+        * 只能开启一次, 冷存储文件只在本次运行中有效
+        * @param path 冷存储文件路径, 已存在的文件会被清空
+        * @param cold_age_ms 数据插入多久之后转移到冷存储, 单位ms
+        * @param options 配置, 可以指定压缩编解码器
+        * @return 开启成功返回true, 已开启或文件创建失败返回false
+    */
+    template<typename ValueSerializer = Serializer<V>>
+    bool enable_cold_tier(const std::string& path, int cold_age_ms, const ColdTierOptions& options = ColdTierOptions()) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_cold_store) {
+            return false;
+        }
+        auto store = std::make_shared<ColdStore>();
+        if (!store->open(path)) {
+            return false;
+        }
+        _cold_age_ms = cold_age_ms;
+        _cold_options = options;
+        _cold_encoder = [](std::string& out, const V& value) {
+            ValueSerializer::write(out, value);
+        };
+        _cold_decoder = [](const char* data, size_t size, V& value) {
+            return ValueSerializer::read(data, data + size, value);
+        };
+        _cold_store = store;
+        return true;
+    }
+
+    /*
+        * @brief 把足够旧的数据转移到冷存储, 由tick线程定期调用
+        * 在锁内选出一批数据, 在锁外序列化、压缩并写入文件, 再在锁内把节点替换为只有key和时间戳的冷节点
+        * key和insert_time不变, 聚合和过期索引不受影响; 期间被删除或更新的数据不转移, 被时间窗口等暂时持有的数据在之后的调用中重试
+        * @return 本次转移的数据条数
+    */
+    int spill_cold() {
+        std::vector<KeyValueSharedPtr> candidates;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (!_cold_store) {
+                return 0;
+            }
+
+            auto threshold = SystemClock::now() - std::chrono::milliseconds(_cold_age_ms);
+            auto it = std::upper_bound(_queue.begin(), _queue.end(), _cold_cursor, [](const TimeStamp& time, const KeyValueSharedPtr& map_value) {
+                return map_value->get_insert_time() > time;
+            });
+            for (; it != _queue.end() && (*it)->get_insert_time() < threshold && candidates.size() < kColdSpillBatchSize; ++it) {
+                auto& map_value = *it;
+                if (!map_value->is_expire() && !map_value->is_cold()) {
+                    if (map_value.use_count() > cold_owner_count(*map_value)) {
+                        break;
+                    }
+                    candidates.push_back(map_value);
+                }
+                _cold_cursor = map_value->get_insert_time();
+            }
+        }
+        if (candidates.empty()) {
+            return 0;
+        }
+
+        // 数据的value在插入后不会被修改, 可以在锁外序列化
+        std::string buffer;
+        std::string scratch;
+        std::vector<size_t> positions;
+        positions.reserve(candidates.size() + 1);
+        for (auto& map_value : candidates) {
+            positions.push_back(buffer.size());
+            encode_cold_record(buffer, map_value->get_value(), scratch);
+        }
+        positions.push_back(buffer.size());
+
+        uint64_t offset = 0;
+        bool ok = _cold_store->append(buffer, offset);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!ok) {
+            // 写入失败时回退游标, 下次重试
+            _cold_cursor = std::min(_cold_cursor, candidates.front()->get_insert_time() - TimeStamp::duration(1));
+            return 0;
+        }
+
+        int count = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            auto& old_value = candidates[i];
+            auto found = _data_map.find(old_value->get_key());
+            if (found == nullptr || *found != old_value) {
+                continue;
+            }
+            // candidates本身也持有一份; 被其他持有者暂时引用的数据回退游标, 下次重试
+            if (old_value.use_count() > cold_owner_count(*old_value) + 1) {
+                _cold_cursor = std::min(_cold_cursor, old_value->get_insert_time() - TimeStamp::duration(1));
+                continue;
+            }
+
+            auto cold_value = std::make_shared<KeyValue<K, V>>(old_value->get_key(), V(), old_value->get_insert_time(),
+                                                               old_value->get_expire_time(), old_value->get_expire_time_interval());
+            cold_value->set_cold(offset + positions[i], static_cast<uint32_t>(positions[i + 1] - positions[i]));
+            cold_value->set_version(old_value->get_version());
+
+            auto range = std::equal_range(_queue.begin(), _queue.end(), old_value, [](const KeyValueSharedPtr& lhs, const KeyValueSharedPtr& rhs) {
+                return lhs->get_insert_time() < rhs->get_insert_time();
+            });
+            auto queue_it = std::find(range.first, range.second, old_value);
+            if (queue_it == range.second) {
+                continue;
+            }
+            *queue_it = cold_value;
+            for (auto& item : _time_windows) {
+                item.second.replace(old_value, cold_value);
+            }
+            if (old_value->get_expire_time_interval() != -1) {
+                _expire_index.erase(old_value);
+                _expire_index.insert(cold_value);
+            }
+            *found = std::move(cold_value);
+            ++count;
+        }
+        _cold_stats.spilled_count += count;
+        return count;
+    }
+
+    /*
+        * @brief 获取冷存储统计
+    */
+    ColdTierStats get_cold_tier_stats() const {
+        ColdTierStats stats;
+        stats.spilled_count = _cold_stats.spilled_count.load();
+        stats.raw_bytes = _cold_stats.raw_bytes.load();
+        stats.stored_bytes = _cold_stats.stored_bytes.load();
+        stats.compressed_count = _cold_stats.compressed_count.load();
+        stats.compress_ns = _cold_stats.compress_ns.load();
+        stats.decompress_count = _cold_stats.decompress_count.load();
+        stats.decompress_ns = _cold_stats.decompress_ns.load();
+        return stats;
+    }
+
+    /*
+        * @brief 开启预写日志, 之后的插入/删除/修改过期时间都会被记录, 过期不记录
+        * 记录在锁内编码到缓冲区, 由组提交线程批量写入文件
+        * 写入失败后日志不再可用, 修改接口拒绝修改并返回失败, 可以用wal_healthy()检查, 重新enable_wal()后恢复
+        * @param path 日志文件路径, 已存在时追加, 应先调用recover()截掉崩溃时写了一半的尾部记录
+        * @param options 组提交和fsync配置, group_commit_interval_ms必须大于0
+        * @return 开启成功返回true, 否则返回false
+    */
+    template<typename KeySerializer = Serializer<K>, typename ValueSerializer = Serializer<V>>
+    bool enable_wal(const std::string& path, const WalOptions& options = WalOptions()) {
+        auto wal = std::make_shared<WriteAheadLog>();
+        if (!wal->open(path, options)) {
+            return false;
+        }
+
+        std::shared_ptr<WriteAheadLog> old_wal;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            old_wal.swap(_wal);
+            _wal = wal;
+            _wal_encoder = [](std::string& out, uint64_t sequence, ChangeType type, const KeyValue<K, V>& map_value) {
+                write_change_record<KeySerializer, ValueSerializer>(out, sequence, type, map_value);
+            };
+        }
+        // 旧日志在锁外关闭: 关闭会等待组提交线程退出并写入剩余记录, 不能阻塞其他读写
+        old_wal.reset();
+        return true;
+    }
+
+    /*
+        * @brief 预写日志是否可用
+        * @return 未开启或没有失败过返回true; 写入或fsync失败后返回false, 此后所有修改接口都拒绝修改并返回失败,
+        * 直到重新enable_wal(); 失败前已返回成功但还未落盘的修改可能丢失, 需要持久化确认时调用sync_wal()
+    */
+    bool wal_healthy() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return !wal_failed_without_lock();
+    }
+
+    /*
+        * @brief 关闭预写日志, 剩余记录会被写入文件
+    */
+    void disable_wal() {
+        std::shared_ptr<WriteAheadLog> wal;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            wal.swap(_wal);
+        }
+    }
+
+    /*
+        * @brief 立即把预写日志写入文件并fsync
+        * @return 成功返回true, 未开启或本次及之前的任何一次写入失败返回false, 失败后需要重新enable_wal()
+    */
+    bool sync_wal() {
+        std::shared_ptr<WriteAheadLog> wal;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            wal = _wal;
+        }
+        return wal && wal->sync();
+    }
+
+    /*
+        * @brief 从快照和预写日志恢复数据, 应在enable_wal()之前调用
+        * 先加载快照(不存在时从空map开始), 再重放日志中序号大于快照序号的变更, 最后截掉崩溃时写了一半的尾部记录
+        * @param snapshot_path 快照文件路径
+        * @param wal_path 日志文件路径
+        * @return 恢复成功返回true, 快照存在但无法加载或日志无法截断时返回false
+    */
+    template<typename KeySerializer = Serializer<K>, typename ValueSerializer = Serializer<V>>
+    bool recover(const std::string& snapshot_path, const std::string& wal_path) {
+        // 加载快照后的序号可能大于快照中的序号, 重放日志要以快照文件中的序号为准
+        bool has_snapshot = ::access(snapshot_path.c_str(), F_OK) == 0;
+        uint64_t snapshot_sequence = 0;
+        if (has_snapshot) {
+            DataMap new_map;
+            TimeQueue new_queue;
+            if (!read_checkpoint_file<KeySerializer, ValueSerializer>(snapshot_path, kSnapshotMagic, new_map, new_queue, snapshot_sequence)) {
+                return false;
+            }
+            build_and_replace(new_map, new_queue, snapshot_sequence, false);
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!has_snapshot) {
+            snapshot_sequence = _change_sequence;
+        }
+        size_t valid_size = 0;
+        WriteAheadLog::read_all(wal_path, [this, snapshot_sequence](const char* data, size_t size) {
+            ChangeRecord<K, V> record;
+            if (!read_change_record<KeySerializer, ValueSerializer>(data, data + size, record)) {
+                return false;
+            }
+            if (record.sequence > snapshot_sequence) {
+                apply_change_without_lock(record);
+            }
+            return true;
+        }, valid_size);
+        // enable_wal()之后的记录追加在有效记录之后, 下次恢复时才能读到
+        return WriteAheadLog::truncate(wal_path, valid_size);
+    }
+
+    /*
+        * @brief 应用一条变更, 保留变更中的时间戳, 已过期的插入会被忽略
+        * @param record 变更
+    */
+    void apply_change(const ChangeRecord<K, V>& record) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        apply_change_without_lock(record);
+    }
+
+    /*
+        * @brief 注册滑动窗口聚合, 统计最近window_ms内插入/更新的数据的count/sum/min/max
+        * @param window_ms 窗口大小, 单位ms
+        * @param extractor 从value中提取参与聚合的数值
+        * @return 聚合id, 用于查询和注销
+    */
+    int add_window_aggregate(int window_ms, std::function<double(const V&)> extractor = [](const V& value) {
+        return static_cast<double>(value);
+    }) {
+        WindowAggregate<K, V> aggregate(window_ms, std::move(extractor));
+        ColdValues decoded;
+        std::vector<KeyValueSharedPtr> missing;
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        // 用窗口内已有的数据初始化, 之后只做增量更新
+        // 冷数据在锁外读取和解压, 期间数据可能变化, 读取后在锁内重新初始化, 直到窗口内的冷数据都已读取
+        while (seed_window_aggregate_without_lock(aggregate, decoded, missing)) {
+            lock.unlock();
+            for (auto& map_value : missing) {
+                std::unique_ptr<V> value(new V());
+                if (!read_cold_value(*map_value, *value)) {
+                    value.reset();
+                }
+                decoded[map_value->get_cold_offset()] = std::move(value);
+            }
+            lock.lock();
+        }
+
+        int id = _next_aggregate_id++;
+        _window_aggregates.emplace(id, std::move(aggregate));
+        return id;
+    }
+
+    /*
+        * @brief 注销滑动窗口聚合
+        * @param id 聚合id
+        * @return 注销成功返回true, 否则返回false
+    */
+    bool remove_window_aggregate(int id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _window_aggregates.erase(id) > 0;
+    }
+
+    /*
+        * @brief 获取滑动窗口聚合结果, 均摊O(1)
+        * @param id 聚合id
+        * @param result 聚合结果
+        * @return 获取成功返回true, 否则返回false
+    */
+    bool get_window_aggregate(int id, WindowAggregateResult& result) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _window_aggregates.find(id);
+        if (it == _window_aggregates.end()) {
+            return false;
+        }
+        it->second.slide(SystemClock::now());
+        result = it->second.get();
+        return true;
+    }
+
+    /*
+        * @brief 注册按insert_time切分的窗口, 窗口结束后由tick线程回调一次窗口内的数据
+        * @param size_ms 窗口大小, 单位ms
+        * @param hop_ms 窗口步长, 单位ms, 等于size_ms时为滚动窗口
+        * @param callback 窗口关闭回调, 在不持有锁的情况下执行
+        * @return 窗口id, 参数非法时返回-1
+    */
+    int add_time_window(int size_ms, int hop_ms, typename TimeWindow<K, V>::Callback callback) {
+        if (size_ms <= 0 || hop_ms <= 0) {
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        int id = _next_time_window_id++;
+        _time_windows.emplace(id, TimeWindow<K, V>(size_ms, hop_ms, std::move(callback), SystemClock::now()));
+        return id;
+    }
+
+    /*
+        * @brief 注销窗口, 尚未关闭的窗口不会再回调
+        * @param id 窗口id
+        * @return 注销成功返回true, 否则返回false
+    */
+    bool remove_time_window(int id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _time_windows.erase(id) > 0;
+    }
+
+private:
+    friend class Transaction<K, V>;
+
+    // 一次scan_if()提交到线程池的任务, 调用线程结束扫描后关闭, 之后开始的任务直接返回
+    struct ScanTasks {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool closed = false;
+        int running = 0;
+        int total = 0;
+        std::exception_ptr error;
+    };
+
+    // 在锁外读取的冷数据, key为冷存储文件中的偏移, 读取失败时为空
+    using ColdValues = std::unordered_map<int64_t, std::unique_ptr<V>>;
+
+    // 快照中的一条数据, 过期时间在锁内复制
+    struct SnapshotEntry {
+        KeyValueSharedPtr map_value;
+        TimeStamp expire_time;
+        int expire_time_interval;
+    };
+
+    /*
+        * @brief 获取值和版本号
+        * @param key 键
+        * @param value 值
+        * @param version 版本号, 不存在或已过期时为0
+        * @return 获取成功返回true, 否则返回false
+    */
+    bool get_with_version(const K& key, V& value, uint64_t& version) {
+        record_access(key);
+        KeyValueSharedPtr cold_value;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (!lookup_without_lock(key, value, version, cold_value)) {
+                return false;
+            }
+        }
+        // 冷数据在锁外从文件读取
+        return cold_value == nullptr || read_cold_value(*cold_value, value);
+    }
+
+    /*
+        * @brief 不加锁获取值和版本号, 已过期的数据会被删除
+        * @param key 键
+        * @param value 值, 冷数据不填充
+        * @param version 版本号, 不存在或已过期时为0
+        * @param cold_value 数据在冷存储中时为该数据, 由调用者在锁外读取
+        * @return 数据存在且未过期返回true, 否则返回false
+    */
+    bool lookup_without_lock(const K& key, V& value, uint64_t& version, KeyValueSharedPtr& cold_value) {
+        version = 0;
+        auto found = _data_map.find(key);
+        if (found == nullptr) {
+            return false;
+        }
+        if ((*found)->is_expire()) {
+            erase_without_lock(key, ChangeType::kExpire);
+            return false;
+        }
+        version = (*found)->get_version();
+        if ((*found)->is_cold()) {
+            cold_value = *found;
+        } else {
+            value = (*found)->get_value();
+        }
+        return true;
+    }
+
+    /*
+        * @brief 不加锁复制某个插入时间范围内未过期的数据, 按插入时间升序
+        * @param start_time 起始时间
+        * @param end_time 结束时间
+        * @param result 复制出的数据
+    */
+    void collect_range_without_lock(const TimeStamp& start_time, const TimeStamp& end_time, std::vector<KeyValue<K, V>>& result) {
+        auto pair = get_range(_queue, start_time, end_time);
+
+        for (auto it = pair.first; it != pair.second; ++it) {
+            if (!(*it)->is_expire()) {
+                result.push_back(*(*it));
+            }
+        }
+    }
+
+    /*
+        * @brief 先读取线程局部缓存, 未命中时加锁读取并填充缓存
+        * @param cache 读缓存
+        * @param key 键
+        * @param value 值
+        * @return 获取成功返回true, 否则返回false
+    */
+    bool get_through_cache(const ReadCache<K, V>& cache, const K& key, V& value) {
+        // 命中缓存的访问也要计入热点统计; 未采样时只修改线程局部状态, 命中路径仍不写共享内存
+        record_access(key);
+        size_t hash = std::hash<K>()(key);
+        if (cache.get(key, hash, value)) {
+            return true;
+        }
+        KeyValueSharedPtr cold_value;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto found = _data_map.find(key);
+            if (found == nullptr) {
+                return false;
+            }
+            if ((*found)->is_expire()) {
+                erase_without_lock(key, ChangeType::kExpire);
+                return false;
+            }
+            if (!(*found)->is_cold()) {
+                value = (*found)->get_value();
+                cache.fill(key, hash, **found);
+                return true;
+            }
+            cold_value = *found;
+        }
+        // 冷数据不进入缓存
+        return read_cold_value(*cold_value, value);
+    }
+
+    /*
+        * @brief 不加锁更新, 先删除旧的数据, 再插入新的数据
+        * @param key 键
+        * @param value 值
+        * @param expire_time_interval 过期时间, 单位ms, -1表示永不过期, 0表示不更新过期时间
+        * @return 新数据的版本号, key不存在返回0
+    */
+    uint64_t update_value_without_lock(const K& key, const V& value, int expire_time_interval) {
+        auto found = _data_map.find(key);
+        if (found == nullptr) {
+            return 0;
+        }
+        auto old_map_value = *found;
+        KeyValueSharedPtr map_value;
+        if (expire_time_interval == 0) {
+            if (old_map_value->get_expire_time_interval() == -1) {
+                map_value = KeyValue<K, V>::create(key, value, -1);
+            } else {
+                map_value = KeyValue<K, V>::create(key, value, old_map_value->get_expire_time_interval());
+            }
+        } else {
+            map_value = KeyValue<K, V>::create(key, value, expire_time_interval);
+        }
+        old_map_value->delete_value();
+        erase_without_lock(old_map_value->get_key());
+        insert_without_lock(key, map_value);
+        return map_value->get_version();
+    }
+
+    /*
+        * @brief 不加锁获取当前版本号, 已过期视为不存在
+        * @param key 键
+        * @return 版本号, 不存在返回0
+    */
+    uint64_t get_version_without_lock(const K& key) {
+        auto found = _data_map.find(key);
+        if (found == nullptr || (*found)->is_expire()) {
+            return 0;
+        }
+        return (*found)->get_version();
+    }
+
+    /*
+        * @brief 提交事务, 在一次加锁中校验读取的版本并应用写入
+        * @param reads key -> 读取时的版本号
+        * @param writes key -> 写入
+        * @return 版本全部一致返回true, 否则或预写日志已失败返回false且不做任何修改
+    */
+    bool commit_transaction(const std::unordered_map<K, uint64_t>& reads, const std::unordered_map<K, TransactionWrite<V>>& writes) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (wal_failed_without_lock()) {
+            return false;
+        }
+        for (auto& read : reads) {
+            if (get_version_without_lock(read.first) != read.second) {
+                return false;
+            }
+        }
+        for (auto& item : writes) {
+            auto& write = item.second;
+            erase_without_lock(item.first);
+            if (!write.erase) {
+                auto map_value = KeyValue<K, V>::create(item.first, write.value, write.expire_time_interval);
+                insert_without_lock(item.first, map_value);
+            }
+        }
+        return true;
+    }
+
+    /*
+        * @brief 不加锁插入
+        * @param key 键
+        * @param map_value 值
+        * @return 插入成功返回true, 否则返回false
+    */
+    bool insert_without_lock(const K& key, KeyValueSharedPtr map_value) {
+        if (_data_map.find(key) != nullptr) {
+            return false;
+        }
+        map_value->set_version(++_next_version);
+        // 永不过期的数据不进入过期索引
+        if (map_value->get_expire_time_interval() != -1) {
+            _expire_index.insert(map_value);
+        }
+
+        _queue.push_back(map_value);
+        
+        _data_map.assign(map_value);
+        invalidate_read_cache_without_lock(key);
+
+        record_change_without_lock(ChangeType::kInsert, *map_value);
+
+        for (auto& item : _window_aggregates) {
+            item.second.add(*map_value);
+        }
+
+        for (auto& item : _time_windows) {
+            item.second.add(map_value);
+        }
+
+        notify_key_without_lock(map_value);
+
+        return true;
+    }
+
+    /*
+        * @brief 不加锁删除
+        * @param key 键
+        * @param type 删除原因, kErase或kExpire
+        * @return 删除成功返回true, 否则返回false
+    */
+    bool erase_without_lock(const K& key, ChangeType type = ChangeType::kErase) {
+        auto found = _data_map.find(key);
+        if (found == nullptr) {
+            return false;
+        } else {
+            // 标记删除, 后续标记删除的数据会在tick()中被延迟删除
+            auto map_value = *found;
+            map_value->delete_value();
+            _expire_index.erase(map_value);
+            notify_erase_without_lock(map_value);
+            record_change_without_lock(type, *map_value);
+            // 从map中删除
+            _data_map.erase(key);
+            invalidate_read_cache_without_lock(key);
+            return true;
+        }
+    }
+
+    /*
+        * @brief 不加锁取出数据, 调用者需先把数据从_queue中移出
+        * @param map_value 从_queue中移出的数据
+        * @param result 未过期的数据会被追加到result中
+    */
+    void drain_without_lock(KeyValueSharedPtr map_value, std::vector<KeyValue<K, V>>& result) {
+        if (map_value->is_expire()) {
+            return;
+        }
+        erase_without_lock(map_value->get_key());
+        // 没有其他持有者时直接移动, 否则只能复制
+        if (map_value.use_count() == 1) {
+            result.push_back(std::move(*map_value));
+        } else {
+            result.push_back(*map_value);
+        }
+        result.back().undelete_value();
+    }
+
+    /*
+        * @brief 不加锁删除过期数据, 只有map中仍指向该数据时才从map中删除
+        * @param map_value 过期的数据
+    */
+    void expire_without_lock(KeyValueSharedPtr map_value) {
+        auto found = _data_map.find(map_value->get_key());
+        if (found != nullptr && *found == map_value) {
+            erase_without_lock(map_value->get_key(), ChangeType::kExpire);
+        }
+        map_value->delete_value();
+        _expire_index.erase(map_value);
+    }
+
+    /*
+        * @brief 预写日志是否已失败, 修改接口在修改任何数据前检查, 已失败时拒绝修改
+    */
+    bool wal_failed_without_lock() const {
+        return _wal && !_wal->healthy();
+    }
+
+    /*
+        * @brief 记录一条变更, 分配序号并写入预写日志和变更流; 重放变更时只记录增量检查点需要的删除
+        * @param type 变更类型
+        * @param map_value 变更后的数据
+    */
+    void record_change_without_lock(ChangeType type, const KeyValue<K, V>& map_value) {
+        // 重放变更时序号在应用之后才前进到记录中的序号, 不小于_change_sequence + 1, 同样大于之前检查点的序号
+        if (_track_checkpoint_changes) {
+            _checkpoint_changes[map_value.get_key()] = _change_sequence + 1;
+        }
+        if (_applying_change) {
+            return;
+        }
+        ++_change_sequence;
+
+        // 过期可以由时间戳重新推导, 不写入日志
+        if (_wal && type != ChangeType::kExpire) {
+            _wal_record.clear();
+            _wal_encoder(_wal_record, _change_sequence, type, map_value);
+            // 修改前已检查过wal_failed_without_lock(), 这里仍失败说明组提交线程在检查之后才失败,
+            // 这条记录与失败批次中已缓冲的记录一样不会落盘, 由wal_healthy()/sync_wal()报告; 修改已生效, 变更流照常发布
+            _wal->append(_wal_record);
+        }
+
+        if (_change_feed) {
+            auto record = std::make_shared<ChangeFeedRecord<K, V>>();
+            record->record = ChangeRecord<K, V>{_change_sequence, type, map_value.get_key(),
+                                                type == ChangeType::kInsert ? map_value.get_value() : V(),
+                                                map_value.get_insert_time(), map_value.get_expire_time(),
+                                                map_value.get_expire_time_interval()};
+            record->publish_time = SystemClock::now();
+            _change_feed->publish(std::move(record));
+        }
+    }
+
+    /*
+        * @brief 从冷存储文件读取数据的value, 冷存储开启后不再改变, 可以在锁外调用
+        * @param map_value 冷数据
+        * @param value 输出value
+        * @return 读取成功返回true, 否则返回false
+    */
+    bool read_cold_value(const KeyValue<K, V>& map_value, V& value) const {
+        std::string data;
+        return _cold_store->read(map_value.get_cold_offset(), map_value.get_cold_size(), data) && decode_cold_record(data, value);
+    }
+
+    /*
+        * @brief 只被_queue、_data_map和_expire_index持有的数据才能替换为冷节点
+    */
+    static long cold_owner_count(const KeyValue<K, V>& map_value) {
+        return map_value.get_expire_time_interval() == -1 ? 2 : 3;
+    }
+
+    /*
+        * @brief 序列化一条冷数据, 格式为 uint8标志 + 内容, 超过阈值且压缩后更小时写入压缩后的内容
+        * @param out 输出
+        * @param value 值
+        * @param scratch 临时缓冲区
+    */
+    void encode_cold_record(std::string& out, const V& value, std::string& scratch) {
+        scratch.clear();
+        _cold_encoder(scratch, value);
+        size_t start = out.size();
+        _cold_stats.raw_bytes += scratch.size();
+
+        if (_cold_options.codec && scratch.size() >= _cold_options.compress_threshold) {
+            auto begin = std::chrono::steady_clock::now();
+            out.push_back(static_cast<char>(kColdRecordLz));
+            _cold_options.codec->compress(scratch.data(), scratch.size(), out);
+            _cold_stats.compress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+            if (out.size() - start - 1 < scratch.size()) {
+                ++_cold_stats.compressed_count;
+                _cold_stats.stored_bytes += out.size() - start;
+                return;
+            }
+            out.resize(start);
+        }
+        out.push_back(static_cast<char>(kColdRecordRaw));
+        out.append(scratch);
+        _cold_stats.stored_bytes += out.size() - start;
+    }
+
+    /*
+        * @brief 反序列化一条冷数据, 在锁外调用
+        * @param data 冷存储文件中的记录
+        * @param value 输出value
+        * @return 成功返回true, 数据损坏返回false
+    */
+    bool decode_cold_record(const std::string& data, V& value) const {
+        if (data.empty()) {
+            return false;
+        }
+        if (static_cast<uint8_t>(data[0]) == kColdRecordRaw) {
+            return _cold_decoder(data.data() + 1, data.size() - 1, value);
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        std::string raw;
+        bool ok = _cold_options.codec && _cold_options.codec->decompress(data.data() + 1, data.size() - 1, raw);
+        ++_cold_stats.decompress_count;
+        _cold_stats.decompress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        return ok && _cold_decoder(raw.data(), raw.size(), value);
+    }
+
+    /*
+        * @brief 获取数据的value, 冷数据从冷存储文件读取到buffer中
+        * @param map_value 数据
+        * @param buffer 冷数据的value
+        * @return value的地址, 读取失败返回nullptr
+    */
+    const V* resolve_value(const KeyValue<K, V>& map_value, V& buffer) const {
+        if (!map_value.is_cold()) {
+            return &map_value.get_value();
+        }
+        return read_cold_value(map_value, buffer) ? &buffer : nullptr;
+    }
+
+    /*
+        * @brief 把结果中的冷数据替换为带value的数据, 按文件偏移排序后批量读取, 在锁外调用
+        * 读取失败的数据会从结果中移除
+        * @param result 从map中复制出的数据
+    */
+    void load_cold_values(std::vector<KeyValue<K, V>>& result) const {
+        std::vector<size_t> cold;
+        for (size_t i = 0; i < result.size(); ++i) {
+            if (result[i].is_cold()) {
+                cold.push_back(i);
+            }
+        }
+        if (cold.empty()) {
+            return;
+        }
+
+        std::sort(cold.begin(), cold.end(), [&result](size_t lhs, size_t rhs) {
+            return result[lhs].get_cold_offset() < result[rhs].get_cold_offset();
+        });
+        std::vector<std::pair<uint64_t, uint32_t>> ranges;
+        ranges.reserve(cold.size());
+        for (auto i : cold) {
+            ranges.emplace_back(result[i].get_cold_offset(), result[i].get_cold_size());
+        }
+        std::vector<std::string> data;
+        bool ok = _cold_store->read_batch(ranges, data);
+
+        for (size_t j = 0; ok && j < cold.size(); ++j) {
+            auto& entry = result[cold[j]];
+            V value;
+            if (decode_cold_record(data[j], value)) {
+                entry = KeyValue<K, V>(entry.get_key(), std::move(value), entry.get_insert_time(), entry.get_expire_time(),
+                                       entry.get_expire_time_interval());
+            }
+        }
+        result.erase(std::remove_if(result.begin(), result.end(), [](const KeyValue<K, V>& entry) {
+            return entry.is_cold();
+        }), result.end());
+    }
+
+    /*
+        * @brief 不加锁应用一条变更, 期间产生的插入/删除不会再次被记录
+        * @param record 变更
+    */
+    void apply_change_without_lock(const ChangeRecord<K, V>& record) {
+        _applying_change = true;
+        switch (record.type) {
+        case ChangeType::kInsert:
+            erase_without_lock(record.key);
+            if (record.expire_time_interval == -1 || record.expire_time >= SystemClock::now()) {
+                insert_without_lock(record.key, std::make_shared<KeyValue<K, V>>(record.key, record.value, record.insert_time,
+                                                                                 record.expire_time, record.expire_time_interval));
+            }
+            break;
+        case ChangeType::kErase:
+        case ChangeType::kExpire:
+            erase_without_lock(record.key);
+            break;
+        case ChangeType::kSetExpire: {
+            auto found = _data_map.find(record.key);
+            if (found != nullptr) {
+                auto map_value = *found;
+                _expire_index.erase(map_value);
+                map_value->set_expire_time(record.expire_time, record.expire_time_interval);
+                if (record.expire_time_interval != -1) {
+                    _expire_index.insert(map_value);
+                }
+                invalidate_read_cache_without_lock(record.key);
+            }
+            break;
+        }
+        }
+        _applying_change = false;
+        _change_sequence = std::max(_change_sequence, record.sequence);
+    }
+
+    /*
+        * @brief 热点key统计的采样点, 未开启时只有一次原子读取
+    */
+    void record_access(const K& key) {
+        HeavyHitter<K>* tracker = _hot_keys.load(std::memory_order_acquire);
+        if (tracker != nullptr) {
+            tracker->record(key);
+        }
+    }
+
+    /*
+        * @brief key的数据或过期时间改变后使各线程缓存的旧数据失效, 关闭读缓存后仍然递增版本号
+        * @param key 键
+    */
+    void invalidate_read_cache_without_lock(const K& key) {
+        if (_read_cache_owner) {
+            _read_cache_owner->invalidate(key);
+        }
+    }
+
+    size_t key_stripe(const K& key) const {
+        return std::hash<K>()(key) % kKeyWaitStripes;
+    }
+
+    /*
+        * @brief key被插入或更新时唤醒等待该分片的线程, 并为监听该key的回调排队
+        * @param map_value 新的数据
+    */
+    void notify_key_without_lock(const KeyValueSharedPtr& map_value) {
+        if (_key_waiter_count > 0) {
+            size_t stripe = key_stripe(map_value->get_key());
+            if (_key_waiters[stripe] > 0) {
+                _key_wait_cvs[stripe].notify_all();
+            }
+        }
+        if (_watched_keys.empty()) {
+            return;
+        }
+        auto it = _watched_keys.find(map_value->get_key());
+        if (it == _watched_keys.end()) {
+            return;
+        }
+        for (int id : it->second) {
+            _watch_events.emplace_back(id, map_value);
+        }
+        _watch_cv.notify_one();
+    }
+
+    /*
+        * @brief 通知线程, 依次取出通知并在锁外执行回调
+    */
+    void loop_watch() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _watch_cv.wait(lock, [this] {
+                return !_watch_events.empty() || !_is_running;
+            });
+            if (!_is_running) {
+                break;
+            }
+            auto event = std::move(_watch_events.front());
+            _watch_events.pop_front();
+            auto it = _watches.find(event.first);
+            if (it == _watches.end()) {
+                continue;
+            }
+            auto callback = it->second.second;
+            // 通知中持有节点, 节点中的value不会被转移到冷存储
+            KeyValue<K, V> entry = *event.second;
+            lock.unlock();
+            (*callback)(entry);
+            lock.lock();
+        }
+    }
+
+    /*
+        * @brief 数据离开map时通知滑动窗口聚合
+        * @param map_value 被删除的数据
+    */
+    void notify_erase_without_lock(const KeyValueSharedPtr& map_value) {
+        for (auto& item : _window_aggregates) {
+            item.second.remove(*map_value);
+        }
+    }
+
+    /*
+        * @brief erase_if/count_if共用的线程池, 第一次使用时创建, 之后一直保留到析构
+        * @return 线程池, 只有一个核或线程数设为1时为空, 扫描只在调用线程中执行
+    */
+    WorkerPool* scan_pool() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_scan_pool) {
+            int worker_count = _scan_worker_count;
+            if (worker_count == 0) {
+                worker_count = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), kMaxScanWorkers));
+            }
+            if (worker_count == 1) {
+                return nullptr;
+            }
+            _scan_pool.reset(new WorkerPool(worker_count - 1));
+        }
+        return _scan_pool.get();
+    }
+
+    /*
+        * @brief 扫描开始时已存在的数据, 多个线程按insert_time分批取出数据并在锁外执行pred
+        * 以insert_time作为游标, 每批重新二分查找, 不受批次之间_queue变化的影响
+        * @param pred 判断条件
+        * @param erase 是否删除满足条件的数据
+        * @return 满足条件(erase为true时为实际删除)的数据个数
+    */
+    template<typename Predicate>
+    int scan_if(Predicate& pred, bool erase) {
+        struct Cursor {
+            TimeStamp scan_end;
+            TimeStamp last_time;
+            bool started;
+            bool finished;
+        };
+        Cursor cursor{SystemClock::now(), TimeStamp(), false, false};
+
+        // 在锁内取出下一批数据, 相同insert_time的数据总是在同一批中
+        auto next_chunk = [this, &cursor](std::vector<KeyValueSharedPtr>& chunk) {
+            chunk.clear();
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (cursor.finished) {
+                return false;
+            }
+
+            auto it = _queue.begin();
+            if (cursor.started) {
+                it = std::upper_bound(_queue.begin(), _queue.end(), cursor.last_time, [](const TimeStamp& time, const KeyValueSharedPtr& map_value) {
+                    return map_value->get_insert_time() > time;
+                });
+            }
+            for (int count = 0; it != _queue.end() && (*it)->get_insert_time() <= cursor.scan_end; ++it, ++count) {
+                if (count >= kScanChunkSize && (*it)->get_insert_time() != cursor.last_time) {
+                    break;
+                }
+                cursor.last_time = (*it)->get_insert_time();
+                cursor.started = true;
+                if (!(*it)->is_expire()) {
+                    chunk.push_back(*it);
+                }
+            }
+            if (it == _queue.end() || (*it)->get_insert_time() > cursor.scan_end) {
+                cursor.finished = true;
+            }
+            return true;
+        };
+
+        auto worker = [this, &pred, erase, &next_chunk]() {
+            int total = 0;
+            std::vector<KeyValueSharedPtr> chunk;
+            std::vector<KeyValueSharedPtr> matched;
+            while (next_chunk(chunk)) {
+                // 数据的key和value在插入后不会被修改, 可以在锁外读取
+                matched.clear();
+                V cold_value;
+                for (auto& map_value : chunk) {
+                    const V* value = resolve_value(*map_value, cold_value);
+                    if (value != nullptr && pred(map_value->get_key(), *value)) {
+                        matched.push_back(map_value);
+                    }
+                }
+                if (!erase) {
+                    total += static_cast<int>(matched.size());
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (wal_failed_without_lock()) {
+                    continue;
+                }
+                for (auto& map_value : matched) {
+                    // 只删除仍然是同一条数据的key, 期间被更新过的数据保持不变
+                    auto found = _data_map.find(map_value->get_key());
+                    if (found != nullptr && *found == map_value && erase_without_lock(map_value->get_key())) {
+                        ++total;
+                    }
+                }
+            }
+            return total;
+        };
+
+        // pred在本map的池中的线程上嵌套调用erase_if/count_if时, 提交的任务只能排在自己后面, 只在当前线程中扫描
+        WorkerPool* pool = scan_pool();
+        if (pool != nullptr && pool->in_worker_thread()) {
+            pool = nullptr;
+        }
+        auto tasks = std::make_shared<ScanTasks>();
+        for (int i = 0; pool != nullptr && i < pool->size(); ++i) {
+            pool->submit([tasks, &worker] {
+                run_scan_task(*tasks, worker);
+            });
+        }
+
+        // 当前线程也参与扫描, 完成后取消还没有开始的任务, 只等待已经开始的任务
+        // 池中的线程都在等待其他扫描(如两个map的pred互相嵌套扫描)时, 扫描也能完成
+        int total = 0;
+        std::exception_ptr error;
+        try {
+            total = worker();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::unique_lock<std::mutex> lock(tasks->mutex);
+        tasks->closed = true;
+        tasks->cv.wait(lock, [&tasks] {
+            return tasks->running == 0;
+        });
+        if (!error) {
+            error = tasks->error;
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return total + tasks->total;
+    }
+
+    /*
+        * @brief 执行一个提交到线程池的扫描任务, 扫描已结束时直接返回, 不再访问调用者栈上的数据
+        * @param tasks 扫描任务的共享状态
+        * @param worker 扫描函数
+    */
+    template<typename Worker>
+    static void run_scan_task(ScanTasks& tasks, Worker& worker) {
+        {
+            std::lock_guard<std::mutex> lock(tasks.mutex);
+            if (tasks.closed) {
+                return;
+            }
+            ++tasks.running;
+        }
+        int count = 0;
+        std::exception_ptr error;
+        try {
+            count = worker();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(tasks.mutex);
+        tasks.total += count;
+        if (error && !tasks.error) {
+            tasks.error = error;
+        }
+        if (--tasks.running == 0) {
+            tasks.cv.notify_all();
+        }
+    }
+
+    /*
+        * @brief 清理新数据中被覆盖或已过期的部分, 构建索引后在锁内替换当前所有数据
+        * @param new_map 新的map, 已删除的数据已标记删除
+        * @param new_queue 新数据中的所有节点, 包括已标记删除的
+        * @param sequence 新数据对应的最后一条变更的序号, 替换后的序号为 max(当前序号 + 1, sequence)
+        * @param need_sort new_queue是否可能不按insert_time有序
+    */
+    void build_and_replace(DataMap& new_map, TimeQueue& new_queue, uint64_t sequence, bool need_sort) {
+        TimeQueue live_queue;
+        std::vector<KeyValueSharedPtr> expiring;
+        for (auto& map_value : new_queue) {
+            if (map_value->is_expire()) {
+                auto found = new_map.find(map_value->get_key());
+                if (found != nullptr && *found == map_value) {
+                    new_map.erase(map_value->get_key());
+                }
+                continue;
+            }
+            if (map_value->get_expire_time_interval() != -1) {
+                expiring.push_back(map_value);
+            }
+            live_queue.push_back(std::move(map_value));
+        }
+        if (need_sort) {
+            std::stable_sort(live_queue.begin(), live_queue.end(), [](const KeyValueSharedPtr& lhs, const KeyValueSharedPtr& rhs) {
+                return lhs->get_insert_time() < rhs->get_insert_time();
+            });
+        }
+
+        // 先排序再构建, 有序输入时std::set逐个追加到末尾, 整体为线性时间
+        std::sort(expiring.begin(), expiring.end(), ExpireCompare());
+        ExpireIndex new_index(expiring.begin(), expiring.end());
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& map_value : live_queue) {
+            map_value->set_version(++_next_version);
+        }
+        replace_without_lock(new_map, live_queue, new_index);
+        // 序号不能回退: 否则变更流会重新发布消费者已应用过的序号, 等待中的消费者会把新记录应用到旧数据上
+        // 至少前进1, 使已追上的消费者请求的下一条序号也落在重置点之内, 从而收到kLagged
+        _change_sequence = std::max(_change_sequence + 1, sequence);
+        // 变更流中的记录已不能描述新数据, 消费者需要重新同步
+        if (_change_feed) {
+            _change_feed->reset(_change_sequence);
+        }
+    }
+
+    /*
+        * @brief 不加锁用一份新的数据替换当前所有数据, 旧数据会被标记删除
+        * @param new_map 新的_data_map, 调用后内容为旧数据
+        * @param new_queue 新的_queue, 调用后内容为旧数据
+        * @param new_index 新的_expire_index, 调用后内容为旧数据
+    */
+    void replace_without_lock(DataMap& new_map, TimeQueue& new_queue, ExpireIndex& new_index) {
+        _data_map.for_each([](KeyValueSharedPtr& map_value) {
+            map_value->delete_value();
+        });
+        _data_map.swap(new_map);
+        _queue.swap(new_queue);
+        _expire_index.swap(new_index);
+        if (_read_cache_owner) {
+            _read_cache_owner->invalidate_all();
+        }
+        // 新数据都在内存中, 重新从头开始转移冷数据
+        _cold_cursor = TimeStamp();
+        // 等待的key可能出现在新数据中
+        if (_key_waiter_count > 0) {
+            for (auto& cv : _key_wait_cvs) {
+                cv.notify_all();
+            }
+        }
+
+        // 新数据都在内存中, 没有冷数据需要读取
+        ColdValues decoded;
+        std::vector<KeyValueSharedPtr> missing;
+        for (auto& item : _window_aggregates) {
+            seed_window_aggregate_without_lock(item.second, decoded, missing);
+        }
+    }
+
+    /*
+        * @brief 清空滑动窗口聚合并用窗口内已有的数据重新初始化, 不读取冷存储文件
+        * @param aggregate 滑动窗口聚合
+        * @param decoded 已在锁外读取的冷数据
+        * @param missing 输出decoded中没有的冷数据, 由调用者在锁外读取后重新初始化
+        * @return 有冷数据尚未读取返回true, 此时aggregate不完整
+    */
+    bool seed_window_aggregate_without_lock(WindowAggregate<K, V>& aggregate, const ColdValues& decoded, std::vector<KeyValueSharedPtr>& missing) {
+        aggregate.clear();
+        missing.clear();
+        auto now = SystemClock::now();
+        auto pair = get_range(_queue, now - std::chrono::milliseconds(aggregate.get_window_ms()), now);
+        for (auto it = pair.first; it != pair.second; ++it) {
+            if ((*it)->is_expire()) {
+                continue;
+            }
+            if (!(*it)->is_cold()) {
+                aggregate.add(*(*it));
+                continue;
+            }
+            auto found = decoded.find((*it)->get_cold_offset());
+            if (found == decoded.end()) {
+                missing.push_back(*it);
+            } else if (found->second) {
+                // 读取失败的冷数据不参与聚合
+                aggregate.add(KeyValue<K, V>((*it)->get_key(), *found->second, (*it)->get_insert_time(),
+                                             (*it)->get_expire_time(), (*it)->get_expire_time_interval()));
+            }
+        }
+        return !missing.empty();
+    }
+
+    /*
+        * @brief 不加锁收集所有未过期数据, 过期时间可能被原地修改, 需要在锁内复制; key和value插入后不变
+        * @param entries 输出数据
+    */
+    void collect_snapshot_entries_without_lock(std::vector<SnapshotEntry>& entries) {
+        entries.reserve(_data_map.size());
+        for (auto& map_value : _queue) {
+            if (!map_value->is_expire()) {
+                entries.push_back(SnapshotEntry{map_value, map_value->get_expire_time(), map_value->get_expire_time_interval()});
+            }
+        }
+    }
+
+    /*
+        * @brief 把数据写入快照文件
+        * @param path 快照文件路径
+        * @param entries 数据, 按insert_time从小到大排列
+        * @param sequence 快照对应的最后一条变更的序号
+        * @return 成功返回true, 否则返回false
+    */
+    template<typename KeySerializer, typename ValueSerializer>
+    bool write_snapshot_file(const std::string& path, const std::vector<SnapshotEntry>& entries, uint64_t sequence) {
+        AtomicFileWriter file;
+        if (!file.open(path)) {
+            return false;
+        }
+
+        std::string buffer;
+        Serializer<SnapshotHeader>::write(buffer, SnapshotHeader{kSnapshotMagic, kSnapshotVersion, entries.size(), sequence});
+        V cold_value;
+        for (auto& entry : entries) {
+            const V* value = resolve_value(*entry.map_value, cold_value);
+            if (value == nullptr) {
+                return false;
+            }
+            write_snapshot_entry<KeySerializer, ValueSerializer>(buffer, *entry.map_value, *value, entry.expire_time, entry.expire_time_interval);
+            if (buffer.size() >= kSnapshotWriteBufferSize) {
+                if (!file.write(buffer)) {
+                    return false;
+                }
+                buffer.clear();
+            }
+        }
+        return file.write(buffer) && file.commit();
+    }
+
+    /*
+        * @brief 读取一个快照或增量检查点文件, 应用到正在构建的数据上
+        * 被覆盖或删除的旧数据只标记删除, 由调用者统一清理
+        * @param path 文件路径
+        * @param magic 期望的文件类型, kSnapshotMagic或kCheckpointMagic
+        * @param new_map 正在构建的map
+        * @param new_queue 正在构建的队列
+        * @param sequence 输出文件对应的最后一条变更的序号
+        * @return 成功返回true, 文件不存在或格式错误返回false
+    */
+    template<typename KeySerializer, typename ValueSerializer>
+    static bool read_checkpoint_file(const std::string& path, uint32_t magic, DataMap& new_map, TimeQueue& new_queue, uint64_t& sequence) {
+        MappedFile file;
+        if (!file.open(path)) {
+            return false;
+        }
+
+        const char* data = file.data();
+        const char* end = data + file.size();
+        SnapshotHeader header;
+        if (!Serializer<SnapshotHeader>::read(data, end, header) || header.magic != magic || header.version > kSnapshotVersion) {
+            return false;
+        }
+
+        auto erase_key = [&new_map](const K& key) {
+            auto found = new_map.find(key);
+            if (found != nullptr) {
+                (*found)->delete_value();
+                new_map.erase(key);
+            }
+        };
+
+        if (magic == kCheckpointMagic) {
+            uint64_t tombstone_count;
+            if (!Serializer<uint64_t>::read(data, end, tombstone_count)) {
+                return false;
+            }
+            for (uint64_t i = 0; i < tombstone_count; ++i) {
+                K key;
+                if (!KeySerializer::read(data, end, key)) {
+                    return false;
+                }
+                erase_key(key);
+            }
+        } else {
+            // entry_count来自未校验的文件头, 按剩余字节数能容纳的最多条数截断, 损坏的文件不会导致超大的分配
+            uint64_t max_count = static_cast<uint64_t>(end - data) / kSnapshotEntryMinSize;
+            new_map.reserve(static_cast<size_t>(std::min(header.entry_count, max_count)));
+        }
+
+        auto now = SystemClock::now();
+        for (uint64_t i = 0; i < header.entry_count; ++i) {
+            KeyValueSharedPtr map_value;
+            if (!read_snapshot_entry<KeySerializer, ValueSerializer>(data, end, map_value)) {
+                return false;
+            }
+            // 增量中的数据总是比已有的数据新, 即使已过期也要覆盖旧数据
+            erase_key(map_value->get_key());
+            if (map_value->get_expire_time_interval() != -1 && map_value->get_expire_time() < now) {
+                continue;
+            }
+            new_queue.push_back(map_value);
+            new_map.assign(std::move(map_value));
+        }
+
+        sequence = header.sequence;
+        return true;
+    }
+
+    /*
+        * @brief 序列化一条快照数据, 格式为 insert_time expire_time expire_time_interval key value
+        * @param out 输出
+        * @param map_value 数据
+        * @param value 数据的value, 冷数据需要先从冷存储文件读取
+        * @param expire_time 过期时间
+        * @param expire_time_interval 过期时间间隔
+    */
+    template<typename KeySerializer, typename ValueSerializer>
+    static void write_snapshot_entry(std::string& out, const KeyValue<K, V>& map_value, const V& value, const TimeStamp& expire_time, int expire_time_interval) {
+        Serializer<int64_t>::write(out, to_nanoseconds(map_value.get_insert_time()));
+        Serializer<int64_t>::write(out, to_nanoseconds(expire_time));
+        Serializer<int32_t>::write(out, expire_time_interval);
+        KeySerializer::write(out, map_value.get_key());
+        ValueSerializer::write(out, value);
+    }
+
+    /*
+        * @brief 反序列化一条快照数据
+        * @param data 读取位置, 成功后指向下一条数据
+        * @param end 数据结尾
+        * @param map_value 输出数据
+        * @return 成功返回true, 数据不完整返回false
+    */
+    template<typename KeySerializer, typename ValueSerializer>
+    static bool read_snapshot_entry(const char*& data, const char* end, KeyValueSharedPtr& map_value) {
+        int64_t insert_time;
+        int64_t expire_time;
+        int32_t expire_time_interval;
+        K key;
+        V value;
+        if (!Serializer<int64_t>::read(data, end, insert_time) || !Serializer<int64_t>::read(data, end, expire_time)
+            || !Serializer<int32_t>::read(data, end, expire_time_interval)
+            || !KeySerializer::read(data, end, key) || !ValueSerializer::read(data, end, value)) {
+            return false;
+        }
+        map_value = std::make_shared<KeyValue<K, V>>(std::move(key), std::move(value), from_nanoseconds(insert_time),
+                                                     from_nanoseconds(expire_time), expire_time_interval);
+        return true;
+    }
+
+    /*
+        * @brief 获取start_time到end_time对应在_queue中的两个迭代器
+        * @param temp_queue 临时队列
+        * @param start_time 起始时间
+        * @param end_time 结束时间
+        * @return std::pair<low, high> low为大于等于start_time的第一个元素, high为大于end_time的第一个元素
+    */
+    auto get_range(const TimeQueue& temp_queue, const TimeStamp& start_time, const TimeStamp& end_time) {
         auto low = std::upper_bound(temp_queue.begin(), temp_queue.end(), start_time, [](const TimeStamp& time, const KeyValueSharedPtr map_value) {
             return map_value->get_insert_time() >= time;
         });
@@ -337,32 +2573,34 @@ private:
     void tick() {
         std::lock_guard<std::mutex> lock(_mutex);
 
-        while (!_min_expire_heap.empty()) {
-            auto top = _min_expire_heap.top();
+        while (!_expire_index.empty()) {
+            auto top = *_expire_index.begin();
             if (top->is_expire()) {
-                top->delete_value();
-                _min_expire_heap.pop();
+                expire_without_lock(top);
                 continue;
             }
             break;
         }
 
+        auto now = SystemClock::now();
+        for (auto& item : _window_aggregates) {
+            item.second.slide(now);
+        }
+
     }
 
     void tick_all() {
-        decltype(_min_expire_heap) new_heap;
         decltype(_queue) new_queue;
         std::lock_guard<std::mutex> lock(_mutex);
 
-        while (!_min_expire_heap.empty()) {
-            auto top = _min_expire_heap.top();
+        // 过期索引中只有未删除的数据, 且按expire_time有序, 只需要清理头部
+        while (!_expire_index.empty()) {
+            auto top = *_expire_index.begin();
             if (top->is_expire()) {
-                top->delete_value();
-                _min_expire_heap.pop();
+                expire_without_lock(top);
                 continue;
             }
-            new_heap.push(top);
-            _min_expire_heap.pop();
+            break;
         }
 
         while (!_queue.empty()) {
@@ -377,27 +2615,47 @@ private:
         }
 
         // 若map中的数据过期则清除map中的数据
-        for (auto it = _data_map.begin(); it != _data_map.end();) {
-            if (it->second->is_expire()) {
-                it->second->delete_value();
-                it = _data_map.erase(it);
-            } else {
-                ++it;
+        std::vector<KeyValueSharedPtr> expired;
+        _data_map.for_each([&expired](KeyValueSharedPtr& map_value) {
+            if (map_value->is_expire()) {
+                expired.push_back(map_value);
             }
+        });
+        for (auto& map_value : expired) {
+            expire_without_lock(map_value);
         }
 
-        _min_expire_heap.swap(new_heap);
         _queue.swap(new_queue);
     }
 
+    /*
+        * @brief 关闭所有已结束的窗口, 并在释放锁后执行回调
+    */
+    void close_time_windows() {
+        std::vector<typename TimeWindow<K, V>::Emission> emissions;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto now = SystemClock::now();
+            for (auto& item : _time_windows) {
+                item.second.close(now, emissions);
+            }
+        }
+
+        for (auto& emission : emissions) {
+            load_cold_values(emission.entries);
+            (*emission.callback)(emission.start, emission.end, emission.entries);
+        }
+    }
+
     /*
         * @brief 循环调用tick()清除过期数据
     */
     void loop_tick() {
         int count = 0;
         while (_is_running) {
-            // 打印_data_map _min_expire_heap _queue的大小
-            std::cout << "data_map size: " << _data_map.size() << " min_expire_heap size: " << _min_expire_heap.size() << " queue size: " << _queue.size() << std::endl;
+            // 打印_data_map _expire_index _queue的大小
+            std::cout << "data_map size: " << _data_map.size() << " expire_index size: " << _expire_index.size() << " queue size: " << _queue.size() << std::endl;
             
             int interval = kDefaultCheckInterval;
             std::this_thread::sleep_for(std::chrono::milliseconds(interval));
@@ -413,24 +2671,39 @@ private:
                 tick();
                 ++count;
             }
+            close_time_windows();
+            spill_cold();
         }
     }
 
     // 存储对应的key-value
-    std::unordered_map<K, KeyValueSharedPtr> _data_map;
+    DataMap _data_map;
+
+    // KeyValue根据expire_time从小到大排序函数, expire_time相同时按地址排序, 支持直接用TimeStamp查找
+    struct ExpireCompare {
+        using is_transparent = void;
 
-    // KeyValue根据expire_time从小到大排序函数
-    struct MinExpireCompare {
-        bool operator()(const KeyValueSharedPtr lhs, const KeyValueSharedPtr rhs) {
-            return lhs->get_expire_time() > rhs->get_expire_time();
+        bool operator()(const KeyValueSharedPtr& lhs, const KeyValueSharedPtr& rhs) const {
+            if (lhs->get_expire_time() != rhs->get_expire_time()) {
+                return lhs->get_expire_time() < rhs->get_expire_time();
+            }
+            return lhs.get() < rhs.get();
+        }
+
+        bool operator()(const KeyValueSharedPtr& lhs, const TimeStamp& rhs) const {
+            return lhs->get_expire_time() < rhs;
+        }
+
+        bool operator()(const TimeStamp& lhs, const KeyValueSharedPtr& rhs) const {
+            return lhs < rhs->get_expire_time();
         }
     };
 
-    // 最小堆存储KeyValue, 根据expire_time从小到大排序
-    std::priority_queue<KeyValueSharedPtr, std::vector<KeyValueSharedPtr>, MinExpireCompare> _min_expire_heap;
+    // 过期索引, 存储会过期且未删除的KeyValue, 根据expire_time从小到大排序
+    ExpireIndex _expire_index;
 
     // 双端队列, 按照insert_time从小到大存储
-    std::deque<KeyValueSharedPtr> _queue;
+    TimeQueue _queue;
     
     // 互斥锁
     std::mutex _mutex;
@@ -438,6 +2711,120 @@ private:
     // 执行tick()的线程
     std::thread _tick_thread;
 
+    // 已注册的滑动窗口聚合, key为聚合id
+    std::unordered_map<int, WindowAggregate<K, V>> _window_aggregates;
+
+    // 下一个聚合id
+    int _next_aggregate_id;
+
+    // 已注册的滚动/滑动窗口, key为窗口id
+    std::unordered_map<int, TimeWindow<K, V>> _time_windows;
+
+    // 下一个窗口id
+    int _next_time_window_id;
+
+    // 最后一条变更的序号
+    uint64_t _change_sequence;
+
+    // 最后分配的数据版本号, 每条数据加入容器时递增
+    uint64_t _next_version;
+
+    // 是否正在重放变更
+    bool _applying_change;
+
+    // 预写日志, 未开启时为空
+    std::shared_ptr<WriteAheadLog> _wal;
+
+    // 把变更编码为日志记录, 在enable_wal()时确定序列化器
+    std::function<void(std::string&, uint64_t, ChangeType, const KeyValue<K, V>&)> _wal_encoder;
+
+    // 编码日志记录的缓冲区, 由_mutex保护
+    std::string _wal_record;
+
+    // 后台快照子进程id, 没有后台快照时为-1
+    pid_t _snapshot_pid;
+
+    // 变更流, 未开启时为空
+    std::shared_ptr<ChangeFeed<K, V>> _change_feed;
+
+    // 冷存储, 未开启时为空, 开启后不再改变
+    std::shared_ptr<ColdStore> _cold_store;
+
+    // 数据插入多久之后转移到冷存储, 单位ms
+    int _cold_age_ms;
+
+    // 冷存储配置
+    ColdTierOptions _cold_options;
+
+    // 冷数据value的序列化和反序列化
+    std::function<void(std::string&, const V&)> _cold_encoder;
+    std::function<bool(const char*, size_t, V&)> _cold_decoder;
+
+    // 冷存储统计, 解压在锁外的多个线程中进行
+    struct ColdTierCounters {
+        std::atomic<uint64_t> spilled_count{0};
+        std::atomic<uint64_t> raw_bytes{0};
+        std::atomic<uint64_t> stored_bytes{0};
+        std::atomic<uint64_t> compressed_count{0};
+        std::atomic<uint64_t> compress_ns{0};
+        std::atomic<uint64_t> decompress_count{0};
+        std::atomic<uint64_t> decompress_ns{0};
+    };
+    mutable ColdTierCounters _cold_stats;
+
+    // insert_time不晚于该时间的数据都已转移或跳过
+    TimeStamp _cold_cursor;
+
+    // 是否记录增量检查点需要的变更
+    bool _track_checkpoint_changes;
+
+    // 发生过变更的key -> 最后一次变更的序号, 每个key只保留一条, 不调用checkpoint_since()时大小也不超过变更过的key的个数
+    std::unordered_map<K, uint64_t> _checkpoint_changes;
+
+    // wait_for_key的条件变量, 按key哈希分片, 与_mutex一起使用
+    std::condition_variable _key_wait_cvs[kKeyWaitStripes];
+
+    // 每个分片上等待的线程数, 没有等待者时插入不需要notify
+    int _key_waiters[kKeyWaitStripes];
+    int _key_waiter_count;
+
+    // 析构时等待所有wait_for_key的等待者离开
+    std::condition_variable _key_wait_done_cv;
+
+    // 监听id -> (key, 回调)
+    std::unordered_map<int, std::pair<K, std::shared_ptr<WatchCallback>>> _watches;
+
+    // key -> 监听该key的id
+    std::unordered_map<K, std::vector<int>> _watched_keys;
+
+    // 下一个监听id
+    int _next_watch_id;
+
+    // 待执行的监听通知(监听id, 新数据), 由_mutex保护
+    std::deque<std::pair<int, KeyValueSharedPtr>> _watch_events;
+    std::condition_variable _watch_cv;
+
+    // 执行监听回调的线程, 第一次watch时启动
+    std::thread _watch_thread;
+
+    // 热点key统计, 第一次开启时创建, 之后不再释放
+    std::unique_ptr<HeavyHitter<K>> _hot_key_tracker;
+
+    // 开启时指向_hot_key_tracker, 关闭时为空, 读写路径不加锁读取
+    std::atomic<HeavyHitter<K>*> _hot_keys;
+
+    // erase_if/count_if的线程池, 第一次扫描时创建, 由_mutex保护
+    std::unique_ptr<WorkerPool> _scan_pool;
+
+    // erase_if/count_if使用的线程数, 包括调用线程, 0表示按核数, 由_mutex保护
+    int _scan_worker_count;
+
+    // 读缓存的分片版本号, 第一次开启时创建, 之后不再释放, 由_mutex保护
+    std::unique_ptr<ReadCache<K, V>> _read_cache_owner;
+
+    // 开启时指向_read_cache_owner, 关闭时为空, get_by_key不加锁读取
+    std::atomic<ReadCache<K, V>*> _read_cache;
+
     // 是否在运行标志
     std::atomic<bool> _is_running;
 };
\ No newline at end of file
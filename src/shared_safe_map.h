@@ -0,0 +1,734 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "key_value.h"
+#include "snapshot.h"
+
+const uint32_t kSharedMapMagic = 0x534d5353; // "SSMS"
+const uint32_t kSharedMapVersion = 3;
+
+/*
+    * @brief 数据存放在POSIX共享内存中的SafeMap, 同一台机器上的多个进程共用一份数据
+    * 节点、哈希索引、按insert_time排序的时间链表都在共享内存中, 互相之间用节点下标代替指针
+    * 所有进程通过共享内存中的robust互斥锁互斥, 持锁进程崩溃后下一个加锁的进程先修复数据再继续使用
+    * 修复失败时数据不可再用, 之后所有操作都返回失败
+    * 也可以映射普通文件, 重启后重新映射即可使用, 不需要重新加载数据, 通过checkpoint显式落盘
+    * 最后一次checkpoint之后系统崩溃时, 文件中的页面可能只写回了一部分, 无法确认数据完整的文件会拒绝打开
+    * K和V必须可平凡复制, 容量在创建时确定
+*/
+template<typename K, typename V>
+class SharedSafeMap {
+    static_assert(std::is_trivially_copyable<K>::value, "SharedSafeMap<K, V> requires a trivially copyable K");
+    static_assert(std::is_trivially_copyable<V>::value, "SharedSafeMap<K, V> requires a trivially copyable V");
+
+    using SystemClock = std::chrono::system_clock;
+
+public:
+    SharedSafeMap() : _fd(-1), _data(nullptr), _size(0), _header(nullptr), _buckets(nullptr), _nodes(nullptr) {}
+
+    SharedSafeMap(const SharedSafeMap&) = delete;
+    SharedSafeMap& operator=(const SharedSafeMap&) = delete;
+
+    ~SharedSafeMap() {
+        close();
+    }
+
+    /*
+        * @brief 创建共享内存并初始化, 同名的共享内存已存在时会被清空
+        * @param name 共享内存名称, 以'/'开头
+        * @param capacity 最多存放的数据条数
+        * @return 创建成功返回true, 否则返回false
+    */
+    bool create(const std::string& name, size_t capacity) {
+        close();
+        if (capacity == 0 || capacity >= UINT32_MAX) {
+            return false;
+        }
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = init_segment(fd, capacity);
+        ::close(fd);
+        if (!ok) {
+            close();
+        }
+        return ok;
+    }
+
+    /*
+        * @brief 创建数据文件并初始化, 已存在的文件会被清空
+        * 文件在close前一直持有共享flock, 其他进程可以同时open_file
+        * @param path 文件路径
+        * @param capacity 最多存放的数据条数
+        * @return 创建成功返回true, 否则返回false
+    */
+    bool create_file(const std::string& path, size_t capacity) {
+        close();
+        if (capacity == 0 || capacity >= UINT32_MAX) {
+            return false;
+        }
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        _fd = fd;
+        if (flock(fd, LOCK_SH) != 0 || !init_segment(fd, capacity) || !checkpoint()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+        * @brief 打开其他进程已创建的共享内存
+        * @param name 共享内存名称
+        * @return 打开成功返回true, 否则返回false
+    */
+    bool open(const std::string& name) {
+        close();
+
+        int fd = shm_open(name.c_str(), O_RDWR, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header) && map_segment(fd, st.st_size);
+        ::close(fd);
+        if (!ok || !validate()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+        * @brief 打开已有的数据文件, 只做映射和校验, 耗时与数据量无关
+        * 没有其他进程打开该文件时, 重新初始化锁(上次运行的锁状态没有意义);
+        * 如果上次运行在最后一次checkpoint之后还有修改, 检查时间链表并重建哈希桶和空闲链表
+        * @param path 文件路径
+        * @return 打开成功返回true, 文件损坏或页面只写回了一部分返回false, 此时需要从其他备份恢复
+    */
+    bool open_file(const std::string& path) {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) {
+            return false;
+        }
+        _fd = fd;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header) || !map_segment(fd, st.st_size)
+            || !validate()) {
+            close();
+            return false;
+        }
+
+        // 拿到排他flock说明是唯一的使用者, 初始化完成后降级为共享flock
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            if (!init_mutex() || (_header->dirty != 0 && (!repair() || !checkpoint()))) {
+                close();
+                return false;
+            }
+        }
+        if (flock(fd, LOCK_SH) != 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+        * @brief 把所有修改写回数据文件, 返回后重启可以直接使用文件中的数据
+        * 共享内存模式下没有意义, 直接返回true
+        * @return 成功返回true, 否则返回false
+    */
+    bool checkpoint() {
+        if (_fd < 0) {
+            return true;
+        }
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return false;
+        }
+
+        if (msync(_data, _size, MS_SYNC) != 0) {
+            return false;
+        }
+        _header->dirty = 0;
+        return msync(_data, header_size(), MS_SYNC) == 0;
+    }
+
+    /*
+        * @brief 解除映射, 不删除共享内存; 数据文件不会自动落盘, 需要先调用checkpoint
+    */
+    void close() {
+        if (_data != nullptr) {
+            munmap(_data, _size);
+        }
+        if (_fd >= 0) {
+            // 关闭文件时释放flock
+            ::close(_fd);
+            _fd = -1;
+        }
+        _data = nullptr;
+        _size = 0;
+        _header = nullptr;
+        _buckets = nullptr;
+        _nodes = nullptr;
+    }
+
+    /*
+        * @brief 删除共享内存, 已映射的进程不受影响
+        * @param name 共享内存名称
+        * @return 删除成功返回true, 否则返回false
+    */
+    static bool remove(const std::string& name) {
+        return shm_unlink(name.c_str()) == 0;
+    }
+
+    /*
+        * @brief 插入, 已存在的key会被替换, insert_time为当前时间
+        * @param key 键
+        * @param value 值
+        * @param expire_time_interval 过期时间, 单位ms, -1表示永不过期
+        * @return 插入成功返回true, 容量已满或数据不可用返回false
+    */
+    bool insert(const K& key, const V& value, int expire_time_interval = -1) {
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return false;
+        }
+
+        uint64_t hash = std::hash<K>()(key);
+        erase_without_lock(key, hash);
+
+        uint32_t index = allocate_node_without_lock();
+        if (index == 0) {
+            return false;
+        }
+        auto now = SystemClock::now();
+        // 多个进程的时钟相同, 但加锁顺序和取时间的顺序可能不一致, 保证链表严格按insert_time有序
+        int64_t insert_time = to_nanoseconds(now);
+        if (_header->tail != 0 && _nodes[_header->tail].insert_time >= insert_time) {
+            insert_time = _nodes[_header->tail].insert_time + 1;
+        }
+
+        Node& node = _nodes[index];
+        node.key = key;
+        node.value = value;
+        node.insert_time = insert_time;
+        node.expire_time = insert_time + static_cast<int64_t>(expire_time_interval) * 1000000;
+        node.expire_time_interval = expire_time_interval;
+        link_without_lock(index, hash);
+        return true;
+    }
+
+    /*
+        * @brief 删除
+        * @param key 键
+        * @return 删除成功返回true, 否则返回false
+    */
+    bool erase_by_key(const K& key) {
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return false;
+        }
+
+        return erase_without_lock(key, std::hash<K>()(key));
+    }
+
+    /*
+        * @brief 获取, 已过期的数据会被删除
+        * @param key 键
+        * @param value 值
+        * @return 获取成功返回true, 否则返回false
+    */
+    bool get_by_key(const K& key, V& value) {
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return false;
+        }
+
+        uint64_t hash = std::hash<K>()(key);
+        uint32_t index = find_without_lock(key, hash);
+        if (index == 0) {
+            return false;
+        }
+        if (is_expire(_nodes[index], to_nanoseconds(SystemClock::now()))) {
+            unlink_without_lock(index, hash);
+            return false;
+        }
+        value = _nodes[index].value;
+        return true;
+    }
+
+    /*
+        * @brief 获取某个时间范围内的数据, 沿时间链表从一端开始查找, O(n)
+        * @param start_time 起始时间
+        * @param end_time 结束时间
+        * @param asc 是否按照插入时间升序排列
+        * @return 返回某个时间范围内的数据
+    */
+    std::vector<KeyValue<K, V>> get_by_time_range(const TimeStamp& start_time, const TimeStamp& end_time, bool asc = true) {
+        std::vector<KeyValue<K, V>> result;
+        if (start_time > end_time) {
+            return result;
+        }
+        int64_t start = to_nanoseconds(start_time);
+        int64_t end = to_nanoseconds(end_time);
+
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return result;
+        }
+
+        int64_t now = to_nanoseconds(SystemClock::now());
+        uint32_t index = asc ? _header->head : _header->tail;
+        while (index != 0) {
+            const Node& node = _nodes[index];
+            if (asc ? node.insert_time > end : node.insert_time < start) {
+                break;
+            }
+            if (node.insert_time >= start && node.insert_time <= end && !is_expire(node, now)) {
+                result.push_back(to_key_value(node));
+            }
+            index = asc ? node.next : node.prev;
+        }
+        return result;
+    }
+
+    /*
+        * @brief 获取insert_time最大或最小前的N条数据
+        * @param n N
+        * @param asc 是否按照插入时间升序排列
+        * @return 返回N条数据
+    */
+    std::vector<KeyValue<K, V>> get_by_order(int n, bool asc = true) {
+        std::vector<KeyValue<K, V>> result;
+
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return result;
+        }
+
+        int64_t now = to_nanoseconds(SystemClock::now());
+        uint32_t index = asc ? _header->head : _header->tail;
+        while (index != 0 && static_cast<int>(result.size()) < n) {
+            const Node& node = _nodes[index];
+            if (!is_expire(node, now)) {
+                result.push_back(to_key_value(node));
+            }
+            index = asc ? node.next : node.prev;
+        }
+        return result;
+    }
+
+    /*
+        * @brief 删除所有已过期的数据, 共享内存中没有后台线程, 需要由某个进程定期调用
+        * @return 删除的数据个数
+    */
+    int erase_expired() {
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return 0;
+        }
+
+        int count = 0;
+        int64_t now = to_nanoseconds(SystemClock::now());
+        uint32_t index = _header->head;
+        while (index != 0) {
+            uint32_t next = _nodes[index].next;
+            if (is_expire(_nodes[index], now)) {
+                unlink_without_lock(index, std::hash<K>()(_nodes[index].key));
+                ++count;
+            }
+            index = next;
+        }
+        return count;
+    }
+
+    /*
+        * @brief 数据条数, 包括已过期但还未删除的数据
+    */
+    size_t size() {
+        SharedLockGuard lock(*this);
+        if (!lock.ok()) {
+            return 0;
+        }
+
+        return _header->size;
+    }
+
+    size_t capacity() const {
+        return _header->capacity;
+    }
+
+private:
+    /*
+        * @brief 共享内存头部, 之后依次是bucket_count个桶和capacity + 1个节点, 下标0表示空
+    */
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t key_size;
+        uint32_t value_size;
+        uint64_t capacity;
+        uint64_t bucket_count;
+        uint64_t size;
+        uint32_t free_head; // 空闲节点链表, 通过hash_next连接
+        uint32_t next_unused; // 从未使用过的第一个节点
+        uint32_t head; // 时间链表, insert_time最小的节点
+        uint32_t tail; // 时间链表, insert_time最大的节点
+        uint32_t dirty; // 数据文件在最后一次checkpoint之后是否被修改过
+        uint32_t pending; // 正在加入或移出链表的节点, 持锁进程崩溃时只有这个节点的in_use可能与链表不一致
+        pthread_mutex_t mutex;
+    };
+
+    struct Node {
+        K key;
+        V value;
+        int64_t insert_time; // 单位ns
+        int64_t expire_time; // 单位ns
+        int32_t expire_time_interval;
+        uint32_t hash_next; // 同一个桶中的下一个节点
+        uint32_t prev; // 时间链表中的前一个节点
+        uint32_t next; // 时间链表中的后一个节点
+        uint32_t in_use; // 是否在链表中, 修复时与时间链表互相校验
+    };
+
+    /*
+        * @brief 加锁时如果上一个持锁进程已崩溃, 它正在进行的修改可能只完成了一部分(例如节点在时间链表中但不在桶中)
+        * 先在锁内repair()重建桶、prev和空闲链表, 成功后才标记锁为一致; 失败时不标记直接解锁,
+        * 锁变为ENOTRECOVERABLE, 所有进程之后的操作都会失败, 而不是在损坏的链表上死循环
+        * 数据文件在所有进程关闭后重新open_file时会重新初始化锁并再次修复
+    */
+    class SharedLockGuard {
+    public:
+        explicit SharedLockGuard(SharedSafeMap& map) : _mutex(&map._header->mutex), _locked(false), _usable(false) {
+            int result = pthread_mutex_lock(_mutex);
+            if (result == 0) {
+                _locked = true;
+                _usable = true;
+            } else if (result == EOWNERDEAD) {
+                _locked = true;
+                if (map.repair()) {
+                    _usable = pthread_mutex_consistent(_mutex) == 0;
+                }
+            }
+        }
+
+        SharedLockGuard(const SharedLockGuard&) = delete;
+        SharedLockGuard& operator=(const SharedLockGuard&) = delete;
+
+        ~SharedLockGuard() {
+            if (_locked) {
+                pthread_mutex_unlock(_mutex);
+            }
+        }
+
+        /*
+            * @brief 是否持有锁且数据可用, 为false时调用者不能访问共享内存中的数据
+        */
+        bool ok() const {
+            return _usable;
+        }
+
+    private:
+        pthread_mutex_t* _mutex;
+        bool _locked;
+        bool _usable;
+    };
+
+    static size_t header_size() {
+        return (sizeof(Header) + 63) / 64 * 64;
+    }
+
+    static size_t segment_size(size_t capacity, size_t bucket_count) {
+        size_t buckets_size = (bucket_count * sizeof(uint32_t) + 63) / 64 * 64;
+        return header_size() + buckets_size + (capacity + 1) * sizeof(Node);
+    }
+
+    /*
+        * @brief 设置大小并初始化头部和锁, ftruncate扩展出的部分全部为0, 桶和链表不需要再初始化
+    */
+    bool init_segment(int fd, size_t capacity) {
+        size_t bucket_count = 1;
+        while (bucket_count < capacity) {
+            bucket_count <<= 1;
+        }
+        size_t size = segment_size(capacity, bucket_count);
+        if (ftruncate(fd, size) != 0 || !map_segment(fd, size)) {
+            return false;
+        }
+
+        _header->version = kSharedMapVersion;
+        _header->key_size = sizeof(K);
+        _header->value_size = sizeof(V);
+        _header->capacity = capacity;
+        _header->bucket_count = bucket_count;
+        _header->next_unused = 1;
+        set_sections();
+        if (!init_mutex()) {
+            return false;
+        }
+        // 最后写入magic, 其他进程只有看到magic后才会使用
+        __atomic_store_n(&_header->magic, kSharedMapMagic, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /*
+        * @brief 映射整个共享内存, 头部初始化或校验后再计算各部分的地址
+    */
+    bool map_segment(int fd, size_t size) {
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        _data = data;
+        _size = size;
+        _header = static_cast<Header*>(data);
+        return true;
+    }
+
+    void set_sections() {
+        char* base = static_cast<char*>(_data);
+        size_t buckets_size = (_header->bucket_count * sizeof(uint32_t) + 63) / 64 * 64;
+        _buckets = reinterpret_cast<uint32_t*>(base + header_size());
+        _nodes = reinterpret_cast<Node*>(base + header_size() + buckets_size);
+    }
+
+    /*
+        * @brief 检查已有共享内存的格式与当前的K/V一致
+    */
+    bool validate() {
+        if (__atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) != kSharedMapMagic || _header->version != kSharedMapVersion
+            || _header->key_size != sizeof(K) || _header->value_size != sizeof(V)
+            || _size < segment_size(_header->capacity, _header->bucket_count)) {
+            return false;
+        }
+        set_sections();
+        return true;
+    }
+
+    bool init_mutex() {
+        pthread_mutexattr_t attr;
+        if (pthread_mutexattr_init(&attr) != 0) {
+            return false;
+        }
+        bool ok = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0
+            && pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0
+            && pthread_mutex_init(&_header->mutex, &attr) == 0;
+        pthread_mutexattr_destroy(&attr);
+        return ok;
+    }
+
+    /*
+        * @brief 第一次修改前先把dirty标志同步写入文件, 保证崩溃后一定能发现未落盘的修改
+    */
+    void mark_dirty_without_lock() {
+        if (_fd >= 0 && _header->dirty == 0) {
+            _header->dirty = 1;
+            msync(_data, header_size(), MS_SYNC);
+        }
+    }
+
+    /*
+        * @brief 持锁进程崩溃或上次运行没有正常checkpoint后, 检查时间链表并重建prev、哈希桶、空闲链表和size
+        * 进程崩溃时内存是完整的, 只有pending节点的修改做了一半; 系统崩溃时任意页面都可能还是旧内容,
+        * 例如checkpoint后删除的节点被复用且只有它所在的页面写回了文件, 从head出发会跳过后面的节点
+        * 每个节点的in_use与它是否在时间链表中必须一致(pending除外), 否则说明有页面没有写回, 返回false
+        * @return 时间链表完好返回true, 否则返回false
+    */
+    bool repair() {
+        uint64_t capacity = _header->capacity;
+        uint32_t pending = _header->pending;
+        std::vector<bool> used(capacity + 1, false);
+
+        uint64_t size = 0;
+        uint32_t prev = 0;
+        uint32_t index = _header->head;
+        while (index != 0) {
+            if (index > capacity || used[index]) {
+                return false;
+            }
+            const Node& node = _nodes[index];
+            if (prev != 0 && node.insert_time <= _nodes[prev].insert_time) {
+                return false;
+            }
+            used[index] = true;
+            ++size;
+            prev = index;
+            index = node.next;
+        }
+        for (uint32_t i = 1; i <= capacity; ++i) {
+            if (i != pending && (_nodes[i].in_use != 0) != used[i]) {
+                return false;
+            }
+        }
+
+        // 校验通过后才修改数据, 失败时文件保持原样
+        std::fill(_buckets, _buckets + _header->bucket_count, 0);
+        prev = 0;
+        index = _header->head;
+        while (index != 0) {
+            Node& node = _nodes[index];
+            node.prev = prev;
+            node.in_use = 1;
+            uint32_t& bucket = _buckets[std::hash<K>()(node.key) & (_header->bucket_count - 1)];
+            node.hash_next = bucket;
+            bucket = index;
+            prev = index;
+            index = node.next;
+        }
+        if (pending != 0 && pending <= capacity && !used[pending]) {
+            _nodes[pending].in_use = 0;
+        }
+        _header->pending = 0;
+        _header->tail = prev;
+        _header->size = size;
+
+        // 链表中重复的key只保留insert_time最大的那一条
+        index = prev;
+        while (index != 0) {
+            uint32_t next = _nodes[index].prev;
+            uint64_t hash = std::hash<K>()(_nodes[index].key);
+            uint32_t found = find_without_lock(_nodes[index].key, hash);
+            if (found != index) {
+                unlink_without_lock(index, hash);
+                used[index] = false;
+            }
+            index = next;
+        }
+
+        _header->free_head = 0;
+        _header->next_unused = capacity + 1;
+        for (uint32_t i = capacity; i >= 1; --i) {
+            if (!used[i]) {
+                _nodes[i].hash_next = _header->free_head;
+                _header->free_head = i;
+            }
+        }
+        return true;
+    }
+
+    static bool is_expire(const Node& node, int64_t now) {
+        return node.expire_time_interval != -1 && now > node.expire_time;
+    }
+
+    static KeyValue<K, V> to_key_value(const Node& node) {
+        return KeyValue<K, V>(node.key, node.value, from_nanoseconds(node.insert_time), from_nanoseconds(node.expire_time),
+                              node.expire_time_interval);
+    }
+
+    uint32_t find_without_lock(const K& key, uint64_t hash) const {
+        uint32_t index = _buckets[hash & (_header->bucket_count - 1)];
+        while (index != 0 && !(_nodes[index].key == key)) {
+            index = _nodes[index].hash_next;
+        }
+        return index;
+    }
+
+    bool erase_without_lock(const K& key, uint64_t hash) {
+        uint32_t index = find_without_lock(key, hash);
+        if (index == 0) {
+            return false;
+        }
+        unlink_without_lock(index, hash);
+        return true;
+    }
+
+    uint32_t allocate_node_without_lock() {
+        if (_header->free_head != 0) {
+            uint32_t index = _header->free_head;
+            _header->free_head = _nodes[index].hash_next;
+            return index;
+        }
+        if (_header->next_unused > _header->capacity) {
+            return 0;
+        }
+        return _header->next_unused++;
+    }
+
+    /*
+        * @brief 把节点加入桶和时间链表末尾
+    */
+    void link_without_lock(uint32_t index, uint64_t hash) {
+        mark_dirty_without_lock();
+        _header->pending = index;
+        Node& node = _nodes[index];
+        node.in_use = 1;
+        uint32_t& bucket = _buckets[hash & (_header->bucket_count - 1)];
+        node.hash_next = bucket;
+        bucket = index;
+
+        node.prev = _header->tail;
+        node.next = 0;
+        if (_header->tail != 0) {
+            _nodes[_header->tail].next = index;
+        } else {
+            _header->head = index;
+        }
+        _header->tail = index;
+        ++_header->size;
+        _header->pending = 0;
+    }
+
+    /*
+        * @brief 把节点从桶和时间链表中移除并放回空闲链表
+    */
+    void unlink_without_lock(uint32_t index, uint64_t hash) {
+        mark_dirty_without_lock();
+        _header->pending = index;
+        Node& node = _nodes[index];
+        node.in_use = 0;
+        uint32_t* link = &_buckets[hash & (_header->bucket_count - 1)];
+        while (*link != index) {
+            link = &_nodes[*link].hash_next;
+        }
+        *link = node.hash_next;
+
+        if (node.prev != 0) {
+            _nodes[node.prev].next = node.next;
+        } else {
+            _header->head = node.next;
+        }
+        if (node.next != 0) {
+            _nodes[node.next].prev = node.prev;
+        } else {
+            _header->tail = node.prev;
+        }
+
+        node.hash_next = _header->free_head;
+        _header->free_head = index;
+        --_header->size;
+        _header->pending = 0;
+    }
+
+    // 数据文件, 共享内存模式下为-1
+    int _fd;
+
+    void* _data;
+    size_t _size;
+
+    Header* _header;
+    uint32_t* _buckets;
+    Node* _nodes;
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "key_value.h"
+
+const uint32_t kSnapshotMagic = 0x534d5354; // "TSMS"
+const uint32_t kCheckpointMagic = 0x444d5354; // "TSMD", 增量检查点
+const uint32_t kSnapshotVersion = 2;
+const size_t kSnapshotEntryMinSize = 20; // 每条数据至少包含 insert_time expire_time expire_time_interval, 单位字节
+
+/*
+    * @brief 快照文件头, version 2 起增加sequence, 为保存快照时最后一条变更的序号
+*/
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t entry_count;
+    uint64_t sequence;
+};
+
+/*
+    * @brief 默认序列化器, 支持可平凡复制的类型, 其他类型需要特化或自定义
+    * write 把value追加到out中, read 从[data, end)中读取value并移动data, 数据不完整时返回false
+*/
+template<typename T, typename Enable = void>
+struct Serializer {
+    static_assert(std::is_trivially_copyable<T>::value, "Serializer<T> requires a trivially copyable T, provide a custom serializer");
+
+    static void write(std::string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static bool read(const char*& data, const char* end, T& value) {
+        if (end - data < static_cast<std::ptrdiff_t>(sizeof(T))) {
+            return false;
+        }
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return true;
+    }
+};
+
+/*
+    * @brief std::string序列化器, 格式为 uint64长度 + 内容
+*/
+template<>
+struct Serializer<std::string> {
+    static void write(std::string& out, const std::string& value) {
+        Serializer<uint64_t>::write(out, value.size());
+        out.append(value);
+    }
+
+    static bool read(const char*& data, const char* end, std::string& value) {
+        uint64_t size;
+        if (!Serializer<uint64_t>::read(data, end, size) || static_cast<uint64_t>(end - data) < size) {
+            return false;
+        }
+        value.assign(data, size);
+        data += size;
+        return true;
+    }
+};
+
+template<>
+struct Serializer<SnapshotHeader> {
+    static void write(std::string& out, const SnapshotHeader& header) {
+        Serializer<uint32_t>::write(out, header.magic);
+        Serializer<uint32_t>::write(out, header.version);
+        Serializer<uint64_t>::write(out, header.entry_count);
+        Serializer<uint64_t>::write(out, header.sequence);
+    }
+
+    static bool read(const char*& data, const char* end, SnapshotHeader& header) {
+        if (!Serializer<uint32_t>::read(data, end, header.magic) || !Serializer<uint32_t>::read(data, end, header.version)
+            || !Serializer<uint64_t>::read(data, end, header.entry_count)) {
+            return false;
+        }
+        header.sequence = 0;
+        return header.version < 2 || Serializer<uint64_t>::read(data, end, header.sequence);
+    }
+};
+
+inline int64_t to_nanoseconds(const TimeStamp& time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+inline TimeStamp from_nanoseconds(int64_t nanoseconds) {
+    return TimeStamp(std::chrono::duration_cast<TimeStamp::duration>(std::chrono::nanoseconds(nanoseconds)));
+}
+
+/*
+    * @brief 只读映射整个文件, 析构时解除映射
+*/
+class MappedFile {
+public:
+    MappedFile() : _data(nullptr), _size(0) {}
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (_data != nullptr) {
+            munmap(_data, _size);
+        }
+    }
+
+    /*
+        * @brief 映射文件
+        * @param path 文件路径
+        * @return 映射成功返回true, 否则返回false
+    */
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        // 加载时顺序读取, 提示内核预读
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+        _data = data;
+        _size = st.st_size;
+        return true;
+    }
+
+    const char* data() const {
+        return static_cast<const char*>(_data);
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    void* _data;
+    size_t _size;
+};
+
+/*
+    * @brief 原子地写入文件: 先写入path.tmp, commit时fsync并重命名为path
+    * 只使用POSIX文件接口, 可以在fork出的子进程中安全使用
+*/
+class AtomicFileWriter {
+public:
+    AtomicFileWriter() : _fd(-1) {}
+
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    ~AtomicFileWriter() {
+        // 未commit时删除临时文件
+        if (_fd >= 0) {
+            ::close(_fd);
+            ::unlink(_tmp_path.c_str());
+        }
+    }
+
+    /*
+        * @brief 创建临时文件
+        * @param path 最终的文件路径
+        * @return 成功返回true, 否则返回false
+    */
+    bool open(const std::string& path) {
+        _path = path;
+        _tmp_path = path + ".tmp";
+        _fd = ::open(_tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        return _fd >= 0;
+    }
+
+    /*
+        * @brief 写入全部数据
+        * @return 成功返回true, 否则返回false
+    */
+    bool write(const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(_fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                return false;
+            }
+            written += n;
+        }
+        return true;
+    }
+
+    /*
+        * @brief fsync后把临时文件重命名为最终路径
+        * @return 成功返回true, 否则返回false
+    */
+    bool commit() {
+        bool ok = ::fsync(_fd) == 0;
+        ok = ::close(_fd) == 0 && ok;
+        _fd = -1;
+        if (!ok || ::rename(_tmp_path.c_str(), _path.c_str()) != 0) {
+            ::unlink(_tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int _fd;
+    std::string _path;
+    std::string _tmp_path;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "key_value.h"
+
+/*
+    * @brief 按insert_time切分的滚动/滑动窗口
+    * 窗口起点对齐到hop_ms的整数倍, 窗口为[start, start + size_ms)
+    * hop_ms == size_ms 为滚动窗口, hop_ms < size_ms 为重叠的滑动窗口
+    * 所有接口均不加锁, 由SafeMap在持有_mutex时调用
+    * 窗口只保存数据的弱引用, 不延长数据的生命周期, 也不阻止数据被转移到冷存储
+*/
+template<typename K, typename V>
+class TimeWindow {
+    using KeyValueSharedPtr = std::shared_ptr<KeyValue<K, V>>;
+    using KeyValueWeakPtr = std::weak_ptr<KeyValue<K, V>>;
+
+public:
+    using Callback = std::function<void(const TimeStamp& start, const TimeStamp& end, std::vector<KeyValue<K, V>>& entries)>;
+
+    /*
+        * @brief 一个已关闭的窗口, 回调在释放锁后执行
+    */
+    struct Emission {
+        std::shared_ptr<Callback> callback;
+        TimeStamp start;
+        TimeStamp end;
+        std::vector<KeyValue<K, V>> entries;
+    };
+
+    TimeWindow(int size_ms, int hop_ms, Callback callback, const TimeStamp& now)
+        : _size(std::chrono::milliseconds(size_ms))
+        , _hop(std::chrono::milliseconds(hop_ms))
+        , _callback(std::make_shared<Callback>(std::move(callback))) {
+        // 第一个窗口从不晚于now的hop整数倍开始
+        auto since_epoch = now.time_since_epoch();
+        _next_start = TimeStamp(since_epoch - since_epoch % _hop);
+    }
+
+    /*
+        * @brief 数据插入时调用, 数据按insert_time顺序到达
+        * @param map_value 新插入的数据
+    */
+    void add(const KeyValueSharedPtr& map_value) {
+        _pending.emplace_back(map_value->get_insert_time(), map_value);
+    }
+
+    /*
+        * @brief 数据被替换为冷节点时调用, 使窗口关闭时仍能发出该数据
+        * @param old_value 原数据
+        * @param new_value 替换后的冷节点, insert_time与原数据相同
+    */
+    void replace(const KeyValueSharedPtr& old_value, const KeyValueSharedPtr& new_value) {
+        auto range = std::equal_range(_pending.begin(), _pending.end(), PendingEntry(old_value->get_insert_time(), KeyValueWeakPtr()),
+                                      [](const PendingEntry& lhs, const PendingEntry& rhs) {
+            return lhs.first < rhs.first;
+        });
+        for (auto it = range.first; it != range.second; ++it) {
+            // 比较控制块, 原数据已释放时也能正确比较
+            if (!it->second.owner_before(old_value) && !old_value.owner_before(it->second)) {
+                it->second = new_value;
+                return;
+            }
+        }
+    }
+
+    /*
+        * @brief 关闭所有结束时间不晚于now的窗口, 每个窗口只会被关闭一次
+        * 发出的是数据的副本; 不再被后续窗口覆盖的数据从_pending中移出, 已被删除或过期的数据不会发出
+        * 冷节点的副本不含value, 由调用者在释放锁后读取
+        * @param now 当前时间
+        * @param emissions 输出已关闭的窗口
+    */
+    void close(const TimeStamp& now, std::vector<Emission>& emissions) {
+        while (_next_start + _size <= now) {
+            Emission emission{_callback, _next_start, _next_start + _size, {}};
+            auto next_hop = _next_start + _hop;
+
+            while (!_pending.empty() && _pending.front().first < next_hop) {
+                auto map_value = _pending.front().second.lock();
+                auto insert_time = _pending.front().first;
+                _pending.pop_front();
+                if (map_value && insert_time >= _next_start && insert_time < emission.end && !map_value->is_expire()) {
+                    emission.entries.push_back(*map_value);
+                }
+            }
+            for (auto it = _pending.begin(); it != _pending.end() && it->first < emission.end; ++it) {
+                auto map_value = it->second.lock();
+                if (map_value && !map_value->is_expire()) {
+                    emission.entries.push_back(*map_value);
+                }
+            }
+
+            emissions.push_back(std::move(emission));
+            _next_start = next_hop;
+        }
+    }
+
+private:
+    std::chrono::system_clock::duration _size;
+    std::chrono::system_clock::duration _hop;
+    std::shared_ptr<Callback> _callback;
+
+    // 下一个待关闭窗口的起点
+    TimeStamp _next_start;
+
+    // (insert_time, 数据) 尚未被所有覆盖它的窗口发出的数据, 按insert_time从小到大存储
+    // 数据被删除后只剩一个失效的弱引用, 在窗口关闭时移出
+    using PendingEntry = std::pair<TimeStamp, KeyValueWeakPtr>;
+    std::deque<PendingEntry> _pending;
+};
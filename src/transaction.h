@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+template<typename K, typename V>
+class SafeMap;
+
+/*
+    * @brief 事务中缓存的一次写入
+*/
+template<typename V>
+struct TransactionWrite {
+    bool erase; // true表示删除, 否则为插入或覆盖
+    V value;
+    int expire_time_interval;
+};
+
+/*
+    * @brief SafeMap上的乐观事务, 通过SafeMap::begin_transaction()创建, 不能在多个线程之间共享
+    * get 读取时记录数据的版本号, put/erase 只缓存在事务中, commit 在一次加锁中校验所有读过的key的版本未变, 再一次性应用所有写入
+    * 读取阶段不持有锁, 其他线程可以正常读写; 任何读过的key被修改、删除或插入时commit失败, 需要重新执行整个事务
+*/
+template<typename K, typename V>
+class Transaction {
+public:
+    explicit Transaction(SafeMap<K, V>& map) : _map(&map), _conflict(false) {}
+
+    /*
+        * @brief 读取key, 先读取本事务中的写入
+        * @param key 键
+        * @param value 值
+        * @return 存在返回true, 否则返回false; 不存在也会被记录, 提交时若key已被插入则提交失败
+    */
+    bool get(const K& key, V& value) {
+        auto write = _writes.find(key);
+        if (write != _writes.end()) {
+            if (write->second.erase) {
+                return false;
+            }
+            value = write->second.value;
+            return true;
+        }
+
+        uint64_t version = 0;
+        bool found = _map->get_with_version(key, value, version);
+        auto read = _reads.emplace(key, version);
+        // 两次读取到不同的版本, 提交必然失败
+        if (!read.second && read.first->second != version) {
+            _conflict = true;
+        }
+        return found;
+    }
+
+    /*
+        * @brief 插入或覆盖key, 提交时生效
+        * @param key 键
+        * @param value 值
+        * @param expire_time_interval 过期时间, 单位ms, -1表示永不过期
+    */
+    void put(const K& key, const V& value, int expire_time_interval = -1) {
+        _writes[key] = TransactionWrite<V>{false, value, expire_time_interval};
+    }
+
+    /*
+        * @brief 删除key, 提交时生效, key不存在时不做任何事
+        * @param key 键
+    */
+    void erase(const K& key) {
+        _writes[key] = TransactionWrite<V>{true, V(), -1};
+    }
+
+    /*
+        * @brief 提交事务, 无论成功与否事务都会被清空, 可以继续用于下一次尝试
+        * @return 所有读过的key的版本都未变化时应用写入并返回true, 否则不做任何修改返回false
+    */
+    bool commit() {
+        bool committed = !_conflict && _map->commit_transaction(_reads, _writes);
+        rollback();
+        return committed;
+    }
+
+    /*
+        * @brief 放弃所有读取记录和缓存的写入
+    */
+    void rollback() {
+        _reads.clear();
+        _writes.clear();
+        _conflict = false;
+    }
+
+private:
+    SafeMap<K, V>* _map;
+    // key -> 读取时的版本号, 0表示不存在
+    std::unordered_map<K, uint64_t> _reads;
+    std::unordered_map<K, TransactionWrite<V>> _writes;
+    bool _conflict;
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "snapshot.h"
+
+const size_t kInternShardCount = 16; // 驻留表的分片数, 减少并发插入时的锁竞争
+
+/*
+    * @brief 值驻留表, 内容相同的值只保存一份, 通过引用计数共享
+    * 表中只保存弱引用, 最后一个持有者释放时由删除器把值从表中移除
+    * fork()期间持有所有分片锁, 子进程(如SafeMap::save_snapshot_background)中可以继续驻留和释放值
+*/
+template<typename T, typename Hash = std::hash<T>>
+class ValueInterner {
+    struct Shard;
+
+public:
+    ValueInterner() : _shards(std::make_shared<Shards>()) {
+        ForkRegistry& registry = fork_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.shards.insert(_shards.get());
+    }
+
+    ~ValueInterner() {
+        ForkRegistry& registry = fork_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.shards.erase(_shards.get());
+    }
+
+    ValueInterner(const ValueInterner&) = delete;
+    ValueInterner& operator=(const ValueInterner&) = delete;
+
+    /*
+        * @brief 每种类型默认使用的驻留表
+    */
+    static ValueInterner& instance() {
+        static ValueInterner interner;
+        return interner;
+    }
+
+    /*
+        * @brief 获取与value内容相同的共享值, 不存在时复制一份加入表中
+        * @param value 值
+        * @return 共享值
+    */
+    std::shared_ptr<const T> intern(const T& value) {
+        size_t hash = Hash()(value);
+        Shard& shard = _shards->shards[hash % kInternShardCount];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.table.find(std::cref(value));
+        if (it != shard.table.end()) {
+            if (auto shared = it->second.lock()) {
+                return shared;
+            }
+            // 最后一个持有者正在释放, 删除器会发现表项已被替换
+            shard.table.erase(it);
+        }
+
+        std::weak_ptr<Shards> shards = _shards;
+        std::shared_ptr<const T> shared(new T(value), [shards, hash](const T* ptr) {
+            release(shards, hash, ptr);
+        });
+        shard.table.emplace(std::cref(*shared), shared);
+        return shared;
+    }
+
+    /*
+        * @brief 表中不同值的个数, 包括正在释放的值
+    */
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : _shards->shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.table.size();
+        }
+        return total;
+    }
+
+private:
+    struct RefHash {
+        size_t operator()(const std::reference_wrapper<const T>& value) const {
+            return Hash()(value.get());
+        }
+    };
+
+    struct RefEqual {
+        bool operator()(const std::reference_wrapper<const T>& lhs, const std::reference_wrapper<const T>& rhs) const {
+            return lhs.get() == rhs.get();
+        }
+    };
+
+    // key引用共享值内部的T, 地址在值释放前不变
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::reference_wrapper<const T>, std::weak_ptr<const T>, RefHash, RefEqual> table;
+    };
+
+    struct Shards {
+        Shard shards[kInternShardCount];
+    };
+
+    // 同一类型的所有驻留表, 由pthread_atfork的回调在fork()前后加锁和解锁
+    struct ForkRegistry {
+        std::mutex mutex;
+        std::set<Shards*> shards;
+    };
+
+    /*
+        * @brief 首次使用时注册fork回调; 不析构, 进程退出过程中fork也能使用
+    */
+    static ForkRegistry& fork_registry() {
+        static ForkRegistry* registry = [] {
+            pthread_atfork(lock_for_fork, unlock_after_fork, unlock_after_fork);
+            return new ForkRegistry();
+        }();
+        return *registry;
+    }
+
+    /*
+        * @brief fork()前在调用线程上持有所有分片锁, 其他线程不会在fork时正持有分片锁
+        * 先锁注册表再锁分片, intern()和release()只锁分片, 不会反向等待
+    */
+    static void lock_for_fork() {
+        ForkRegistry& registry = fork_registry();
+        registry.mutex.lock();
+        for (auto shards : registry.shards) {
+            for (auto& shard : shards->shards) {
+                shard.mutex.lock();
+            }
+        }
+    }
+
+    /*
+        * @brief fork()后父子进程各自释放lock_for_fork()持有的锁, 子进程中的线程就是fork前持有锁的线程
+    */
+    static void unlock_after_fork() {
+        ForkRegistry& registry = fork_registry();
+        for (auto shards : registry.shards) {
+            for (auto& shard : shards->shards) {
+                shard.mutex.unlock();
+            }
+        }
+        registry.mutex.unlock();
+    }
+
+    /*
+        * @brief 共享值的删除器, 驻留表已析构时直接释放
+    */
+    static void release(const std::weak_ptr<Shards>& weak_shards, size_t hash, const T* ptr) {
+        if (auto shards = weak_shards.lock()) {
+            Shard& shard = shards->shards[hash % kInternShardCount];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            auto it = shard.table.find(std::cref(*ptr));
+            // 表项可能已被同内容的新值替换
+            if (it != shard.table.end() && &it->first.get() == ptr) {
+                shard.table.erase(it);
+            }
+        }
+        delete ptr;
+    }
+
+    std::shared_ptr<Shards> _shards;
+};
+
+/*
+    * @brief 驻留的值, 用作SafeMap的V: SafeMap<K, Interned<V>>
+    * 内容相同的值共享同一份数据, 数据被删除或过期时引用计数自动释放
+*/
+template<typename T>
+class Interned {
+public:
+    Interned() = default;
+
+    Interned(const T& value) : _value(ValueInterner<T>::instance().intern(value)) {}
+
+    explicit Interned(std::shared_ptr<const T> value) : _value(std::move(value)) {}
+
+    /*
+        * @brief 获取值, 默认构造的Interned返回T()
+    */
+    const T& get() const {
+        static const T empty_value{};
+        return _value ? *_value : empty_value;
+    }
+
+    operator const T&() const {
+        return get();
+    }
+
+    bool operator==(const Interned& other) const {
+        return _value == other._value || get() == other.get();
+    }
+
+    bool operator!=(const Interned& other) const {
+        return !(*this == other);
+    }
+
+    /*
+        * @brief 共享该值的持有者个数
+    */
+    long use_count() const {
+        return _value.use_count();
+    }
+
+private:
+    std::shared_ptr<const T> _value;
+};
+
+/*
+    * @brief Interned序列化器, 只写入值本身, 读取时重新驻留
+*/
+template<typename T>
+struct Serializer<Interned<T>> {
+    static void write(std::string& out, const Interned<T>& value) {
+        Serializer<T>::write(out, value.get());
+    }
+
+    static bool read(const char*& data, const char* end, Interned<T>& value) {
+        T raw;
+        if (!Serializer<T>::read(data, end, raw)) {
+            return false;
+        }
+        value = Interned<T>(raw);
+        return true;
+    }
+};
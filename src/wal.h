@@ -0,0 +1,298 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+/*
+    * @brief WAL的fsync策略
+    * kNone 只写入page cache, 由操作系统决定何时落盘
+    * kInterval 每隔fsync_interval_ms执行一次fsync
+    * kEveryBatch 每次组提交后都执行fsync
+*/
+enum class WalFsyncPolicy {
+    kNone,
+    kInterval,
+    kEveryBatch,
+};
+
+struct WalOptions {
+    WalFsyncPolicy fsync_policy = WalFsyncPolicy::kInterval;
+    int group_commit_interval_ms = 2; // 组提交间隔, 单位ms, 必须大于0
+    int fsync_interval_ms = 1000; // kInterval策略下的fsync间隔, 单位ms
+};
+
+/*
+    * @brief 只追加的预写日志, 每条记录格式为 uint32长度 + uint32校验和 + 内容
+    * append 只把记录追加到内存缓冲区, 由组提交线程批量写入文件并按策略fsync
+    * 写入或fsync失败后日志进入失败状态: 未写入的记录保留在缓冲区中不再写入, 之后的append/sync都返回false, 需要重新open
+*/
+class WriteAheadLog {
+public:
+    WriteAheadLog() : _fd(-1), _failed(false), _is_running(false) {}
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog() {
+        close();
+    }
+
+    /*
+        * @brief 打开日志文件并启动组提交线程, 新记录追加在已有内容之后
+        * @param path 日志文件路径
+        * @param options 配置
+        * @return 打开成功返回true, 否则返回false; group_commit_interval_ms不大于0时组提交线程会空转, 直接返回false且不关闭已打开的文件
+    */
+    bool open(const std::string& path, const WalOptions& options) {
+        if (options.group_commit_interval_ms <= 0) {
+            return false;
+        }
+        close();
+
+        _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (_fd < 0) {
+            return false;
+        }
+        _options = options;
+        _failed = false;
+        _last_fsync = std::chrono::steady_clock::now();
+        _is_running = true;
+        _commit_thread = std::thread([this]{loop_commit();});
+        return true;
+    }
+
+    /*
+        * @brief 追加一条记录到缓冲区
+        * @param payload 记录内容
+        * @return 日志处于失败状态时不追加并返回false, 否则返回true
+    */
+    bool append(const std::string& payload) {
+        std::lock_guard<std::mutex> lock(_buffer_mutex);
+
+        if (_failed) {
+            return false;
+        }
+        Serializer<uint32_t>::write(_buffer, static_cast<uint32_t>(payload.size()));
+        Serializer<uint32_t>::write(_buffer, checksum(payload.data(), payload.size()));
+        _buffer.append(payload);
+        return true;
+    }
+
+    /*
+        * @brief 是否可用, 写入或fsync失败后返回false
+    */
+    bool healthy() {
+        std::lock_guard<std::mutex> lock(_buffer_mutex);
+
+        return !_failed;
+    }
+
+    /*
+        * @brief 立即写入缓冲区中的所有记录并fsync, 返回时之前append的记录均已落盘
+        * @return 成功返回true; 本次或之前的任何一次写入失败都返回false
+    */
+    bool sync() {
+        return commit(true);
+    }
+
+    /*
+        * @brief 停止组提交线程, 写入剩余记录并关闭文件
+    */
+    void close() {
+        if (_is_running) {
+            {
+                std::lock_guard<std::mutex> lock(_buffer_mutex);
+                _is_running = false;
+            }
+            _commit_cv.notify_all();
+            _commit_thread.join();
+        }
+        if (_fd >= 0) {
+            commit(_options.fsync_policy != WalFsyncPolicy::kNone);
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+
+    /*
+        * @brief 顺序读取日志中的所有完整记录, 遇到不完整或校验失败的尾部记录时停止
+        * @param path 日志文件路径
+        * @param visitor 记录回调, 返回false时停止读取, 该记录不计入valid_size
+        * @param valid_size 输出最后一条被接受的记录的结束位置, 之后的内容应被truncate()截掉
+        * @return 文件存在返回true, 否则返回false
+    */
+    static bool read_all(const std::string& path, const std::function<bool(const char* data, size_t size)>& visitor, size_t& valid_size) {
+        valid_size = 0;
+        MappedFile file;
+        if (!file.open(path)) {
+            // 空文件也视为合法的日志
+            return ::access(path.c_str(), F_OK) == 0;
+        }
+
+        const char* begin = file.data();
+        const char* data = begin;
+        const char* end = data + file.size();
+        uint32_t size;
+        uint32_t sum;
+        while (Serializer<uint32_t>::read(data, end, size) && Serializer<uint32_t>::read(data, end, sum)) {
+            if (static_cast<size_t>(end - data) < size || checksum(data, size) != sum) {
+                break;
+            }
+            if (!visitor(data, size)) {
+                break;
+            }
+            data += size;
+            valid_size = data - begin;
+        }
+        return true;
+    }
+
+    /*
+        * @brief 截掉崩溃时写了一半的尾部记录, 否则重新open后追加的记录会排在无法读取的记录之后, 下次恢复时全部丢失
+        * @param path 日志文件路径
+        * @param valid_size read_all()输出的有效长度
+        * @return 截断成功或文件不存在返回true, 否则返回false
+    */
+    static bool truncate(const std::string& path, size_t valid_size) {
+        int fd = ::open(path.c_str(), O_WRONLY);
+        if (fd < 0) {
+            return errno == ENOENT;
+        }
+        struct stat st;
+        bool ok = ::fstat(fd, &st) == 0;
+        if (ok && static_cast<size_t>(st.st_size) > valid_size) {
+            ok = ::ftruncate(fd, static_cast<off_t>(valid_size)) == 0 && ::fsync(fd) == 0;
+        }
+        ::close(fd);
+        return ok;
+    }
+
+private:
+    /*
+        * @brief 组提交线程, 每隔group_commit_interval_ms写入一批记录
+    */
+    void loop_commit() {
+        std::unique_lock<std::mutex> lock(_buffer_mutex);
+        while (_is_running) {
+            _commit_cv.wait_for(lock, std::chrono::milliseconds(_options.group_commit_interval_ms));
+            if (!_is_running) {
+                break;
+            }
+            lock.unlock();
+            // 失败会记录在_failed中, 由之后的append/sync返回给调用者
+            commit(false);
+            lock.lock();
+        }
+    }
+
+    /*
+        * @brief 取出缓冲区并写入文件, 写入期间append不会被阻塞
+        * @param force_fsync 是否忽略策略强制fsync
+        * @return 成功返回true, 否则返回false
+    */
+    bool commit(bool force_fsync) {
+        std::lock_guard<std::mutex> write_lock(_write_mutex);
+
+        std::string batch;
+        {
+            std::lock_guard<std::mutex> lock(_buffer_mutex);
+            if (_failed) {
+                return false;
+            }
+            batch.swap(_buffer);
+        }
+        if (_fd < 0) {
+            return false;
+        }
+
+        // 写入失败时截回写入前的位置, 不在日志中间留下写了一半的记录
+        off_t offset = ::lseek(_fd, 0, SEEK_END);
+        size_t written = 0;
+        while (offset >= 0 && written < batch.size()) {
+            ssize_t n = ::write(_fd, batch.data() + written, batch.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            written += n;
+        }
+        if (offset < 0 || written < batch.size()) {
+            if (offset >= 0) {
+                ::ftruncate(_fd, offset);
+            }
+            fail(batch);
+            return false;
+        }
+        bool need_fsync = force_fsync || _options.fsync_policy == WalFsyncPolicy::kEveryBatch;
+        if (_options.fsync_policy == WalFsyncPolicy::kInterval
+            && std::chrono::steady_clock::now() - _last_fsync >= std::chrono::milliseconds(_options.fsync_interval_ms)) {
+            need_fsync = true;
+        }
+        if (need_fsync) {
+            _last_fsync = std::chrono::steady_clock::now();
+            // fsync失败后page cache中的数据是否落盘无法确定, 不能重试
+            if (::fsync(_fd) != 0) {
+                fail(std::string());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+        * @brief 进入失败状态, 未写入的记录放回缓冲区头部, 保持记录顺序
+        * @param batch 未写入的记录
+    */
+    void fail(std::string batch) {
+        std::lock_guard<std::mutex> lock(_buffer_mutex);
+
+        batch.append(_buffer);
+        _buffer.swap(batch);
+        _failed = true;
+    }
+
+    /*
+        * @brief FNV-1a校验和, 用于识别写了一半的尾部记录
+    */
+    static uint32_t checksum(const char* data, size_t size) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    int _fd;
+    WalOptions _options;
+
+    // 待写入的记录
+    std::string _buffer;
+    // 写入或fsync失败过, 由_buffer_mutex保护
+    bool _failed;
+    std::mutex _buffer_mutex;
+
+    // 保证同一时间只有一个线程写文件
+    std::mutex _write_mutex;
+    // 上次fsync的时间, 由_write_mutex保护
+    std::chrono::steady_clock::time_point _last_fsync;
+
+    std::condition_variable _commit_cv;
+    std::thread _commit_thread;
+    std::atomic<bool> _is_running;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "key_value.h"
+
+/*
+    * @brief 窗口聚合结果, count为0时min/max无意义
+*/
+struct WindowAggregateResult {
+    int count = 0;
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+};
+
+/*
+    * @brief 滑动窗口聚合, 统计最近window_ms内插入/更新且仍然存在的数据
+    * count/sum 在移出窗口时直接减去; min/max 不可逆, 使用有序multiset维护, 支持任意位置删除
+    * 所有接口均不加锁, 由SafeMap在持有_mutex时调用
+*/
+template<typename K, typename V>
+class WindowAggregate {
+public:
+    using Extractor = std::function<double(const V&)>;
+
+    WindowAggregate(int window_ms, Extractor extractor)
+        : _window_ms(window_ms)
+        , _extractor(std::move(extractor))
+        , _sum(0) {}
+
+    /*
+        * @brief 数据插入时调用, 数据按insert_time顺序到达
+        * @param map_value 新插入的数据
+    */
+    void add(const KeyValue<K, V>& map_value) {
+        double value = _extractor(map_value.get_value());
+        _order.emplace_back(map_value.get_insert_time(), map_value.get_key());
+        _members[map_value.get_key()] = Member{map_value.get_insert_time(), value};
+        _values.insert(value);
+        _sum += value;
+    }
+
+    /*
+        * @brief 数据被删除或过期时调用, 不在窗口内的数据会被忽略
+        * @param map_value 被删除的数据
+    */
+    void remove(const KeyValue<K, V>& map_value) {
+        auto it = _members.find(map_value.get_key());
+        if (it == _members.end() || it->second.insert_time != map_value.get_insert_time()) {
+            return;
+        }
+        erase_member(it);
+    }
+
+    /*
+        * @brief 将insert_time早于now - window_ms的数据移出窗口, 均摊O(1)
+        * @param now 当前时间
+    */
+    void slide(const TimeStamp& now) {
+        auto window_start = now - std::chrono::milliseconds(_window_ms);
+        while (!_order.empty() && _order.front().first < window_start) {
+            auto it = _members.find(_order.front().second);
+            // 同一个key可能已被删除后重新插入, 只移除insert_time匹配的那一条
+            if (it != _members.end() && it->second.insert_time == _order.front().first) {
+                erase_member(it);
+            }
+            _order.pop_front();
+        }
+    }
+
+    /*
+        * @brief 获取当前聚合结果, O(1)
+    */
+    WindowAggregateResult get() const {
+        WindowAggregateResult result;
+        result.count = static_cast<int>(_members.size());
+        result.sum = _sum;
+        if (!_values.empty()) {
+            result.min = *_values.begin();
+            result.max = *_values.rbegin();
+        }
+        return result;
+    }
+
+    /*
+        * @brief 清空窗口内的数据, 用于整体替换map内容后重新初始化
+    */
+    void clear() {
+        _order.clear();
+        _members.clear();
+        _values.clear();
+        _sum = 0;
+    }
+
+    int get_window_ms() const {
+        return _window_ms;
+    }
+
+private:
+    struct Member {
+        TimeStamp insert_time;
+        double value;
+    };
+
+    void erase_member(typename std::unordered_map<K, Member>::iterator it) {
+        _sum -= it->second.value;
+        _values.erase(_values.find(it->second.value));
+        _members.erase(it);
+    }
+
+    int _window_ms;
+    Extractor _extractor;
+
+    // 按insert_time从小到大记录进入窗口的key, 已删除的key会在滑出时跳过
+    std::deque<std::pair<TimeStamp, K>> _order;
+
+    // 当前窗口内的数据
+    std::unordered_map<K, Member> _members;
+
+    // 当前窗口内的值, 用于维护min/max
+    std::multiset<double> _values;
+
+    double _sum;
+};
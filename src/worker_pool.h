@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    * @brief 固定线程数的任务池, 线程在构造时启动, 析构时执行完已提交的任务后退出
+    * 任务按提交顺序执行; 任务中不能等待同一个池中的其他任务, 可以用in_worker_thread()检查后改为直接执行
+*/
+class WorkerPool {
+public:
+    explicit WorkerPool(int thread_count) : _is_running(true) {
+        for (int i = 0; i < thread_count; ++i) {
+            _threads.emplace_back([this]{loop_work();});
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _is_running = false;
+        }
+        _cv.notify_all();
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    /*
+        * @brief 提交一个任务
+        * @param func Result()
+        * @return 任务结果
+    */
+    template<typename Func>
+    auto submit(Func func) -> std::future<decltype(func())> {
+        // std::function要求可复制, packaged_task只能移动, 用shared_ptr包装
+        auto task = std::make_shared<std::packaged_task<decltype(func())()>>(std::move(func));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.emplace_back([task]{(*task)();});
+        }
+        _cv.notify_one();
+        return future;
+    }
+
+    int size() const {
+        return static_cast<int>(_threads.size());
+    }
+
+    /*
+        * @brief 当前线程是否是该池的工作线程, 其他池的工作线程返回false
+    */
+    bool in_worker_thread() const {
+        return current_pool() == this;
+    }
+
+private:
+    /*
+        * @brief 当前线程所属的池, 不是工作线程时为nullptr
+    */
+    static const WorkerPool*& current_pool() {
+        static thread_local const WorkerPool* pool = nullptr;
+        return pool;
+    }
+
+    void loop_work() {
+        current_pool() = this;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _cv.wait(lock, [this]{return !_is_running || !_tasks.empty();});
+            if (_tasks.empty()) {
+                return;
+            }
+            auto task = std::move(_tasks.front());
+            _tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread> _threads;
+    bool _is_running;
+};
@@ -0,0 +1,254 @@
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "async_safe_map.h"
+#include "worker_pool.h"
+
+namespace {
+
+// 立即开始执行、结束后自行销毁的协程
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+AsyncExecutor pool_executor(WorkerPool& pool) {
+    return [&pool](std::function<void()> task) {
+        pool.submit(std::move(task));
+    };
+}
+
+std::thread::id pool_thread_id(WorkerPool& pool) {
+    return pool.submit([] {
+        return std::this_thread::get_id();
+    }).get();
+}
+
+bool wait_until(const std::atomic<bool>& flag) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!flag.load() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return flag.load();
+}
+
+// 开启blocking后, 复制该值的线程停在复制构造中, 直到release; SafeMap在_mutex内复制值, 用来从外部占住_mutex
+struct GateValue {
+    static std::atomic<bool> blocking;
+    static std::atomic<bool> entered;
+    static std::atomic<bool> release;
+
+    GateValue() : id(0) {}
+    explicit GateValue(int id) : id(id) {}
+    GateValue(const GateValue& other) : id(other.id) {
+        if (blocking.exchange(false)) {
+            entered = true;
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+    GateValue& operator=(const GateValue&) = default;
+
+    int id;
+};
+
+std::atomic<bool> GateValue::blocking(false);
+std::atomic<bool> GateValue::entered(false);
+std::atomic<bool> GateValue::release(false);
+
+Detached insert_then_get(AsyncSafeMap<int, int>& map, int key, std::atomic<int>& done, std::atomic<int>& mismatches) {
+    bool inserted = co_await map.async_insert(key, key * 10);
+    auto value = co_await map.async_get(key);
+    if (!inserted || !value || *value != key * 10) {
+        ++mismatches;
+    }
+    ++done;
+}
+
+}
+
+TEST(AsyncSafeMapTest, OperationsRoundTrip) {
+    SafeMap<int, int> map;
+    WorkerPool pool(1);
+    AsyncSafeMap<int, int> async_map(map, pool_executor(pool));
+
+    std::promise<void> finished;
+    pool.submit([&] {
+        [](AsyncSafeMap<int, int>& async_map, std::promise<void>& finished) -> Detached {
+            EXPECT_TRUE(co_await async_map.async_insert(1, 10));
+            EXPECT_TRUE(co_await async_map.async_insert(2, 20));
+            EXPECT_EQ(std::optional<int>(10), co_await async_map.async_get(1));
+            EXPECT_EQ(2u, (co_await async_map.async_get_by_time_range(TimeStamp(), std::chrono::system_clock::now())).size());
+            EXPECT_TRUE(co_await async_map.async_erase(1));
+            EXPECT_FALSE((co_await async_map.async_get(1)).has_value());
+            finished.set_value();
+        }(async_map, finished);
+    });
+    ASSERT_EQ(std::future_status::ready, finished.get_future().wait_for(std::chrono::seconds(5)));
+}
+
+TEST(AsyncSafeMapTest, BusyMapMutexSuspendsInsteadOfBlockingExecutor) {
+    SafeMap<int, GateValue> map;
+    map.insert(1, GateValue(1));
+    WorkerPool pool(1);
+    std::thread::id executor_thread = pool_thread_id(pool);
+    AsyncSafeMap<int, GateValue> async_map(map, pool_executor(pool));
+
+    // 同步调用者在_mutex内复制值时被卡住
+    GateValue::entered = false;
+    GateValue::release = false;
+    GateValue::blocking = true;
+    std::thread holder([&map] {
+        map.get_by_order(1);
+    });
+    ASSERT_TRUE(wait_until(GateValue::entered));
+
+    std::atomic<bool> inserted(false);
+    std::atomic<bool> resumed_on_executor(false);
+    pool.submit([&] {
+        [](AsyncSafeMap<int, GateValue>& async_map, std::atomic<bool>& inserted, std::atomic<bool>& resumed_on_executor,
+           std::thread::id executor_thread) -> Detached {
+            bool ok = co_await async_map.async_insert(2, GateValue(2));
+            resumed_on_executor = std::this_thread::get_id() == executor_thread;
+            inserted = ok;
+        }(async_map, inserted, resumed_on_executor, executor_thread);
+    });
+
+    // 唯一的执行器线程没有阻塞在_mutex上, 还能运行其他任务
+    std::atomic<bool> other_task_ran(false);
+    pool.submit([&other_task_ran] {
+        other_task_ran = true;
+    });
+    EXPECT_TRUE(wait_until(other_task_ran));
+    EXPECT_FALSE(inserted.load());
+
+    GateValue::release = true;
+    holder.join();
+    EXPECT_TRUE(wait_until(inserted));
+    EXPECT_TRUE(resumed_on_executor.load());
+    GateValue value;
+    EXPECT_TRUE(map.get_by_key(2, value));
+    EXPECT_EQ(2, value.id);
+}
+
+TEST(AsyncSafeMapTest, BusyMapMutexParksInsteadOfRetrying) {
+    SafeMap<int, GateValue> map;
+    map.insert(1, GateValue(1));
+    WorkerPool pool(1);
+    AsyncSafeMap<int, GateValue> async_map(map, pool_executor(pool));
+
+    GateValue::entered = false;
+    GateValue::release = false;
+    GateValue::blocking = true;
+    std::thread holder([&map] {
+        map.get_by_order(1);
+    });
+    ASSERT_TRUE(wait_until(GateValue::entered));
+
+    // 统计_mutex被占用期间尝试的次数
+    std::atomic<int> attempts(0);
+    std::atomic<bool> done(false);
+    pool.submit([&] {
+        [](AsyncSafeMap<int, GateValue>& async_map, std::atomic<int>& attempts, std::atomic<bool>& done) -> Detached {
+            co_await async_map.async_call<bool>([&attempts](SafeMap<int, GateValue>& map, bool& inserted) {
+                ++attempts;
+                return map.try_insert(2, GateValue(2), -1, inserted);
+            });
+            done = true;
+        }(async_map, attempts, done);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // 第一次失败后停放, 直到_mutex释放才再次尝试
+    EXPECT_EQ(1, attempts.load());
+    EXPECT_FALSE(done.load());
+
+    GateValue::release = true;
+    holder.join();
+    EXPECT_TRUE(wait_until(done));
+    EXPECT_LE(attempts.load(), 3);
+}
+
+TEST(AsyncSafeMapTest, UnlockHandsWaiterBackToItsExecutor) {
+    AsyncMutex mutex;
+    WorkerPool pool(1);
+    std::thread::id executor_thread = pool_thread_id(pool);
+    ASSERT_TRUE(mutex.try_lock());
+
+    std::atomic<bool> waiter_ran(false);
+    std::atomic<bool> ran_on_executor(false);
+    std::atomic<bool> unlock_returned(false);
+    std::atomic<bool> ran_after_unlock(false);
+    ASSERT_TRUE(mutex.lock_or_enqueue([&] {
+        pool.submit([&] {
+            ran_after_unlock = unlock_returned.load();
+            ran_on_executor = std::this_thread::get_id() == executor_thread;
+            waiter_ran = true;
+            mutex.unlock();
+        });
+    }));
+
+    // 先占住执行器, 保证等待者不可能在unlock返回前运行
+    std::promise<void> gate;
+    std::shared_future<void> gate_future = gate.get_future().share();
+    pool.submit([gate_future] {
+        gate_future.wait();
+    });
+    mutex.unlock();
+    unlock_returned = true;
+    gate.set_value();
+
+    ASSERT_TRUE(wait_until(waiter_ran));
+    EXPECT_TRUE(ran_after_unlock.load());
+    EXPECT_TRUE(ran_on_executor.load());
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(AsyncSafeMapTest, ContendedCoroutinesWithSynchronousWriter) {
+    SafeMap<int, int> map;
+    WorkerPool pool(4);
+    AsyncSafeMap<int, int> async_map(map, pool_executor(pool));
+
+    std::atomic<bool> stop(false);
+    std::thread writer([&map, &stop] {
+        for (int i = 0; !stop; ++i) {
+            map.insert(100000 + i % 100, i);
+        }
+    });
+
+    const int count = 200;
+    std::atomic<int> done(0);
+    std::atomic<int> mismatches(0);
+    for (int i = 0; i < count; ++i) {
+        pool.submit([&async_map, &done, &mismatches, i] {
+            insert_then_get(async_map, i, done, mismatches);
+        });
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (done < count && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    writer.join();
+    EXPECT_EQ(count, done.load());
+    EXPECT_EQ(0, mismatches.load());
+}
@@ -0,0 +1,88 @@
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "change_feed_follower.h"
+#include "safe_map.h"
+
+namespace {
+
+bool wait_caught_up(SafeMap<int, int>& primary, ChangeFeedFollower<int, int>& follower) {
+    auto feed = primary.get_change_feed();
+    for (int i = 0; i < 5000; ++i) {
+        if (follower.applied_sequence() == feed->head()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+void expect_same_keys(SafeMap<int, int>& primary, SafeMap<int, int>& replica) {
+    auto expected = primary.get_by_order(INT_MAX);
+    auto actual = replica.get_by_order(INT_MAX);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].get_key(), actual[i].get_key());
+        EXPECT_EQ(expected[i].get_value(), actual[i].get_value());
+    }
+}
+
+}
+
+TEST(ChangeFeedTest, FollowerResyncsAfterPrimaryReload) {
+    std::string path = ::testing::TempDir() + "change_feed_reload.snap";
+    SafeMap<int, int> primary;
+    SafeMap<int, int> replica;
+    primary.enable_change_feed();
+    for (int i = 0; i < 100; ++i) {
+        primary.insert(i, i);
+    }
+    ASSERT_TRUE(primary.save_snapshot(path));
+    for (int i = 100; i < 200; ++i) {
+        primary.insert(i, i);
+    }
+
+    ChangeFeedFollower<int, int> follower(primary, replica);
+    ASSERT_TRUE(wait_caught_up(primary, follower));
+    uint64_t before_reload = primary.get_change_feed()->head();
+
+    // 加载较早的快照不能使序号回退, 否则已追上的follower会把重新使用的序号当作新记录应用
+    ASSERT_TRUE(primary.load_snapshot(path));
+    EXPECT_GT(primary.get_change_feed()->head(), before_reload);
+    for (int i = 1000; i < 1300; ++i) {
+        primary.insert(i, -i);
+    }
+
+    ASSERT_TRUE(wait_caught_up(primary, follower));
+    expect_same_keys(primary, replica);
+    EXPECT_GE(follower.resync_count(), 2);
+    std::remove(path.c_str());
+}
+
+TEST(ChangeFeedTest, EnablingTwiceKeepsFollowersAttached) {
+    SafeMap<int, int> primary;
+    SafeMap<int, int> replica;
+    EXPECT_TRUE(primary.enable_change_feed(16));
+    auto feed = primary.get_change_feed();
+    for (int i = 0; i < 10; ++i) {
+        primary.insert(i, i);
+    }
+
+    ChangeFeedFollower<int, int> follower(primary, replica);
+    ASSERT_TRUE(wait_caught_up(primary, follower));
+
+    // 重复开启不替换变更流, follower继续收到之后的变更
+    EXPECT_FALSE(primary.enable_change_feed(1024));
+    EXPECT_EQ(feed, primary.get_change_feed());
+    for (int i = 10; i < 20; ++i) {
+        primary.insert(i, i);
+    }
+    ASSERT_TRUE(primary.erase_by_key(0));
+    ASSERT_TRUE(wait_caught_up(primary, follower));
+    expect_same_keys(primary, replica);
+    EXPECT_EQ(1, follower.resync_count());
+}
@@ -0,0 +1,183 @@
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+std::string temp_path(const std::string& name) {
+    std::string path = ::testing::TempDir() + name;
+    std::remove(path.c_str());
+    return path;
+}
+
+template<typename K, typename V>
+void expect_same_entries(const std::vector<KeyValue<K, V>>& expected, const std::vector<KeyValue<K, V>>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].get_key(), actual[i].get_key());
+        EXPECT_EQ(expected[i].get_value(), actual[i].get_value());
+        EXPECT_EQ(expected[i].get_insert_time(), actual[i].get_insert_time());
+        EXPECT_EQ(expected[i].get_expire_time_interval(), actual[i].get_expire_time_interval());
+        if (expected[i].get_expire_time_interval() != -1) {
+            EXPECT_EQ(expected[i].get_expire_time(), actual[i].get_expire_time()) << "key " << expected[i].get_key();
+        }
+    }
+}
+
+}
+
+TEST(CheckpointTest, BasePlusDeltaChainMatchesLiveMap) {
+    std::string base = temp_path("checkpoint_base.snap");
+    std::vector<std::string> deltas = {temp_path("checkpoint_1.delta"), temp_path("checkpoint_2.delta"), temp_path("checkpoint_3.delta")};
+
+    SafeMap<int, std::string> map;
+    uint64_t since = map.enable_incremental_checkpoint();
+    for (int i = 0; i < 100; ++i) {
+        map.insert(i, "v" + std::to_string(i), i % 2 == 0 ? -1 : 600000);
+    }
+    ASSERT_TRUE(map.save_snapshot(base));
+
+    // 删除、覆盖、只修改过期时间、新插入
+    ASSERT_TRUE(map.erase_by_key(5));
+    ASSERT_TRUE(map.update_value(6, "updated"));
+    EXPECT_EQ(2, map.set_ttl_batch({10, 11}, 300000));
+    auto all = map.get_by_order(INT_MAX);
+    EXPECT_EQ(5, map.extend_ttl_by_time_range(all[20].get_insert_time(), all[29].get_insert_time(), 1000));
+    for (int i = 100; i < 110; ++i) {
+        map.insert(i, "new" + std::to_string(i));
+    }
+    uint64_t sequence;
+    ASSERT_TRUE(map.checkpoint_since(since, deltas[0], sequence));
+    EXPECT_GT(sequence, since);
+    since = sequence;
+
+    // 重新插入已删除的key, 删除上一个增量中新插入的key, 同一个key多次变更
+    ASSERT_TRUE(map.insert(5, "back"));
+    ASSERT_TRUE(map.erase_by_key(100));
+    ASSERT_TRUE(map.erase_by_key(6));
+    ASSERT_TRUE(map.insert(6, "again", 600000));
+    ASSERT_TRUE(map.update_value(7, "x"));
+    ASSERT_TRUE(map.update_value(7, "y"));
+    ASSERT_TRUE(map.checkpoint_since(since, deltas[1], sequence));
+    since = sequence;
+
+    // 没有变更的增量
+    ASSERT_TRUE(map.checkpoint_since(since, deltas[2], sequence));
+    EXPECT_EQ(since, sequence);
+
+    SafeMap<int, std::string> loaded;
+    ASSERT_TRUE(loaded.load_checkpoints(base, deltas));
+    expect_same_entries(map.get_by_order(INT_MAX), loaded.get_by_order(INT_MAX));
+
+    std::string value;
+    ASSERT_TRUE(loaded.get_by_key(5, value));
+    EXPECT_EQ("back", value);
+    ASSERT_TRUE(loaded.get_by_key(7, value));
+    EXPECT_EQ("y", value);
+    EXPECT_FALSE(loaded.get_by_key(100, value));
+
+    // 只应用一部分增量得到中间状态
+    SafeMap<int, std::string> partial;
+    ASSERT_TRUE(partial.load_checkpoints(base, {deltas[0]}));
+    EXPECT_FALSE(partial.get_by_key(5, value));
+    ASSERT_TRUE(partial.get_by_key(6, value));
+    EXPECT_EQ("updated", value);
+    EXPECT_TRUE(partial.get_by_key(100, value));
+
+    std::remove(base.c_str());
+    for (auto& path : deltas) {
+        std::remove(path.c_str());
+    }
+}
+
+TEST(CheckpointTest, ChangesRightAfterACheckpointAreNotLost) {
+    std::string base = temp_path("checkpoint_boundary.snap");
+    std::string first = temp_path("checkpoint_boundary_1.delta");
+    std::string second = temp_path("checkpoint_boundary_2.delta");
+
+    SafeMap<int, int> map;
+    uint64_t since = map.enable_incremental_checkpoint();
+    map.insert(1, 1);
+    map.insert(2, 2, 600000);
+    ASSERT_TRUE(map.save_snapshot(base));
+
+    uint64_t sequence;
+    ASSERT_TRUE(map.checkpoint_since(since, first, sequence));
+    // 与检查点在同一毫秒内发生的变更也属于下一个增量
+    ASSERT_TRUE(map.erase_by_key(1));
+    EXPECT_EQ(1, map.set_ttl_batch({2}, 900000));
+    ASSERT_TRUE(map.insert(3, 3));
+    ASSERT_TRUE(map.checkpoint_since(sequence, second, sequence));
+
+    SafeMap<int, int> loaded;
+    ASSERT_TRUE(loaded.load_checkpoints(base, {first, second}));
+    expect_same_entries(map.get_by_order(INT_MAX), loaded.get_by_order(INT_MAX));
+
+    std::remove(base.c_str());
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+}
+
+TEST(CheckpointTest, RequiresEnableAndMatchingFileTypes) {
+    std::string base = temp_path("checkpoint_types.snap");
+    std::string delta = temp_path("checkpoint_types.delta");
+
+    SafeMap<int, int> map;
+    map.insert(1, 1);
+    uint64_t sequence;
+    EXPECT_FALSE(map.checkpoint_since(0, delta, sequence));
+
+    map.enable_incremental_checkpoint();
+    ASSERT_TRUE(map.save_snapshot(base));
+    ASSERT_TRUE(map.checkpoint_since(0, delta, sequence));
+
+    SafeMap<int, int> loaded;
+    EXPECT_FALSE(loaded.load_checkpoints(delta, {}));
+    EXPECT_FALSE(loaded.load_checkpoints(base, {base}));
+    EXPECT_FALSE(loaded.load_checkpoints(base, {temp_path("checkpoint_missing.delta")}));
+    EXPECT_TRUE(loaded.load_checkpoints(base, {delta}));
+
+    std::remove(base.c_str());
+    std::remove(delta.c_str());
+}
+
+TEST(CheckpointTest, RepeatedChangesToFewKeysKeepTheFinalState) {
+    std::string base = temp_path("checkpoint_churn.snap");
+    std::string delta = temp_path("checkpoint_churn.delta");
+
+    SafeMap<int, int> map;
+    uint64_t since = map.enable_incremental_checkpoint();
+    for (int i = 0; i < 4; ++i) {
+        map.insert(i, 0);
+    }
+    ASSERT_TRUE(map.save_snapshot(base));
+
+    // 检查点之间大量变更集中在少数key上, 每个key只记录最后一次变更
+    for (int round = 1; round <= 10000; ++round) {
+        ASSERT_TRUE(map.update_value(round % 4, round));
+        if (round % 1000 == 0) {
+            ASSERT_TRUE(map.erase_by_key(3));
+            ASSERT_TRUE(map.insert(3, -round));
+        }
+    }
+    ASSERT_TRUE(map.erase_by_key(2));
+    uint64_t sequence;
+    ASSERT_TRUE(map.checkpoint_since(since, delta, sequence));
+
+    SafeMap<int, int> loaded;
+    ASSERT_TRUE(loaded.load_checkpoints(base, {delta}));
+    expect_same_entries(map.get_by_order(INT_MAX), loaded.get_by_order(INT_MAX));
+    int value;
+    EXPECT_FALSE(loaded.get_by_key(2, value));
+    ASSERT_TRUE(loaded.get_by_key(3, value));
+    EXPECT_EQ(-10000, value);
+
+    std::remove(base.c_str());
+    std::remove(delta.c_str());
+}
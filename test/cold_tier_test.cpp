@@ -0,0 +1,182 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+std::string temp_path(const std::string& name) {
+    return ::testing::TempDir() + name;
+}
+
+/*
+    * @brief 转移数据直到冷存储中共有count条, tick线程也在同时转移, 以统计为准
+    * @return 冷存储中的数据条数
+*/
+template<typename K, typename V>
+uint64_t spill_until(SafeMap<K, V>& map, uint64_t count) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (map.get_cold_tier_stats().spilled_count < count && std::chrono::steady_clock::now() < deadline) {
+        map.spill_cold();
+        std::this_thread::yield();
+    }
+    return map.get_cold_tier_stats().spilled_count;
+}
+
+/*
+    * @brief 序列化value时调用on_write, 用于在spill_cold锁外的序列化阶段插入操作
+*/
+struct HookedSerializer {
+    static std::function<void()>& on_write() {
+        static std::function<void()> hook;
+        return hook;
+    }
+
+    static void write(std::string& out, const int& value) {
+        if (on_write()) {
+            on_write()();
+        }
+        Serializer<int>::write(out, value);
+    }
+
+    static bool read(const char*& data, const char* end, int& value) {
+        return Serializer<int>::read(data, end, value);
+    }
+};
+
+}
+
+TEST(ColdTierTest, CompressedValuesReadBack) {
+    std::string path = temp_path("cold_compressed.cold");
+    SafeMap<int, std::string> map;
+    ColdTierOptions options;
+    options.codec = std::make_shared<LzCodec>();
+    options.compress_threshold = 64;
+    ASSERT_TRUE(map.enable_cold_tier(path, 0, options));
+
+    for (int i = 0; i < 100; ++i) {
+        // 一半超过压缩阈值
+        std::string value = i % 2 == 0 ? std::string(200, 'a' + i % 26) + std::to_string(i) : "small" + std::to_string(i);
+        map.insert(i, value);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ASSERT_EQ(100u, spill_until(map, 100));
+
+    for (int i = 0; i < 100; ++i) {
+        std::string value;
+        ASSERT_TRUE(map.get_by_key(i, value));
+        EXPECT_EQ(i % 2 == 0 ? std::string(200, 'a' + i % 26) + std::to_string(i) : "small" + std::to_string(i), value);
+    }
+    auto stats = map.get_cold_tier_stats();
+    EXPECT_EQ(100u, stats.spilled_count);
+    EXPECT_EQ(50u, stats.compressed_count);
+    EXPECT_LT(stats.stored_bytes, stats.raw_bytes);
+    std::remove(path.c_str());
+}
+
+TEST(ColdTierTest, WindowAggregateSeedsFromColdEntries) {
+    std::string path = temp_path("cold_aggregate.cold");
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.enable_cold_tier(path, 0));
+    for (int i = 1; i <= 50; ++i) {
+        map.insert(i, i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ASSERT_EQ(50u, spill_until(map, 50));
+    map.insert(100, 100);
+
+    // 窗口内的冷数据在锁外读取后参与初始化
+    int id = map.add_window_aggregate(600000);
+    WindowAggregateResult result;
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(51, result.count);
+    EXPECT_DOUBLE_EQ(50 * 51 / 2 + 100, result.sum);
+    EXPECT_DOUBLE_EQ(1, result.min);
+    EXPECT_DOUBLE_EQ(100, result.max);
+
+    // 初始化后冷数据的删除同样从聚合中减去
+    ASSERT_TRUE(map.erase_by_key(1));
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(50, result.count);
+    EXPECT_DOUBLE_EQ(2, result.min);
+    std::remove(path.c_str());
+}
+
+TEST(ColdTierTest, EntriesPinnedDuringSpillAreRetried) {
+    std::string path = temp_path("cold_pinned.cold");
+    SafeMap<int, int> map;
+    const int count = 10;
+    for (int i = 0; i < count; ++i) {
+        map.insert(i, i);
+    }
+
+    // 序列化阶段不持有锁, 此时让count_if取出一批数据并停在pred中, 这批数据在替换为冷节点时被额外持有
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool scanning = false;
+    bool release = false;
+    std::atomic<bool> hooked(false);
+    std::atomic<bool> hooked_on_tick(false);
+    std::thread scanner;
+    auto test_thread = std::this_thread::get_id();
+    HookedSerializer::on_write() = [&] {
+        if (hooked.exchange(true)) {
+            return;
+        }
+        hooked_on_tick = std::this_thread::get_id() != test_thread;
+        scanner = std::thread([&] {
+            map.count_if([&](int, int) {
+                std::unique_lock<std::mutex> lock(mutex);
+                scanning = true;
+                cv.notify_all();
+                cv.wait(lock, [&] {
+                    return release;
+                });
+                return true;
+            });
+        });
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] {
+            return scanning;
+        });
+    };
+    ASSERT_TRUE(map.enable_cold_tier<HookedSerializer>(path, 0));
+
+    // tick线程也会调用spill_cold, 第一次序列化时数据被持有, 整批都不能转移
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!hooked && std::chrono::steady_clock::now() < deadline) {
+        map.spill_cold();
+    }
+    ASSERT_TRUE(hooked);
+    if (hooked_on_tick) {
+        // 等待tick线程中的这次spill_cold在数据仍被持有时完成替换阶段
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_EQ(0u, map.get_cold_tier_stats().spilled_count);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+    }
+    cv.notify_all();
+    scanner.join();
+    HookedSerializer::on_write() = nullptr;
+
+    // 释放后之前跳过的数据会被重新选中
+    EXPECT_EQ(static_cast<uint64_t>(count), spill_until(map, count));
+    for (int i = 0; i < count; ++i) {
+        int value = -1;
+        ASSERT_TRUE(map.get_by_key(i, value));
+        EXPECT_EQ(i, value);
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <climits>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+template<typename K, typename V>
+std::vector<K> keys_of(const std::vector<KeyValue<K, V>>& entries) {
+    std::vector<K> keys;
+    for (auto& entry : entries) {
+        keys.push_back(entry.get_key());
+    }
+    return keys;
+}
+
+/*
+    * @brief 检查取出的数据value为key的10倍, 且按插入时间升序或降序排列
+*/
+void expect_drained(const std::vector<KeyValue<int, int>>& entries, bool asc) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_EQ(entries[i].get_key() * 10, entries[i].get_value()) << "key " << entries[i].get_key();
+        if (i > 0) {
+            if (asc) {
+                EXPECT_LT(entries[i - 1].get_insert_time(), entries[i].get_insert_time()) << "key " << entries[i].get_key();
+            } else {
+                EXPECT_GT(entries[i - 1].get_insert_time(), entries[i].get_insert_time()) << "key " << entries[i].get_key();
+            }
+        }
+    }
+}
+
+/*
+    * @brief 检查取出的数据已从map中删除
+*/
+void expect_gone(SafeMap<int, int>& map, const std::vector<KeyValue<int, int>>& entries) {
+    int value;
+    for (auto& entry : entries) {
+        EXPECT_FALSE(map.get_by_key(entry.get_key(), value)) << "key " << entry.get_key();
+    }
+}
+
+}
+
+TEST(DrainTest, DrainByOrderFromBothEnds) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 10; ++i) {
+        map.insert(i, i * 10);
+    }
+
+    auto oldest = map.drain_by_order(3);
+    EXPECT_EQ(std::vector<int>({0, 1, 2}), keys_of(oldest));
+    expect_drained(oldest, true);
+    expect_gone(map, oldest);
+    EXPECT_EQ(7u, map.get_by_order(INT_MAX).size());
+
+    auto newest = map.drain_by_order(2, false);
+    EXPECT_EQ(std::vector<int>({9, 8}), keys_of(newest));
+    expect_drained(newest, false);
+    expect_gone(map, newest);
+    EXPECT_EQ(std::vector<int>({3, 4, 5, 6, 7}), keys_of(map.get_by_order(INT_MAX)));
+
+    // n超过剩余条数时取出全部
+    auto rest = map.drain_by_order(100);
+    EXPECT_EQ(std::vector<int>({3, 4, 5, 6, 7}), keys_of(rest));
+    expect_drained(rest, true);
+    EXPECT_TRUE(map.get_by_order(INT_MAX).empty());
+    EXPECT_TRUE(map.drain_by_order(1).empty());
+
+    // 取出后可以重新插入
+    EXPECT_TRUE(map.insert(0, 1));
+}
+
+TEST(DrainTest, DrainByTimeRangeBoundsAreInclusive) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 10; ++i) {
+        map.insert(i, i * 10);
+    }
+    auto all = map.get_by_order(INT_MAX);
+    ASSERT_EQ(10u, all.size());
+
+    EXPECT_TRUE(map.drain_by_time_range(all[5].get_insert_time(), all[2].get_insert_time()).empty());
+    auto asc = map.drain_by_time_range(all[2].get_insert_time(), all[5].get_insert_time());
+    EXPECT_EQ(std::vector<int>({2, 3, 4, 5}), keys_of(asc));
+    expect_drained(asc, true);
+    expect_gone(map, asc);
+
+    auto desc = map.drain_by_time_range(all[6].get_insert_time(), all[8].get_insert_time(), false);
+    EXPECT_EQ(std::vector<int>({8, 7, 6}), keys_of(desc));
+    expect_drained(desc, false);
+    expect_gone(map, desc);
+
+    // 已取出的范围再次取出为空, 范围外的数据不受影响
+    EXPECT_TRUE(map.drain_by_time_range(all[2].get_insert_time(), all[8].get_insert_time()).empty());
+    EXPECT_EQ(std::vector<int>({0, 1, 9}), keys_of(map.get_by_order(INT_MAX)));
+    int value;
+    ASSERT_TRUE(map.get_by_key(9, value));
+    EXPECT_EQ(90, value);
+}
+
+TEST(DrainTest, ExpiredEntriesAreSkipped) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 10; ++i) {
+        map.insert(i, i * 10, i % 2 == 0 ? 1 : -1);
+    }
+    auto all = map.get_by_order(INT_MAX);
+    ASSERT_EQ(10u, all.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // 过期的数据不计入n
+    auto oldest = map.drain_by_order(2);
+    EXPECT_EQ(std::vector<int>({1, 3}), keys_of(oldest));
+    expect_drained(oldest, true);
+    auto newest = map.drain_by_order(1, false);
+    EXPECT_EQ(std::vector<int>({9}), keys_of(newest));
+
+    auto range = map.drain_by_time_range(all[4].get_insert_time(), all[8].get_insert_time(), false);
+    EXPECT_EQ(std::vector<int>({7, 5}), keys_of(range));
+    expect_drained(range, false);
+    EXPECT_TRUE(map.get_by_order(INT_MAX).empty());
+}
@@ -0,0 +1,170 @@
+#include <chrono>
+#include <climits>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+template<typename K, typename V>
+std::vector<K> keys_of(const std::vector<KeyValue<K, V>>& entries) {
+    std::vector<K> keys;
+    for (auto& entry : entries) {
+        keys.push_back(entry.get_key());
+    }
+    return keys;
+}
+
+/*
+    * @brief 检查数据按过期时间升序排列, 且都会过期
+*/
+template<typename K, typename V>
+void expect_expire_order(const std::vector<KeyValue<K, V>>& entries) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_NE(-1, entries[i].get_expire_time_interval()) << "key " << entries[i].get_key();
+        if (i > 0) {
+            EXPECT_LE(entries[i - 1].get_expire_time(), entries[i].get_expire_time()) << "key " << entries[i].get_key();
+        }
+    }
+}
+
+}
+
+TEST(ExpireIndexTest, ExpireRangeBoundsAreInclusive) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 8; ++i) {
+        map.insert(i, i, 600000 + i * 1000);
+    }
+    auto all = map.get_soonest_expiring(INT_MAX);
+    ASSERT_EQ(8u, all.size());
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}), keys_of(all));
+
+    auto start = all[2].get_expire_time();
+    auto end = all[5].get_expire_time();
+    EXPECT_EQ(std::vector<int>({2, 3, 4, 5}), keys_of(map.get_by_expire_range(start, end)));
+    EXPECT_EQ(std::vector<int>({5, 4, 3, 2}), keys_of(map.get_by_expire_range(start, end, false)));
+    // 端点各移动一个时钟单位后不再包含
+    auto tick = TimeStamp::duration(1);
+    EXPECT_EQ(std::vector<int>({3, 4}), keys_of(map.get_by_expire_range(start + tick, end - tick)));
+    EXPECT_EQ(std::vector<int>({2}), keys_of(map.get_by_expire_range(start, start)));
+    EXPECT_TRUE(map.get_by_expire_range(start + tick, start + tick).empty());
+    EXPECT_TRUE(map.get_by_expire_range(end, start).empty());
+}
+
+TEST(ExpireIndexTest, EntriesWithoutTtlOrExpiredAreExcluded) {
+    SafeMap<int, int> map;
+    map.insert(1, 1);
+    map.insert(2, 2, 600000);
+    map.insert(3, 3, 1);
+    map.insert(4, 4);
+    map.insert(5, 5, 300000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    auto all = map.get_by_expire_range(TimeStamp::min(), TimeStamp::max());
+    EXPECT_EQ(std::vector<int>({5, 2}), keys_of(all));
+    expect_expire_order(all);
+    EXPECT_EQ(std::vector<int>({5, 2}), keys_of(map.get_soonest_expiring(INT_MAX)));
+    EXPECT_EQ(std::vector<int>({5}), keys_of(map.get_soonest_expiring(1)));
+    EXPECT_TRUE(map.get_soonest_expiring(0).empty());
+
+    // 删除的数据离开过期索引
+    ASSERT_TRUE(map.erase_by_key(5));
+    EXPECT_EQ(std::vector<int>({2}), keys_of(map.get_soonest_expiring(INT_MAX)));
+}
+
+TEST(ExpireIndexTest, OrderFollowsTtlChanges) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 6; ++i) {
+        map.insert(i, i, 600000 + i * 1000);
+    }
+    map.insert(6, 6);
+
+    // 最晚过期的数据提前, 永不过期的数据进入索引, 改为永不过期的数据离开索引
+    EXPECT_EQ(2, map.set_ttl_batch({5, 6, 100}, 100000));
+    EXPECT_EQ(1, map.set_ttl_batch({0}, -1));
+    auto all = map.get_soonest_expiring(INT_MAX);
+    ASSERT_EQ(6u, all.size());
+    EXPECT_EQ(std::set<int>({5, 6}), std::set<int>({all[0].get_key(), all[1].get_key()}));
+    EXPECT_EQ(std::vector<int>({1, 2, 3, 4}), std::vector<int>({all[2].get_key(), all[3].get_key(), all[4].get_key(), all[5].get_key()}));
+    expect_expire_order(all);
+
+    // 缩短插入时间范围内的过期时间后排到最前
+    auto by_insert = map.get_by_order(INT_MAX);
+    ASSERT_EQ(7u, by_insert.size());
+    EXPECT_EQ(2, map.extend_ttl_by_time_range(by_insert[3].get_insert_time(), by_insert[4].get_insert_time(), -599500));
+    all = map.get_soonest_expiring(INT_MAX);
+    ASSERT_EQ(6u, all.size());
+    EXPECT_EQ(std::vector<int>({3, 4}), std::vector<int>({all[0].get_key(), all[1].get_key()}));
+    expect_expire_order(all);
+    EXPECT_EQ(std::vector<int>({3, 4}), keys_of(map.get_by_expire_range(TimeStamp::min(), all[1].get_expire_time())));
+}
+
+TEST(ExpireIndexTest, ExtendTtlShiftsOnlyEntriesInRange) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 10; ++i) {
+        map.insert(i, i, i % 3 == 0 ? -1 : 600000);
+    }
+    auto before = map.get_by_order(INT_MAX);
+    ASSERT_EQ(10u, before.size());
+
+    EXPECT_EQ(0, map.extend_ttl_by_time_range(before[6].get_insert_time(), before[2].get_insert_time(), 1000));
+    // [2, 6]中3和6永不过期, 不受影响
+    EXPECT_EQ(3, map.extend_ttl_by_time_range(before[2].get_insert_time(), before[6].get_insert_time(), 1234));
+
+    auto after = map.get_by_order(INT_MAX);
+    ASSERT_EQ(10u, after.size());
+    for (size_t i = 0; i < after.size(); ++i) {
+        EXPECT_EQ(before[i].get_key(), after[i].get_key());
+        EXPECT_EQ(before[i].get_insert_time(), after[i].get_insert_time());
+        // 只修改过期时间, 不修改过期时间间隔
+        EXPECT_EQ(before[i].get_expire_time_interval(), after[i].get_expire_time_interval());
+        if (before[i].get_expire_time_interval() == -1) {
+            continue;
+        }
+        if (i >= 2 && i <= 6) {
+            EXPECT_EQ(before[i].get_expire_time() + std::chrono::milliseconds(1234), after[i].get_expire_time()) << "key " << i;
+        } else {
+            EXPECT_EQ(before[i].get_expire_time(), after[i].get_expire_time()) << "key " << i;
+        }
+    }
+
+    // 过期索引按新的过期时间排列, 延长的2/4/5排到范围外的7/8之后
+    auto soonest = map.get_soonest_expiring(INT_MAX);
+    EXPECT_EQ(std::vector<int>({1, 7, 8, 2, 4, 5}), keys_of(soonest));
+    expect_expire_order(soonest);
+    auto end = after[5].get_expire_time();
+    EXPECT_EQ(std::vector<int>({2, 4, 5}), keys_of(map.get_by_expire_range(after[2].get_expire_time(), end)));
+}
+
+TEST(ExpireIndexTest, ExtendTtlDoesNotReviveExpiredEntries) {
+    SafeMap<int, int> map;
+    map.insert(1, 1, 1);
+    map.insert(2, 2, 600000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    EXPECT_EQ(1, map.extend_ttl_by_time_range(TimeStamp::min(), TimeStamp::max(), 600000));
+    int value;
+    EXPECT_FALSE(map.get_by_key(1, value));
+    EXPECT_EQ(std::vector<int>({2}), keys_of(map.get_soonest_expiring(INT_MAX)));
+    EXPECT_TRUE(map.insert(1, 10));
+}
+
+TEST(ExpireIndexTest, ShortenedTtlExpiresAtTheNewTime) {
+    SafeMap<int, int> map;
+    map.insert(1, 1, 600000);
+    map.insert(2, 2, 600000);
+    auto all = map.get_by_order(INT_MAX);
+
+    // 缩短后由tick线程按新的过期时间清除
+    EXPECT_EQ(1, map.extend_ttl_by_time_range(all[0].get_insert_time(), all[0].get_insert_time(), -599980));
+    EXPECT_EQ(std::vector<int>({1, 2}), keys_of(map.get_soonest_expiring(INT_MAX)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    int value;
+    EXPECT_FALSE(map.get_by_key(1, value));
+    EXPECT_TRUE(map.get_by_key(2, value));
+    EXPECT_EQ(std::vector<int>({2}), keys_of(map.get_soonest_expiring(INT_MAX)));
+}
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <climits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+using Clock = std::chrono::system_clock;
+
+template<typename K, typename V>
+void expect_same_entries(const std::vector<KeyValue<K, V>>& expected, const std::vector<KeyValue<K, V>>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].get_key(), actual[i].get_key());
+        EXPECT_EQ(expected[i].get_value(), actual[i].get_value());
+        EXPECT_EQ(expected[i].get_insert_time(), actual[i].get_insert_time());
+        EXPECT_EQ(expected[i].get_expire_time_interval(), actual[i].get_expire_time_interval());
+    }
+}
+
+// 相邻的两个key哈希值相同, 无论盐值和种子如何都无法区分
+struct CoarseHash {
+    size_t operator()(int key) const {
+        return static_cast<size_t>(key / 2);
+    }
+};
+
+}
+
+TEST(FrozenMapTest, EmptyMap) {
+    SafeMap<int, int> map;
+    FrozenMap<int, int> frozen;
+    ASSERT_TRUE(map.freeze(frozen));
+    EXPECT_EQ(0u, frozen.size());
+
+    int value;
+    EXPECT_FALSE(frozen.get_by_key(0, value));
+    EXPECT_TRUE(frozen.get_by_order(10).empty());
+    auto now = Clock::now();
+    EXPECT_TRUE(frozen.get_by_time_range(now - std::chrono::hours(1), now).empty());
+}
+
+TEST(FrozenMapTest, IntegralKeysHitAndMiss) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 1000; ++i) {
+        map.insert(i * 7, i);
+    }
+    FrozenMap<int, int> frozen;
+    ASSERT_TRUE(map.freeze(frozen));
+    EXPECT_EQ(1000u, frozen.size());
+
+    int value = -1;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(frozen.get_by_key(i * 7, value)) << "key " << i * 7;
+        EXPECT_EQ(i, value);
+        EXPECT_FALSE(frozen.get_by_key(i * 7 + 1, value));
+    }
+    EXPECT_FALSE(frozen.get_by_key(-7, value));
+    EXPECT_FALSE(frozen.get_by_key(INT_MAX, value));
+}
+
+TEST(FrozenMapTest, StringKeysHitAndMiss) {
+    SafeMap<std::string, std::string> map;
+    for (int i = 0; i < 500; ++i) {
+        map.insert("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+    map.insert("", "empty key");
+    FrozenMap<std::string, std::string> frozen;
+    ASSERT_TRUE(map.freeze(frozen));
+
+    std::string value;
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_TRUE(frozen.get_by_key("key" + std::to_string(i), value));
+        EXPECT_EQ("value" + std::to_string(i), value);
+        EXPECT_FALSE(frozen.get_by_key("absent" + std::to_string(i), value));
+    }
+    ASSERT_TRUE(frozen.get_by_key("", value));
+    EXPECT_EQ("empty key", value);
+    EXPECT_FALSE(frozen.get_by_key("key500", value));
+}
+
+TEST(FrozenMapTest, MatchesSourceMapForRangesOrderAndExpiry) {
+    SafeMap<int, int> map;
+    for (int i = 0; i < 300; ++i) {
+        // 每三条中有一条很快过期
+        map.insert(i, i * 10, i % 3 == 0 ? 200 : (i % 3 == 1 ? -1 : 600000));
+    }
+    FrozenMap<int, int> frozen;
+    ASSERT_TRUE(map.freeze(frozen));
+
+    auto all = map.get_by_order(INT_MAX);
+    ASSERT_EQ(300u, all.size());
+    expect_same_entries(all, frozen.get_by_order(INT_MAX));
+    expect_same_entries(map.get_by_order(INT_MAX, false), frozen.get_by_order(INT_MAX, false));
+    expect_same_entries(map.get_by_order(17), frozen.get_by_order(17));
+    expect_same_entries(map.get_by_order(17, false), frozen.get_by_order(17, false));
+
+    // 区间两端都包含
+    auto start = all[100].get_insert_time();
+    auto end = all[199].get_insert_time();
+    expect_same_entries(map.get_by_time_range(start, end), frozen.get_by_time_range(start, end));
+    expect_same_entries(map.get_by_time_range(start, end, false), frozen.get_by_time_range(start, end, false));
+    EXPECT_TRUE(frozen.get_by_time_range(end, start).empty());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    auto live = map.get_by_order(INT_MAX);
+    EXPECT_EQ(200u, live.size());
+    expect_same_entries(live, frozen.get_by_order(INT_MAX));
+    expect_same_entries(map.get_by_time_range(start, end), frozen.get_by_time_range(start, end));
+    // 过期的数据仍占用空间, 但不会被读取
+    EXPECT_EQ(300u, frozen.size());
+    int value;
+    EXPECT_FALSE(frozen.get_by_key(0, value));
+    EXPECT_TRUE(frozen.get_by_key(1, value));
+    EXPECT_TRUE(frozen.get_by_key(2, value));
+
+    // 之后对SafeMap的修改不影响FrozenMap
+    map.erase_by_key(1);
+    map.insert(1000, 1);
+    EXPECT_TRUE(frozen.get_by_key(1, value));
+    EXPECT_FALSE(frozen.get_by_key(1000, value));
+}
+
+TEST(FrozenMapTest, LargeMapFindsEveryKey) {
+    // 装载率99%时后放置的桶需要尝试大量种子才能找到空位
+    const int count = 200000;
+    std::vector<KeyValue<int, int>> entries;
+    entries.reserve(count);
+    auto now = Clock::now();
+    for (int i = 0; i < count; ++i) {
+        entries.emplace_back(i * 31 + 5, i, now + std::chrono::microseconds(i), now, -1);
+    }
+    FrozenMap<int, int> frozen;
+    ASSERT_TRUE(frozen.build(entries));
+    EXPECT_EQ(static_cast<size_t>(count), frozen.size());
+
+    int value = -1;
+    for (int i = 0; i < count; ++i) {
+        ASSERT_TRUE(frozen.get_by_key(i * 31 + 5, value)) << "key " << i * 31 + 5;
+        ASSERT_EQ(i, value);
+    }
+    int misses = 0;
+    for (int i = 0; i < count; ++i) {
+        misses += frozen.get_by_key(i * 31 + 6, value) ? 0 : 1;
+    }
+    EXPECT_EQ(count, misses);
+    // 每个key只有Entry、约4字节下标和不到1字节的种子
+    EXPECT_LT(frozen.memory_usage(), count * (sizeof(KeyValue<int, int>) + 8));
+}
+
+TEST(FrozenMapTest, UnbuildableInputKeepsPreviousContents) {
+    auto now = Clock::now();
+    FrozenMap<int, int, CoarseHash> frozen;
+    ASSERT_TRUE(frozen.build({KeyValue<int, int>(0, 1, now, now, -1), KeyValue<int, int>(2, 3, now, now, -1)}));
+
+    // 重复的key
+    EXPECT_FALSE(frozen.build({KeyValue<int, int>(4, 1, now, now, -1), KeyValue<int, int>(4, 2, now, now, -1)}));
+    // 哈希值完全相同的不同key
+    EXPECT_FALSE(frozen.build({KeyValue<int, int>(6, 1, now, now, -1), KeyValue<int, int>(7, 2, now, now, -1)}));
+
+    int value;
+    EXPECT_EQ(2u, frozen.size());
+    ASSERT_TRUE(frozen.get_by_key(2, value));
+    EXPECT_EQ(3, value);
+    EXPECT_FALSE(frozen.get_by_key(6, value));
+}
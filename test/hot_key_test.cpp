@@ -0,0 +1,114 @@
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+TEST(HotKeyTest, DisabledByDefaultAndClearedOnReenable) {
+    SafeMap<int, int> map;
+    map.insert(1, 1);
+    int value;
+    map.get_by_key(1, value);
+    EXPECT_TRUE(map.top_hot_keys(10).empty());
+
+    map.enable_hot_key_tracking(8, 1);
+    map.get_by_key(1, value);
+    ASSERT_EQ(1u, map.top_hot_keys(10).size());
+
+    // 关闭后保留已有的统计, 不再记录
+    map.disable_hot_key_tracking();
+    map.get_by_key(2, value);
+    auto top = map.top_hot_keys(10);
+    ASSERT_EQ(1u, top.size());
+    EXPECT_EQ(1, top[0].key);
+    EXPECT_EQ(1u, top[0].count);
+
+    map.enable_hot_key_tracking();
+    EXPECT_TRUE(map.top_hot_keys(10).empty());
+}
+
+TEST(HotKeyTest, SkewedWorkloadKeepsHeavyHitters) {
+    SafeMap<int, int> map;
+    map.enable_hot_key_tracking(16, 1);
+    int value;
+    // 三个热点key各占总访问次数的1/16以上, 其余2000个key各访问一次, 与热点key交错
+    const int hot_counts[] = {1000, 500, 260};
+    int cold_key = 100;
+    for (int round = 0; round < 1000; ++round) {
+        for (int key = 0; key < 3; ++key) {
+            if (round < hot_counts[key]) {
+                map.get_by_key(key, value);
+            }
+        }
+        map.get_by_key(cold_key++, value);
+        map.get_by_key(cold_key++, value);
+    }
+
+    auto top = map.top_hot_keys(3);
+    ASSERT_EQ(3u, top.size());
+    for (int key = 0; key < 3; ++key) {
+        EXPECT_EQ(key, top[key].key);
+        // 估计值不低于真实次数, 减去误差后不高于真实次数
+        EXPECT_GE(top[key].count, static_cast<uint64_t>(hot_counts[key]));
+        EXPECT_LE(top[key].count - top[key].error, static_cast<uint64_t>(hot_counts[key]));
+    }
+    EXPECT_EQ(16u, map.top_hot_keys(100).size());
+}
+
+TEST(HotKeyTest, SampledConcurrentWorkloadFindsHottestKey) {
+    SafeMap<int, int> map;
+    map.enable_hot_key_tracking(8, 16);
+    const int thread_count = 4;
+    const int accesses = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&map, t] {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<int> dist(0, 9999);
+            int value;
+            for (int i = 0; i < accesses; ++i) {
+                // 一半访问集中在key 7上
+                int sample = dist(rng);
+                map.get_by_key(sample < 5000 ? 7 : 100 + sample, value);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto top = map.top_hot_keys(1);
+    ASSERT_EQ(1u, top.size());
+    EXPECT_EQ(7, top[0].key);
+    // 估计值已按采样率放大, 与真实次数在同一量级
+    uint64_t expected = thread_count * accesses / 2;
+    EXPECT_GT(top[0].count, expected / 2);
+    EXPECT_LT(top[0].count, expected * 2);
+}
+
+TEST(HotKeyTest, InstancesSampleIndependently) {
+    SafeMap<int, int> first;
+    SafeMap<int, int> second;
+    first.enable_hot_key_tracking(8, 2);
+    second.enable_hot_key_tracking(8, 2);
+
+    // 同一线程交替访问两个实例, 每个实例仍然约每两次访问采样一次
+    const uint64_t accesses = 2000;
+    int value;
+    for (uint64_t i = 0; i < accesses; ++i) {
+        first.get_by_key(1, value);
+        second.get_by_key(2, value);
+    }
+    auto top = first.top_hot_keys(1);
+    ASSERT_EQ(1u, top.size());
+    EXPECT_EQ(1, top[0].key);
+    EXPECT_GT(top[0].count, accesses * 3 / 4);
+    EXPECT_LT(top[0].count, accesses * 5 / 4);
+    top = second.top_hot_keys(1);
+    ASSERT_EQ(1u, top.size());
+    EXPECT_EQ(2, top[0].key);
+    EXPECT_GT(top[0].count, accesses * 3 / 4);
+    EXPECT_LT(top[0].count, accesses * 5 / 4);
+}
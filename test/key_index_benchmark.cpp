@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "key_index.h"
+
+/*
+    * @brief KeyIndex与std::unordered_map<K, std::shared_ptr<T>>的对比: 插入、随机查找命中、查找未命中、删除
+    * 稠密key为0..n-1, 稀疏key为随机的64位整数
+    * 用法: key_index_benchmark [条数], 默认100万条
+*/
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Node {
+    explicit Node(int64_t key) : key(key) {}
+
+    int64_t get_key() const {
+        return key;
+    }
+
+    int64_t key;
+};
+
+using NodePtr = std::shared_ptr<Node>;
+
+struct Result {
+    double insert_ms;
+    double find_ms;
+    double miss_ms;
+    double erase_ms;
+    size_t memory;
+};
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// 防止查找被优化掉
+volatile int64_t g_sink;
+
+Result run_key_index(const std::vector<NodePtr>& nodes, const std::vector<int64_t>& lookups, const std::vector<int64_t>& misses) {
+    Result result;
+    KeyIndex<int64_t, Node> index;
+    auto start = Clock::now();
+    for (auto& node : nodes) {
+        index.assign(node);
+    }
+    result.insert_ms = elapsed_ms(start);
+    result.memory = index.memory_usage();
+
+    int64_t sum = 0;
+    start = Clock::now();
+    for (auto key : lookups) {
+        sum += (*index.find(key))->key;
+    }
+    result.find_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    for (auto key : misses) {
+        sum += index.find(key) != nullptr;
+    }
+    result.miss_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    for (auto key : lookups) {
+        sum += index.erase(key);
+    }
+    result.erase_ms = elapsed_ms(start);
+    g_sink = sum;
+    return result;
+}
+
+Result run_unordered_map(const std::vector<NodePtr>& nodes, const std::vector<int64_t>& lookups, const std::vector<int64_t>& misses) {
+    Result result;
+    std::unordered_map<int64_t, NodePtr> map;
+    auto start = Clock::now();
+    for (auto& node : nodes) {
+        map[node->key] = node;
+    }
+    result.insert_ms = elapsed_ms(start);
+    // 每个元素一个链表节点(next指针 + key + shared_ptr + 缓存的哈希值)加上桶数组
+    result.memory = map.size() * (sizeof(void*) + sizeof(std::pair<const int64_t, NodePtr>) + sizeof(size_t))
+        + map.bucket_count() * sizeof(void*);
+
+    int64_t sum = 0;
+    start = Clock::now();
+    for (auto key : lookups) {
+        sum += map.find(key)->second->key;
+    }
+    result.find_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    for (auto key : misses) {
+        sum += map.find(key) != map.end();
+    }
+    result.miss_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    for (auto key : lookups) {
+        sum += map.erase(key);
+    }
+    result.erase_ms = elapsed_ms(start);
+    g_sink = sum;
+    return result;
+}
+
+void print(const char* name, const Result& result) {
+    std::fprintf(stderr, "  %-20s insert %7.1f ms, find %7.1f ms, miss %7.1f ms, erase %7.1f ms, index %6.1f MB\n", name,
+                 result.insert_ms, result.find_ms, result.miss_ms, result.erase_ms, result.memory / 1048576.0);
+}
+
+void compare(const char* title, const std::vector<int64_t>& keys, const std::vector<int64_t>& misses, std::mt19937_64& random) {
+    std::vector<NodePtr> nodes;
+    nodes.reserve(keys.size());
+    for (auto key : keys) {
+        nodes.push_back(std::make_shared<Node>(key));
+    }
+    std::vector<int64_t> lookups = keys;
+    std::shuffle(lookups.begin(), lookups.end(), random);
+
+    std::fprintf(stderr, "%s\n", title);
+    print("KeyIndex", run_key_index(nodes, lookups, misses));
+    print("std::unordered_map", run_unordered_map(nodes, lookups, misses));
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::mt19937_64 random(1);
+    std::fprintf(stderr, "entries: %d\n", count);
+
+    std::vector<int64_t> keys(count);
+    std::vector<int64_t> misses(count);
+    for (int i = 0; i < count; ++i) {
+        keys[i] = i;
+        misses[i] = count + i;
+    }
+    compare("dense keys 0..n-1, inserted in order:", keys, misses, random);
+
+    for (int i = 0; i < count; ++i) {
+        keys[i] = static_cast<int64_t>(random());
+        misses[i] = static_cast<int64_t>(random());
+    }
+    compare("sparse random 64-bit keys:", keys, misses, random);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "key_index.h"
+
+namespace {
+
+template<typename K>
+struct Node {
+    explicit Node(K key) : key(key) {}
+
+    K get_key() const {
+        return key;
+    }
+
+    K key;
+};
+
+// 与KeyIndex::mix相同的打散函数, 用来构造落在指定槽位的哈希值
+size_t mix(size_t hash) {
+    uint64_t value = hash;
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    return static_cast<size_t>(value);
+}
+
+size_t hash_for_slot(size_t slot, size_t capacity) {
+    size_t hash = 0;
+    while ((mix(hash) & (capacity - 1)) != slot) {
+        ++hash;
+    }
+    return hash;
+}
+
+// key的高位选择哈希值, 让多个key落在同一个槽位
+struct SlotHash {
+    size_t operator()(int key) const {
+        return hash_for_slot(key / 100, kKeyIndexMinCapacity);
+    }
+};
+
+template<typename Index, typename K>
+void expect_matches(Index& index, const std::map<K, bool>& model) {
+    EXPECT_EQ(model.size(), index.size());
+    for (auto& item : model) {
+        auto found = index.find(item.first);
+        ASSERT_NE(nullptr, found) << "key " << item.first;
+        EXPECT_EQ(item.first, (*found)->get_key());
+    }
+}
+
+}
+
+TEST(KeyIndexTest, EraseAcrossProbeChainWraparound) {
+    // 最后一个槽位开始的探测链绕回表头: 15 -> 0 -> 1 -> 2, 中间再插入一个以槽位0为起点的key
+    KeyIndex<int, Node<int>, SlotHash, false> index;
+    std::map<int, bool> model;
+    for (int key : {1500, 1501, 1502, 0, 1503}) {
+        index.assign(std::make_shared<Node<int>>(key));
+        model[key] = true;
+    }
+    expect_matches(index, model);
+
+    // 删除表尾的元素, 绕回表头的元素必须前移到表尾, 否则查找会在空槽处提前结束
+    for (int key : {1500, 1502, 0, 1501, 1503}) {
+        EXPECT_TRUE(index.erase(key));
+        EXPECT_FALSE(index.erase(key));
+        EXPECT_EQ(nullptr, index.find(key));
+        model.erase(key);
+        expect_matches(index, model);
+    }
+    EXPECT_TRUE(index.empty());
+}
+
+TEST(KeyIndexTest, HashIndexMatchesModelUnderCollisions) {
+    KeyIndex<int, Node<int>, SlotHash, false> index;
+    std::map<int, bool> model;
+    std::mt19937 random(1);
+    for (int i = 0; i < 20000; ++i) {
+        // 只有4个不同的槽位, 探测链很长且经常绕回
+        int key = static_cast<int>(random() % 4) * 100 + static_cast<int>(random() % 8) + 1200;
+        if (random() % 3 == 0) {
+            EXPECT_EQ(model.erase(key) == 1, index.erase(key));
+        } else {
+            index.assign(std::make_shared<Node<int>>(key));
+            model[key] = true;
+        }
+    }
+    expect_matches(index, model);
+}
+
+TEST(KeyIndexTest, NegativeSignedKeys) {
+    KeyIndex<int, Node<int>, std::hash<int>> index;
+    std::map<int, bool> model;
+    for (int key = -300; key <= 300; ++key) {
+        index.assign(std::make_shared<Node<int>>(key));
+        model[key] = true;
+    }
+    for (int key : {INT_MIN, INT_MIN + 1, INT_MAX, -1000000, 1000000}) {
+        index.assign(std::make_shared<Node<int>>(key));
+        model[key] = true;
+    }
+    expect_matches(index, model);
+    EXPECT_EQ(nullptr, index.find(-301));
+    EXPECT_EQ(nullptr, index.find(301));
+
+    for (int key = -300; key <= 300; key += 3) {
+        EXPECT_TRUE(index.erase(key));
+        model.erase(key);
+    }
+    EXPECT_TRUE(index.erase(INT_MIN));
+    model.erase(INT_MIN);
+    expect_matches(index, model);
+}
+
+TEST(KeyIndexTest, DenseRangeGrowsDownwardAndAbsorbsSparseKeys) {
+    KeyIndex<int64_t, Node<int64_t>, std::hash<int64_t>> index;
+    std::map<int64_t, bool> model;
+    for (int64_t key = 10000; key < 10100; ++key) {
+        index.assign(std::make_shared<Node<int64_t>>(key));
+        model[key] = true;
+    }
+    // 离数组太远, 先放在哈希表中
+    for (int64_t key : {int64_t(8500), int64_t(-5)}) {
+        index.assign(std::make_shared<Node<int64_t>>(key));
+        model[key] = true;
+    }
+    expect_matches(index, model);
+
+    // 从下方逐个插入, 数组向下扩大并逐步覆盖8500, 8500从哈希表移到数组
+    for (int64_t key = 9999; key >= 8000; --key) {
+        index.assign(std::make_shared<Node<int64_t>>(key));
+        model[key] = true;
+    }
+    expect_matches(index, model);
+
+    // 迁移后的key只在数组中, 删除和重新插入不会留下重复
+    EXPECT_TRUE(index.erase(8500));
+    EXPECT_FALSE(index.erase(8500));
+    EXPECT_EQ(nullptr, index.find(8500));
+    index.assign(std::make_shared<Node<int64_t>>(8500));
+    expect_matches(index, model);
+
+    size_t visited = 0;
+    index.for_each([&visited](std::shared_ptr<Node<int64_t>>&) {
+        ++visited;
+    });
+    EXPECT_EQ(model.size(), visited);
+}
+
+TEST(KeyIndexTest, DenseRangeGrowsDownwardThroughNegativeKeys) {
+    KeyIndex<int, Node<int>, std::hash<int>> index;
+    std::map<int, bool> model;
+    for (int key = 0; key >= -5000; --key) {
+        index.assign(std::make_shared<Node<int>>(key));
+        model[key] = true;
+    }
+    expect_matches(index, model);
+
+    // 全部删除后数组重新选择范围
+    for (int key = 0; key >= -5000; --key) {
+        EXPECT_TRUE(index.erase(key));
+    }
+    EXPECT_TRUE(index.empty());
+    index.assign(std::make_shared<Node<int>>(INT_MAX));
+    EXPECT_NE(nullptr, index.find(INT_MAX));
+    EXPECT_EQ(nullptr, index.find(0));
+}
+
+TEST(KeyIndexTest, IntegralIndexMatchesModel) {
+    KeyIndex<int, Node<int>, std::hash<int>> index;
+    std::map<int, bool> model;
+    std::mt19937 random(2);
+    for (int i = 0; i < 50000; ++i) {
+        // 一半落在稠密的小范围内, 一半是分散的正负key
+        int key = random() % 2 == 0 ? static_cast<int>(random() % 2000) - 1000 : static_cast<int>(random());
+        if (random() % 3 == 0) {
+            EXPECT_EQ(model.erase(key) == 1, index.erase(key));
+        } else {
+            index.assign(std::make_shared<Node<int>>(key));
+            model[key] = true;
+        }
+    }
+    expect_matches(index, model);
+}
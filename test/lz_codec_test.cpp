@@ -0,0 +1,163 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "lz_codec.h"
+
+namespace {
+
+std::string compress(const LzCodec& codec, const std::string& input) {
+    std::string out;
+    codec.compress(input.data(), input.size(), out);
+    return out;
+}
+
+void expect_round_trip(const LzCodec& codec, const std::string& input) {
+    std::string compressed = compress(codec, input);
+    std::string output = "stale";
+    ASSERT_TRUE(codec.decompress(compressed.data(), compressed.size(), output));
+    EXPECT_EQ(input, output);
+}
+
+std::string json_sample(int i) {
+    return "{\"user_id\":" + std::to_string(i) + ",\"status\":\"active\",\"region\":\"eu-west-1\",\"tags\":[\"alpha\",\"beta\"]}";
+}
+
+}
+
+TEST(LzCodecTest, RoundTripsEmptyAndShortInput) {
+    LzCodec codec;
+    expect_round_trip(codec, "");
+    expect_round_trip(codec, "a");
+    expect_round_trip(codec, "abc");
+    expect_round_trip(codec, "abcd");
+}
+
+TEST(LzCodecTest, RoundTripsLongLiteralsAndMatches) {
+    LzCodec codec;
+    // 字面量长度跨过15和15+255两档扩展长度
+    std::string literals;
+    for (int i = 0; i < 600; ++i) {
+        literals.push_back(static_cast<char>((i * 131 + i / 7) & 0xff));
+    }
+    expect_round_trip(codec, literals.substr(0, 14));
+    expect_round_trip(codec, literals.substr(0, 15));
+    expect_round_trip(codec, literals.substr(0, 270));
+    expect_round_trip(codec, literals);
+
+    // 匹配长度跨过15+4和15+4+255两档
+    std::string block = literals.substr(0, 300);
+    expect_round_trip(codec, block.substr(0, 19) + "|" + block.substr(0, 19));
+    expect_round_trip(codec, block + "|" + block);
+
+    std::string repeated;
+    for (int i = 0; i < 100; ++i) {
+        repeated += "0123456789";
+    }
+    std::string compressed = compress(codec, repeated);
+    EXPECT_LT(compressed.size(), repeated.size() / 10);
+    expect_round_trip(codec, repeated);
+}
+
+TEST(LzCodecTest, RoundTripsOverlappingMatches) {
+    LzCodec codec;
+    // 距离为1和3的匹配与正在输出的区域重叠
+    std::string run(5000, 'a');
+    std::string compressed = compress(codec, run);
+    EXPECT_LT(compressed.size(), 64u);
+    expect_round_trip(codec, run);
+
+    std::string pattern = "xyz";
+    for (int i = 0; i < 10; ++i) {
+        pattern += pattern.substr(0, 3);
+    }
+    expect_round_trip(codec, "head" + pattern + "tail");
+}
+
+TEST(LzCodecTest, DictionaryMatchesNeedTheSameDictionary) {
+    std::vector<std::string> samples;
+    for (int i = 0; i < 200; ++i) {
+        samples.push_back(json_sample(i));
+    }
+    std::string dictionary = LzCodec::train_dictionary(samples, 1024);
+    ASSERT_FALSE(dictionary.empty());
+    EXPECT_LE(dictionary.size(), 1024u);
+
+    LzCodec plain;
+    LzCodec trained;
+    trained.set_dictionary(dictionary);
+    EXPECT_EQ(dictionary, trained.get_dictionary());
+
+    // 短样本本身几乎没有重复, 只能通过引用字典压缩
+    std::string input = json_sample(12345);
+    std::string with_dict = compress(trained, input);
+    std::string without_dict = compress(plain, input);
+    EXPECT_LT(with_dict.size(), without_dict.size());
+    expect_round_trip(trained, input);
+    expect_round_trip(trained, "");
+    expect_round_trip(trained, input + input);
+
+    // 没有字典时, 引用字典的距离超出已输出的内容
+    std::string output;
+    EXPECT_FALSE(plain.decompress(with_dict.data(), with_dict.size(), output));
+}
+
+TEST(LzCodecTest, TrainDictionaryIsBounded) {
+    std::vector<std::string> samples;
+    for (int i = 0; i < 2000; ++i) {
+        samples.push_back(json_sample(i) + json_sample(i * 7));
+    }
+    EXPECT_LE(LzCodec::train_dictionary(samples, 100).size(), 100u);
+    EXPECT_LE(LzCodec::train_dictionary(samples, 1 << 20).size(), kLzMaxDictionarySize);
+    EXPECT_TRUE(LzCodec::train_dictionary({}, 1024).empty());
+    // 只出现在一个样本中的子串不进入字典
+    EXPECT_TRUE(LzCodec::train_dictionary({"only one sample here"}, 1024).empty());
+}
+
+TEST(LzCodecTest, CorruptOrTruncatedInputFails) {
+    LzCodec codec;
+    std::string input;
+    for (int i = 0; i < 50; ++i) {
+        input += "record " + std::to_string(i % 5) + ";";
+    }
+    std::string compressed = compress(codec, input);
+    std::string output;
+
+    EXPECT_FALSE(codec.decompress(compressed.data(), 0, output));
+    EXPECT_FALSE(codec.decompress(compressed.data(), 3, output));
+    for (size_t size = 4; size < compressed.size(); ++size) {
+        EXPECT_FALSE(codec.decompress(compressed.data(), size, output)) << "truncated to " << size;
+    }
+
+    // 原始长度与内容不符
+    std::string wrong_size = compressed;
+    uint32_t raw_size = static_cast<uint32_t>(input.size() + 1);
+    std::memcpy(&wrong_size[0], &raw_size, 4);
+    EXPECT_FALSE(codec.decompress(wrong_size.data(), wrong_size.size(), output));
+
+    // 原始长度超过压缩数据能展开的上限, 在分配内存前拒绝
+    std::string huge = compressed;
+    raw_size = 0xffffffffu;
+    std::memcpy(&huge[0], &raw_size, 4);
+    EXPECT_FALSE(codec.decompress(huge.data(), huge.size(), output));
+    EXPECT_LT(output.capacity(), size_t(1) << 20);
+
+    // 匹配距离为0或超出已输出的内容
+    std::string bad_offset;
+    raw_size = 8;
+    bad_offset.append(reinterpret_cast<const char*>(&raw_size), 4);
+    bad_offset += std::string("\x10" "a" "\x00\x00", 4);
+    EXPECT_FALSE(codec.decompress(bad_offset.data(), bad_offset.size(), output));
+    bad_offset[6] = 2;
+    EXPECT_FALSE(codec.decompress(bad_offset.data(), bad_offset.size(), output));
+
+    // 扩展长度在数据结尾处中断
+    std::string bad_length;
+    raw_size = 100;
+    bad_length.append(reinterpret_cast<const char*>(&raw_size), 4);
+    bad_length += std::string("\xf0\xff", 2);
+    EXPECT_FALSE(codec.decompress(bad_length.data(), bad_length.size(), output));
+}
@@ -0,0 +1,124 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "read_cache.h"
+#include "safe_map.h"
+
+namespace {
+
+/*
+    * @brief 固定的读线程, 依次执行提交的任务, 线程局部缓存在多次调用之间保留
+*/
+class ReaderThread {
+public:
+    ReaderThread() : _has_task(false), _is_running(true), _thread([this] {
+        while (_is_running) {
+            if (_has_task.load(std::memory_order_acquire)) {
+                _result = _task();
+                _has_task.store(false, std::memory_order_release);
+            }
+            std::this_thread::yield();
+        }
+    }) {}
+
+    ~ReaderThread() {
+        _is_running = false;
+        _thread.join();
+    }
+
+    int run(std::function<int()> task) {
+        _task = std::move(task);
+        _has_task.store(true, std::memory_order_release);
+        while (_has_task.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        return _result;
+    }
+
+private:
+    std::function<int()> _task;
+    int _result;
+    std::atomic<bool> _has_task;
+    std::atomic<bool> _is_running;
+    std::thread _thread;
+};
+
+}
+
+TEST(ReadCacheTest, WriteOnAnotherThreadMakesCachedReadMiss) {
+    ReadCache<int, int> cache;
+    auto map_value = KeyValue<int, int>::create(1, 10, -1);
+    size_t hash = std::hash<int>()(1);
+    ReaderThread reader;
+
+    // 第一次未命中只记录候选, 第二次才填充
+    EXPECT_TRUE(reader.run([&] {
+        int value = 0;
+        bool missed = !cache.get(1, hash, value);
+        cache.fill(1, hash, *map_value);
+        cache.fill(1, hash, *map_value);
+        return missed && cache.get(1, hash, value) && value == 10;
+    }));
+
+    // 另一个线程(当前线程)写入后, 读线程的缓存不再命中
+    cache.invalidate(1);
+    EXPECT_TRUE(reader.run([&] {
+        int value = 0;
+        return !cache.get(1, hash, value);
+    }));
+
+    // 其他分片的写入不影响已缓存的数据
+    EXPECT_TRUE(reader.run([&] {
+        cache.fill(1, hash, *map_value);
+        return true;
+    }));
+    cache.invalidate(2);
+    EXPECT_TRUE(reader.run([&] {
+        int value = 0;
+        return cache.get(1, hash, value) && value == 10;
+    }));
+
+    cache.invalidate_all();
+    EXPECT_TRUE(reader.run([&] {
+        int value = 0;
+        return !cache.get(1, hash, value);
+    }));
+}
+
+TEST(ReadCacheTest, MapReadsSeeWritesFromOtherThreads) {
+    SafeMap<int, int> map;
+    map.enable_read_cache();
+    map.insert(1, 10);
+    ReaderThread reader;
+
+    auto read = [&map, &reader](int key) {
+        return reader.run([&map, key] {
+            int value = 0;
+            return map.get_by_key(key, value) ? value : -1;
+        });
+    };
+    // 读几次使key进入读线程的缓存
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(10, read(1));
+    }
+
+    ASSERT_TRUE(map.update_value(1, 11));
+    EXPECT_EQ(11, read(1));
+    EXPECT_EQ(11, read(1));
+
+    ASSERT_TRUE(map.erase_by_key(1));
+    EXPECT_EQ(-1, read(1));
+
+    ASSERT_TRUE(map.insert(1, 12));
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(12, read(1));
+    }
+    // 修改过期时间也使缓存失效
+    ASSERT_EQ(1, map.set_ttl_batch({1}, 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(-1, read(1));
+}
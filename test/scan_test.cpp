@@ -0,0 +1,288 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+/*
+    * @brief 在后台线程中执行func, 期限内没有返回视为死锁
+    * @return 期限内返回true; 否则分离线程并返回false
+*/
+template<typename Func>
+bool finishes_in_time(Func func) {
+    std::atomic<bool> done(false);
+    std::thread thread([&func, &done] {
+        func();
+        done = true;
+    });
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!done && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!done) {
+        thread.detach();
+        return false;
+    }
+    thread.join();
+    return true;
+}
+
+}
+
+TEST(ScanTest, ScanWorkersCanOnlyBeSetBeforeThePoolExists) {
+    SafeMap<int, int> map;
+    EXPECT_FALSE(map.set_scan_workers(0));
+    EXPECT_FALSE(map.set_scan_workers(-1));
+    ASSERT_TRUE(map.set_scan_workers(4));
+    EXPECT_TRUE(map.set_scan_workers(2));
+    map.insert(1, 1);
+    EXPECT_EQ(1, map.count_if([](int, int) {
+        return true;
+    }));
+    EXPECT_FALSE(map.set_scan_workers(4));
+}
+
+TEST(ScanTest, EmptyMap) {
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.set_scan_workers(4));
+    int calls = 0;
+    auto pred = [&calls](int, int) {
+        ++calls;
+        return true;
+    };
+    EXPECT_EQ(0, map.count_if(pred));
+    EXPECT_EQ(0, map.erase_if(pred));
+    EXPECT_EQ(0, calls);
+}
+
+TEST(ScanTest, MapSmallerThanOneChunk) {
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.set_scan_workers(4));
+    for (int i = 0; i < 100; ++i) {
+        map.insert(i, i);
+    }
+    auto even = [](int key, int) {
+        return key % 2 == 0;
+    };
+    EXPECT_EQ(50, map.count_if(even));
+    EXPECT_EQ(50, map.erase_if(even));
+    EXPECT_EQ(0, map.count_if(even));
+    EXPECT_EQ(50, map.count_if([](int, int) {
+        return true;
+    }));
+    int value;
+    EXPECT_FALSE(map.get_by_key(0, value));
+    EXPECT_TRUE(map.get_by_key(1, value));
+}
+
+TEST(ScanTest, ParallelScanVisitsEveryEntryOnce) {
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.set_scan_workers(4));
+    const int count = kScanChunkSize * 6 + 17;
+    for (int i = 0; i < count; ++i) {
+        map.insert(i, i, i % 10 == 0 ? 1 : -1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // 已过期的数据不参与扫描
+    std::mutex mutex;
+    std::vector<int> visits(count, 0);
+    std::set<std::thread::id> threads;
+    int matched = map.count_if([&](int key, int value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++visits[key];
+        threads.insert(std::this_thread::get_id());
+        // 让其他线程有机会取到批次
+        if (key % kScanChunkSize == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return value % 3 == 0;
+    });
+    int expected = 0;
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(i % 10 == 0 ? 0 : 1, visits[i]) << "key " << i;
+        expected += i % 10 != 0 && i % 3 == 0 ? 1 : 0;
+    }
+    EXPECT_EQ(expected, matched);
+    EXPECT_GE(threads.size(), 1u);
+    EXPECT_LE(threads.size(), 4u);
+
+    EXPECT_EQ(expected, map.erase_if([](int, int value) {
+        return value % 3 == 0;
+    }));
+    EXPECT_EQ(0, map.count_if([](int, int value) {
+        return value % 3 == 0;
+    }));
+}
+
+TEST(ScanTest, EntriesInsertedDuringScanAreNotVisited) {
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.set_scan_workers(4));
+    const int count = kScanChunkSize * 3;
+    for (int i = 0; i < count; ++i) {
+        map.insert(i, i);
+    }
+    std::atomic<int> next(count);
+    int matched = map.count_if([&map, &next](int key, int) {
+        if (key % 100 == 0) {
+            map.insert(next++, 0);
+        }
+        return true;
+    });
+    EXPECT_EQ(count, matched);
+}
+
+TEST(ScanTest, PredicateCanScanTheSameMap) {
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.set_scan_workers(4));
+    const int count = kScanChunkSize * 8;
+    for (int i = 0; i < count; ++i) {
+        map.insert(i, i);
+    }
+
+    // 每一批中都有pred在池中的线程上嵌套扫描同一个map, 池中的线程可能全部在嵌套扫描中
+    std::atomic<int> nested_mismatches(0);
+    int matched = 0;
+    ASSERT_TRUE(finishes_in_time([&] {
+        matched = map.count_if([&map, &nested_mismatches, count](int key, int) {
+            if (key % kScanChunkSize == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                int total = map.count_if([](int, int) {
+                    return true;
+                });
+                if (total != count) {
+                    ++nested_mismatches;
+                }
+            }
+            return true;
+        });
+    }));
+    EXPECT_EQ(count, matched);
+    EXPECT_EQ(0, nested_mismatches.load());
+
+    // pred中删除其他数据
+    int erased = 0;
+    ASSERT_TRUE(finishes_in_time([&] {
+        erased = map.erase_if([&map](int key, int) {
+            if (key % kScanChunkSize == 1) {
+                map.erase_if([key](int other, int) {
+                    return other == key + 1;
+                });
+            }
+            return false;
+        });
+    }));
+    EXPECT_EQ(0, erased);
+    EXPECT_EQ(count - 8, map.count_if([](int, int) {
+        return true;
+    }));
+}
+
+TEST(ScanTest, PoolThreadScansOtherMapInParallel) {
+    SafeMap<int, int> outer;
+    SafeMap<int, int> inner;
+    ASSERT_TRUE(outer.set_scan_workers(2));
+    ASSERT_TRUE(inner.set_scan_workers(4));
+    for (int i = 0; i < kScanChunkSize * 4; ++i) {
+        outer.insert(i, i);
+        inner.insert(i, i);
+    }
+
+    // outer池中的线程上嵌套扫描inner, inner的池仍然参与扫描
+    std::thread::id caller = std::this_thread::get_id();
+    std::mutex mutex;
+    std::set<std::thread::id> inner_threads;
+    bool nested_on_pool = false;
+    outer.count_if([&](int key, int) {
+        if (key % kScanChunkSize != 0) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (std::this_thread::get_id() == caller) {
+            return true;
+        }
+        std::set<std::thread::id> threads;
+        int total = inner.count_if([&](int inner_key, int) {
+            if (inner_key % kScanChunkSize == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+            return true;
+        });
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(kScanChunkSize * 4, total);
+        nested_on_pool = true;
+        inner_threads.insert(threads.begin(), threads.end());
+        return true;
+    });
+    ASSERT_TRUE(nested_on_pool);
+    EXPECT_GE(inner_threads.size(), 2u);
+}
+
+TEST(ScanTest, MapsScanningEachOtherFinish) {
+    SafeMap<int, int> first;
+    SafeMap<int, int> second;
+    ASSERT_TRUE(first.set_scan_workers(3));
+    ASSERT_TRUE(second.set_scan_workers(3));
+    const int count = kScanChunkSize * 6;
+    for (int i = 0; i < count; ++i) {
+        first.insert(i, i);
+        second.insert(i, i);
+    }
+
+    // 两个map的pred互相嵌套扫描, 两个池中的线程可能都在等待对方池中的任务
+    auto nested = [count](SafeMap<int, int>& map, SafeMap<int, int>& other, std::atomic<int>& mismatches) {
+        return map.count_if([&other, &mismatches, count](int key, int) {
+            if (key % kScanChunkSize == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                int total = other.count_if([](int, int) {
+                    return true;
+                });
+                if (total != count) {
+                    ++mismatches;
+                }
+            }
+            return true;
+        });
+    };
+    std::atomic<int> mismatches(0);
+    int first_total = 0;
+    int second_total = 0;
+    ASSERT_TRUE(finishes_in_time([&] {
+        std::thread thread([&] {
+            second_total = nested(second, first, mismatches);
+        });
+        first_total = nested(first, second, mismatches);
+        thread.join();
+    }));
+    EXPECT_EQ(count, first_total);
+    EXPECT_EQ(count, second_total);
+    EXPECT_EQ(0, mismatches.load());
+}
+
+TEST(ScanTest, PredicateExceptionPropagates) {
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.set_scan_workers(4));
+    for (int i = 0; i < kScanChunkSize * 6; ++i) {
+        map.insert(i, i);
+    }
+    EXPECT_THROW(map.count_if([](int key, int) {
+        if (key == kScanChunkSize * 3) {
+            throw std::runtime_error("pred");
+        }
+        return true;
+    }), std::runtime_error);
+    // 抛出异常后仍然可以继续扫描
+    EXPECT_EQ(kScanChunkSize * 6, map.count_if([](int, int) {
+        return true;
+    }));
+}
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "safe_map.h"
+#include "shared_safe_map.h"
+
+/*
+    * @brief 跨进程读吞吐的基准测试: 多个进程通过SharedSafeMap读同一份数据, 与进程内多个线程读SafeMap对比
+    * 用法: shared_map_benchmark [条数] [每轮秒数], 默认100万条, 每轮1秒, 读者个数为1/2/4/8
+*/
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 在deadline之前随机读取, 返回读取次数
+template<typename Map>
+long read_until(Map& map, int count, Clock::time_point deadline, unsigned seed) {
+    std::mt19937 random(seed);
+    long reads = 0;
+    long value;
+    while (Clock::now() < deadline) {
+        for (int i = 0; i < 1024; ++i) {
+            map.get_by_key(static_cast<int>(random() % count), value);
+        }
+        reads += 1024;
+    }
+    return reads;
+}
+
+double shared_reads_per_second(const std::string& name, int count, int readers, int seconds) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return 0;
+    }
+    auto deadline = Clock::now() + std::chrono::seconds(seconds);
+    std::vector<pid_t> pids;
+    for (int i = 0; i < readers; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            SharedSafeMap<int, long> map;
+            long reads = map.open(name) ? read_until(map, count, deadline, i) : 0;
+            ssize_t written = write(fds[1], &reads, sizeof(reads));
+            _exit(written == sizeof(reads) ? 0 : 1);
+        }
+        pids.push_back(pid);
+    }
+    long total = 0;
+    for (pid_t pid : pids) {
+        long reads = 0;
+        if (read(fds[0], &reads, sizeof(reads)) == sizeof(reads)) {
+            total += reads;
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return static_cast<double>(total) / seconds;
+}
+
+double local_reads_per_second(SafeMap<int, long>& map, int count, int readers, int seconds) {
+    auto deadline = Clock::now() + std::chrono::seconds(seconds);
+    std::atomic<long> total(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; ++i) {
+        threads.emplace_back([&map, &total, count, deadline, i] {
+            total += read_until(map, count, deadline, i);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(total.load()) / seconds;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 1;
+    std::string name = "/shared_map_benchmark";
+
+    SharedSafeMap<int, long> shared;
+    if (!shared.create(name, count)) {
+        std::fprintf(stderr, "create shared memory failed\n");
+        return 1;
+    }
+    SafeMap<int, long> local;
+    for (int i = 0; i < count; ++i) {
+        shared.insert(i, i);
+        local.insert(i, i);
+    }
+
+    std::fprintf(stderr, "entries: %d, cores: %u\n", count, std::thread::hardware_concurrency());
+    for (int readers : {1, 2, 4, 8}) {
+        double shared_rate = shared_reads_per_second(name, count, readers, seconds);
+        double local_rate = local_reads_per_second(local, count, readers, seconds);
+        std::fprintf(stderr, "readers %d: SharedSafeMap %.2fM reads/s (processes), SafeMap %.2fM reads/s (threads)\n", readers,
+                     shared_rate / 1e6, local_rate / 1e6);
+    }
+    SharedSafeMap<int, long>::remove(name);
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <climits>
+#include <cstdio>
+#include <csignal>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "shared_safe_map.h"
+
+namespace {
+
+// 校验时间链表和哈希索引一致: key不重复, 每条数据都能通过get_by_key找到, size与链表长度相同
+template<typename V>
+void expect_consistent(SharedSafeMap<int, V>& map) {
+    auto entries = map.get_by_order(INT_MAX);
+    std::set<int> keys;
+    for (auto& entry : entries) {
+        EXPECT_TRUE(keys.insert(entry.get_key()).second) << "duplicate key " << entry.get_key();
+        V value;
+        EXPECT_TRUE(map.get_by_key(entry.get_key(), value));
+        EXPECT_TRUE(value == entry.get_value());
+    }
+    EXPECT_EQ(entries.size(), map.size());
+}
+
+// 占满一个页面的值, 每个节点跨两个页面, 系统崩溃时节点的各个字段可能分别来自新旧两个版本
+struct PageValue {
+    long key;
+    long padding[511];
+
+    bool operator==(const PageValue& other) const {
+        return key == other.key;
+    }
+};
+
+PageValue page_value(long key) {
+    PageValue value = {};
+    value.key = key;
+    return value;
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+}
+
+}
+
+TEST(SharedSafeMapTest, SharedAcrossProcesses) {
+    std::string name = "/shared_safe_map_test_share";
+    SharedSafeMap<int, long> map;
+    ASSERT_TRUE(map.create(name, 128));
+    ASSERT_TRUE(map.insert(1, 1));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        SharedSafeMap<int, long> child;
+        long value = 0;
+        bool ok = child.open(name) && child.get_by_key(1, value) && value == 1 && child.insert(2, 2);
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    long value = 0;
+    EXPECT_TRUE(map.get_by_key(2, value));
+    EXPECT_EQ(2, value);
+    SharedSafeMap<int, long>::remove(name);
+}
+
+TEST(SharedSafeMapTest, RepairsAfterOwnerDiesHoldingLock) {
+    std::string name = "/shared_safe_map_test_dead_owner";
+    SharedSafeMap<int, long> map;
+    ASSERT_TRUE(map.create(name, 64));
+
+    std::mt19937 random(1);
+    for (int round = 0; round < 100; ++round) {
+        // 子进程不停地插入和删除, 在随机时刻被杀死, 大概率正持有锁且修改只完成了一部分
+        pid_t pid = fork();
+        if (pid == 0) {
+            SharedSafeMap<int, long> child;
+            child.open(name);
+            std::mt19937 child_random(round);
+            while (true) {
+                int key = child_random() % 200;
+                if (child_random() % 2 == 0) {
+                    child.insert(key, key);
+                } else {
+                    child.erase_by_key(key);
+                }
+            }
+        }
+        usleep(200 + random() % 2000);
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+
+        // 修复前在损坏的桶链上查找会死循环
+        alarm(10);
+        for (int i = 0; i < 50; ++i) {
+            int key = random() % 200;
+            map.insert(key, key);
+            map.erase_by_key((key + 7) % 200);
+        }
+        expect_consistent(map);
+        alarm(0);
+    }
+    SharedSafeMap<int, long>::remove(name);
+}
+
+TEST(SharedSafeMapTest, TornPagesAreRejectedOrConsistent) {
+    std::string path = ::testing::TempDir() + "shared_safe_map_torn.dat";
+    std::string torn_path = ::testing::TempDir() + "shared_safe_map_torn_copy.dat";
+
+    // checkpoint时链表为A X B C, 之后删除X并插入D, D复用X的节点
+    std::string old_file;
+    std::string new_file;
+    {
+        SharedSafeMap<int, PageValue> map;
+        ASSERT_TRUE(map.create_file(path, 8));
+        for (int key : {1, 2, 3, 4}) {
+            ASSERT_TRUE(map.insert(key, page_value(key)));
+        }
+        ASSERT_TRUE(map.checkpoint());
+        old_file = read_file(path);
+        ASSERT_TRUE(map.erase_by_key(2));
+        ASSERT_TRUE(map.insert(5, page_value(5)));
+        new_file = read_file(path);
+    }
+    ASSERT_EQ(old_file.size(), new_file.size());
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    std::vector<size_t> changed_pages;
+    for (size_t offset = page_size; offset < new_file.size(); offset += page_size) {
+        if (old_file.compare(offset, page_size, new_file, offset, page_size) != 0) {
+            changed_pages.push_back(offset);
+        }
+    }
+    ASSERT_GE(changed_pages.size(), 3u);
+    ASSERT_LE(changed_pages.size(), 16u);
+
+    // 页面0(头部和桶)总是用新版本: dirty在第一次修改前已同步写入, 头部其余字段和桶都由repair重建
+    std::set<std::set<int>> valid = {{1, 2, 3, 4}, {1, 3, 4}, {1, 3, 4, 5}};
+    int opened = 0;
+    for (size_t mask = 0; mask < (1u << changed_pages.size()); ++mask) {
+        std::string torn = old_file;
+        torn.replace(0, page_size, new_file, 0, page_size);
+        for (size_t i = 0; i < changed_pages.size(); ++i) {
+            if (mask & (1u << i)) {
+                torn.replace(changed_pages[i], page_size, new_file, changed_pages[i], page_size);
+            }
+        }
+        write_file(torn_path, torn);
+
+        SharedSafeMap<int, PageValue> map;
+        if (!map.open_file(torn_path)) {
+            continue;
+        }
+        ++opened;
+        std::set<int> keys;
+        for (auto& entry : map.get_by_order(INT_MAX)) {
+            keys.insert(entry.get_key());
+        }
+        EXPECT_TRUE(valid.count(keys) == 1) << "pages mask " << mask << " silently lost entries";
+        expect_consistent(map);
+    }
+    // 全部是旧页面或全部是新页面时都能打开
+    EXPECT_GE(opened, 2);
+    std::remove(path.c_str());
+    std::remove(torn_path.c_str());
+}
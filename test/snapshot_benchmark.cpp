@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "safe_map.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double percentile_us(std::vector<double>& samples, double percent) {
+    if (samples.empty()) {
+        return 0;
+    }
+    size_t index = std::min(samples.size() - 1, static_cast<size_t>(samples.size() * percent / 100));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+/*
+    * @brief 当前进程的常驻内存, 单位MB, fork()复制的页表与它成正比
+*/
+long resident_mb() {
+    std::ifstream status("/proc/self/status");
+    std::string name;
+    long kb = 0;
+    while (status >> name) {
+        if (name == "VmRSS:") {
+            status >> kb;
+            break;
+        }
+    }
+    return kb / 1024;
+}
+
+/*
+    * @brief 写线程持续update_value()时保存后台快照
+    * @param rss_mb fork()时的常驻内存
+    * @param fork_ms save_snapshot_background()的耗时, 主要是fork()复制页表, 期间map被锁住
+    * @param idle_p99_us 快照前写线程的p99延迟
+    * @param busy_p99_us 子进程写快照期间写线程的p99延迟
+    * @return 后台快照成功返回true
+*/
+bool measure_background(SafeMap<int, int>& map, int count, const std::string& path, long& rss_mb, double& fork_ms, double& idle_p99_us, double& busy_p99_us) {
+    std::atomic<int> phase(0);
+    std::vector<double> samples[2];
+    std::thread writer([&map, &phase, &samples, count] {
+        for (int i = 0; phase < 2; ++i) {
+            int current = phase;
+            auto start = Clock::now();
+            map.update_value(i % count, i);
+            samples[current].push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    phase = 1;
+    rss_mb = resident_mb();
+    auto start = Clock::now();
+    bool ok = map.save_snapshot_background(path);
+    fork_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    ok = ok && map.wait_snapshot_background();
+    phase = 2;
+    writer.join();
+
+    idle_p99_us = percentile_us(samples[0], 99);
+    busy_p99_us = percentile_us(samples[1], 99);
+    return ok;
+}
+
+}
+
+/*
+    * @brief 快照的基准测试: 逐条insert()构建 vs load_snapshot()批量构建, 以及后台快照的fork()耗时和对写线程延迟的影响
+    * 用法: snapshot_benchmark [条数] [快照路径], 默认1000万条, 一半数据带过期时间
+*/
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 10000000;
+    std::string path = argc > 2 ? argv[2] : "snapshot_benchmark.snap";
+
+    double insert_ms;
+    double save_ms;
+    long rss_mb;
+    double fork_ms;
+    double idle_p99_us;
+    double busy_p99_us;
+    {
+        SafeMap<int, int> map;
+        auto start = Clock::now();
+        for (int i = 0; i < count; ++i) {
+            map.insert(i, i, i % 2 == 0 ? -1 : 3600 * 1000);
+        }
+        insert_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        if (!map.save_snapshot(path)) {
+            std::fprintf(stderr, "save_snapshot failed\n");
+            return 1;
+        }
+        save_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        if (!measure_background(map, count, path, rss_mb, fork_ms, idle_p99_us, busy_p99_us)) {
+            std::fprintf(stderr, "save_snapshot_background failed\n");
+            return 1;
+        }
+    }
+
+    double load_ms;
+    {
+        SafeMap<int, int> map;
+        auto start = Clock::now();
+        if (!map.load_snapshot(path)) {
+            std::fprintf(stderr, "load_snapshot failed\n");
+            return 1;
+        }
+        load_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    std::remove(path.c_str());
+
+    std::fprintf(stderr, "entries: %d\n", count);
+    std::fprintf(stderr, "insert() one by one: %.0f ms\n", insert_ms);
+    std::fprintf(stderr, "save_snapshot:       %.0f ms\n", save_ms);
+    std::fprintf(stderr, "load_snapshot:       %.0f ms\n", load_ms);
+    std::fprintf(stderr, "background fork:     %.1f ms at %ld MB RSS\n", fork_ms, rss_mb);
+    std::fprintf(stderr, "writer p99:          %.1f us idle, %.1f us while the child writes\n", idle_p99_us, busy_p99_us);
+    return 0;
+}
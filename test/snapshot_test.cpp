@@ -0,0 +1,204 @@
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+#include "value_interner.h"
+#include "worker_pool.h"
+
+namespace {
+
+std::string temp_path(const std::string& name) {
+    return ::testing::TempDir() + name;
+}
+
+template<typename K, typename V>
+void expect_same_entries(const std::vector<KeyValue<K, V>>& expected, const std::vector<KeyValue<K, V>>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].get_key(), actual[i].get_key());
+        EXPECT_EQ(expected[i].get_value(), actual[i].get_value());
+        EXPECT_EQ(expected[i].get_insert_time(), actual[i].get_insert_time());
+        EXPECT_EQ(expected[i].get_expire_time_interval(), actual[i].get_expire_time_interval());
+        if (expected[i].get_expire_time_interval() != -1) {
+            EXPECT_EQ(expected[i].get_expire_time(), actual[i].get_expire_time());
+        }
+    }
+}
+
+}
+
+TEST(SnapshotTest, RoundTripKeepsEntriesAndTimestamps) {
+    std::string path = temp_path("snapshot_round_trip.snap");
+    std::vector<KeyValue<std::string, std::string>> expected;
+    {
+        SafeMap<std::string, std::string> map;
+        for (int i = 0; i < 1000; ++i) {
+            // 一部分永不过期, 一部分带过期时间
+            map.insert("key" + std::to_string(i), std::string(i % 50, 'v') + std::to_string(i), i % 3 == 0 ? -1 : 600000);
+        }
+        map.insert("short", "expired", 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        expected = map.get_by_order(INT_MAX);
+        ASSERT_TRUE(map.save_snapshot(path));
+    }
+
+    SafeMap<std::string, std::string> loaded;
+    loaded.insert("stale", "replaced by load");
+    ASSERT_TRUE(loaded.load_snapshot(path));
+    expect_same_entries(expected, loaded.get_by_order(INT_MAX));
+
+    std::string value;
+    EXPECT_FALSE(loaded.get_by_key("short", value));
+    EXPECT_FALSE(loaded.get_by_key("stale", value));
+    ASSERT_TRUE(loaded.get_by_key("key7", value));
+    EXPECT_EQ(std::string(7, 'v') + "7", value);
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, LoadedMapAcceptsWritesInOrder) {
+    std::string path = temp_path("snapshot_writes.snap");
+    {
+        SafeMap<int, int> map;
+        for (int i = 0; i < 100; ++i) {
+            map.insert(i, i * 2);
+        }
+        ASSERT_TRUE(map.save_snapshot(path));
+    }
+
+    SafeMap<int, int> loaded;
+    ASSERT_TRUE(loaded.load_snapshot(path));
+    EXPECT_TRUE(loaded.insert(100, 200));
+    EXPECT_FALSE(loaded.insert(5, 0));
+    EXPECT_TRUE(loaded.erase_by_key(6));
+
+    auto entries = loaded.get_by_order(INT_MAX);
+    ASSERT_EQ(100u, entries.size());
+    for (size_t i = 1; i < entries.size(); ++i) {
+        EXPECT_LE(entries[i - 1].get_insert_time(), entries[i].get_insert_time());
+    }
+    EXPECT_EQ(100, entries.back().get_key());
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, MissingOrCorruptFileFails) {
+    SafeMap<int, int> map;
+    EXPECT_FALSE(map.load_snapshot(temp_path("snapshot_missing.snap")));
+
+    std::string path = temp_path("snapshot_corrupt.snap");
+    FILE* file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    std::fputs("not a snapshot", file);
+    std::fclose(file);
+    EXPECT_FALSE(map.load_snapshot(path));
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, CorruptEntryCountFails) {
+    // 整数key的索引不预留空间, 使用字符串key
+    std::string path = temp_path("snapshot_entry_count.snap");
+    {
+        SafeMap<std::string, int> map;
+        for (int i = 0; i < 10; ++i) {
+            map.insert(std::to_string(i), i);
+        }
+        ASSERT_TRUE(map.save_snapshot(path));
+    }
+
+    // 文件头中magic和version之后是entry_count, 改成远超文件内容的条数
+    const uint64_t entry_counts[] = {UINT64_MAX, UINT64_MAX / 4, 1ull << 40};
+    for (uint64_t entry_count : entry_counts) {
+        FILE* file = std::fopen(path.c_str(), "r+b");
+        ASSERT_NE(nullptr, file);
+        ASSERT_EQ(0, std::fseek(file, sizeof(uint32_t) * 2, SEEK_SET));
+        ASSERT_EQ(1u, std::fwrite(&entry_count, sizeof(entry_count), 1, file));
+        std::fclose(file);
+
+        SafeMap<std::string, int> map;
+        map.insert("old", 1);
+        EXPECT_FALSE(map.load_snapshot(path)) << entry_count;
+        // 加载失败不影响原有数据
+        int value;
+        EXPECT_TRUE(map.get_by_key("old", value));
+        EXPECT_EQ(1u, map.get_by_order(INT_MAX).size());
+    }
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, BackgroundSnapshotWhileWorkerPoolAndInternerAreBusy) {
+    std::string path = temp_path("snapshot_fork_busy.snap");
+    std::string cold_path = temp_path("snapshot_fork_busy.cold");
+    SafeMap<int, Interned<std::string>> map;
+    ASSERT_TRUE(map.enable_cold_tier(cold_path, 0));
+    const int count = 2000;
+    for (int i = 0; i < count; ++i) {
+        map.insert(i, Interned<std::string>("value" + std::to_string(i % 100)));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    // tick线程也在同时转移, 以统计为准
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (map.get_cold_tier_stats().spilled_count < static_cast<uint64_t>(count) && std::chrono::steady_clock::now() < deadline) {
+        map.spill_cold();
+        std::this_thread::yield();
+    }
+    // 子进程写快照时要从冷存储解码, 解码时重新驻留每个值
+    ASSERT_EQ(static_cast<uint64_t>(count), map.get_cold_tier_stats().spilled_count);
+
+    // 池中的线程不停地驻留和释放值, 另一个线程不停地提交任务, fork时驻留表的分片锁和池的锁随时可能被其他线程持有
+    std::atomic<bool> stop(false);
+    WorkerPool pool(2);
+    std::thread submitter([&pool, &stop] {
+        for (int round = 0; !stop; ++round) {
+            pool.submit([round] {
+                for (int i = 0; i < 100; ++i) {
+                    Interned<std::string> value("value" + std::to_string((round + i) % 100));
+                    Interned<std::string> unique("busy" + std::to_string(round * 100 + i));
+                }
+            }).get();
+        }
+    });
+    std::thread scanner([&map, &stop] {
+        while (!stop) {
+            map.count_if([](int, const Interned<std::string>& value) {
+                return value.get().size() > 6;
+            });
+        }
+    });
+
+    // 子进程在fork时被其他线程持有的锁上死锁时由alarm结束, wait_snapshot_background返回false
+    static bool registered = false;
+    if (!registered) {
+        pthread_atfork(nullptr, nullptr, [] {
+            alarm(30);
+        });
+        registered = true;
+    }
+    bool saved = true;
+    for (int round = 0; saved && round < 50; ++round) {
+        saved = map.save_snapshot_background(path) && map.wait_snapshot_background();
+    }
+    stop = true;
+    submitter.join();
+    scanner.join();
+    ASSERT_TRUE(saved);
+
+    SafeMap<int, Interned<std::string>> loaded;
+    ASSERT_TRUE(loaded.load_snapshot(path));
+    EXPECT_EQ(static_cast<size_t>(count), loaded.get_by_order(INT_MAX).size());
+    for (int i = 0; i < count; ++i) {
+        Interned<std::string> value;
+        ASSERT_TRUE(loaded.get_by_key(i, value));
+        EXPECT_EQ("value" + std::to_string(i % 100), value.get());
+    }
+    std::remove(path.c_str());
+    std::remove(cold_path.c_str());
+}
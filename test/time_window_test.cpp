@@ -0,0 +1,224 @@
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+/*
+    * @brief 一个已关闭窗口的副本
+*/
+template<typename K, typename V>
+struct Window {
+    TimeStamp start;
+    TimeStamp end;
+    std::vector<KeyValue<K, V>> entries;
+};
+
+/*
+    * @brief 收集窗口回调, 回调在tick线程中执行
+*/
+template<typename K, typename V>
+class WindowCollector {
+public:
+    typename TimeWindow<K, V>::Callback callback() {
+        return [this](const TimeStamp& start, const TimeStamp& end, std::vector<KeyValue<K, V>>& entries) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _windows.push_back(Window<K, V>{start, end, entries});
+            _cv.notify_all();
+        };
+    }
+
+    /*
+        * @brief 等待结束时间晚于time的窗口关闭
+        * @return 期限内等到返回true
+    */
+    bool wait_past(const TimeStamp& time) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _cv.wait_for(lock, std::chrono::seconds(2), [this, &time] {
+            return !_windows.empty() && _windows.back().end > time;
+        });
+    }
+
+    std::vector<Window<K, V>> windows() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _windows;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<Window<K, V>> _windows;
+};
+
+/*
+    * @brief 检查窗口按起点递增、大小和步长正确、起点对齐, 且窗口内的数据都在[start, end)内并按insert_time排列
+*/
+template<typename K, typename V>
+void expect_well_formed(const std::vector<Window<K, V>>& windows, int size_ms, int hop_ms) {
+    for (size_t i = 0; i < windows.size(); ++i) {
+        auto& window = windows[i];
+        EXPECT_EQ(std::chrono::milliseconds(size_ms), window.end - window.start);
+        EXPECT_EQ(0, (window.start.time_since_epoch() % std::chrono::milliseconds(hop_ms)).count());
+        if (i > 0) {
+            EXPECT_EQ(std::chrono::milliseconds(hop_ms), window.start - windows[i - 1].start);
+        }
+        for (size_t j = 0; j < window.entries.size(); ++j) {
+            EXPECT_LE(window.start, window.entries[j].get_insert_time());
+            EXPECT_LT(window.entries[j].get_insert_time(), window.end);
+            if (j > 0) {
+                EXPECT_LE(window.entries[j - 1].get_insert_time(), window.entries[j].get_insert_time());
+            }
+        }
+    }
+}
+
+}
+
+TEST(TimeWindowTest, RejectsInvalidSizes) {
+    SafeMap<int, int> map;
+    WindowCollector<int, int> collector;
+    EXPECT_EQ(-1, map.add_time_window(0, 10, collector.callback()));
+    EXPECT_EQ(-1, map.add_time_window(10, 0, collector.callback()));
+    EXPECT_EQ(-1, map.add_time_window(-10, -10, collector.callback()));
+    EXPECT_FALSE(map.remove_time_window(0));
+}
+
+TEST(TimeWindowTest, TumblingWindowsEmitEachEntryOnceInOrder) {
+    SafeMap<int, int> map;
+    WindowCollector<int, int> collector;
+    ASSERT_NE(-1, map.add_time_window(30, 30, collector.callback()));
+
+    for (int i = 0; i < 20; ++i) {
+        map.insert(i, i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_TRUE(collector.wait_past(map.get_by_order(1, false)[0].get_insert_time()));
+
+    auto windows = collector.windows();
+    expect_well_formed(windows, 30, 30);
+    std::map<int, int> seen;
+    int previous = -1;
+    for (auto& window : windows) {
+        for (auto& entry : window.entries) {
+            ++seen[entry.get_key()];
+            // 跨窗口也按插入顺序发出
+            EXPECT_LT(previous, entry.get_key());
+            previous = entry.get_key();
+        }
+    }
+    ASSERT_EQ(20u, seen.size());
+    for (auto& item : seen) {
+        EXPECT_EQ(1, item.second) << "key " << item.first;
+    }
+}
+
+TEST(TimeWindowTest, SlidingWindowsOverlap) {
+    SafeMap<int, int> map;
+    WindowCollector<int, int> collector;
+    ASSERT_NE(-1, map.add_time_window(60, 20, collector.callback()));
+    // 第一个窗口起点不早于注册时间, 注册后等待一个窗口大小, 之后插入的数据都被完整的三个窗口覆盖
+    std::this_thread::sleep_for(std::chrono::milliseconds(70));
+
+    for (int i = 0; i < 10; ++i) {
+        map.insert(i, i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(7));
+    }
+    ASSERT_TRUE(collector.wait_past(map.get_by_order(1, false)[0].get_insert_time()));
+    // 最后一条数据还会出现在之后的两个窗口中
+    ASSERT_TRUE(collector.wait_past(map.get_by_order(1, false)[0].get_insert_time() + std::chrono::milliseconds(40)));
+
+    auto windows = collector.windows();
+    expect_well_formed(windows, 60, 20);
+    std::map<int, int> seen;
+    for (auto& window : windows) {
+        for (auto& entry : window.entries) {
+            ++seen[entry.get_key()];
+        }
+    }
+    ASSERT_EQ(10u, seen.size());
+    for (auto& item : seen) {
+        EXPECT_EQ(3, item.second) << "key " << item.first;
+    }
+}
+
+TEST(TimeWindowTest, RemovedEntriesAndLateInsertsAreNotInClosedWindows) {
+    SafeMap<int, int> map;
+    WindowCollector<int, int> collector;
+    ASSERT_NE(-1, map.add_time_window(50, 50, collector.callback()));
+
+    map.insert(1, 1);
+    map.insert(2, 2);
+    map.insert(3, 3, 5);
+    ASSERT_TRUE(map.erase_by_key(2));
+    auto first = map.get_by_order(1)[0].get_insert_time();
+    ASSERT_TRUE(collector.wait_past(first));
+
+    // 窗口关闭后才插入的数据进入之后的窗口
+    map.insert(4, 4);
+    auto late = map.get_by_order(1, false)[0].get_insert_time();
+    ASSERT_TRUE(collector.wait_past(late));
+
+    auto windows = collector.windows();
+    expect_well_formed(windows, 50, 50);
+    std::vector<int> keys;
+    for (auto& window : windows) {
+        for (auto& entry : window.entries) {
+            keys.push_back(entry.get_key());
+            if (entry.get_key() == 4) {
+                EXPECT_GT(window.start, first);
+            }
+        }
+    }
+    // 已删除和已过期的数据不发出
+    EXPECT_EQ(std::vector<int>({1, 4}), keys);
+}
+
+TEST(TimeWindowTest, CallbackGetsCopiesItCanMoveFrom) {
+    SafeMap<int, std::string> map;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<KeyValue<int, std::string>> moved;
+    int id = map.add_time_window(20, 20, [&](const TimeStamp&, const TimeStamp&, std::vector<KeyValue<int, std::string>>& entries) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& entry : entries) {
+            moved.push_back(std::move(entry));
+        }
+        cv.notify_all();
+    });
+    ASSERT_NE(-1, id);
+
+    std::string large(1000, 'x');
+    map.insert(1, large);
+    map.insert(2, "small");
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(2), [&] {
+            return moved.size() == 2;
+        }));
+    }
+    EXPECT_EQ(large, moved[0].get_value());
+    EXPECT_EQ("small", moved[1].get_value());
+
+    // 回调中移走的是副本, map中的数据不受影响
+    std::string value;
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(large, value);
+    ASSERT_TRUE(map.get_by_key(2, value));
+    EXPECT_EQ("small", value);
+
+    // 注销后不再回调
+    ASSERT_TRUE(map.remove_time_window(id));
+    EXPECT_FALSE(map.remove_time_window(id));
+    map.insert(3, "after");
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(2u, moved.size());
+}
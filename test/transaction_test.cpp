@@ -0,0 +1,118 @@
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+TEST(TransactionTest, CommitAppliesAllWrites) {
+    SafeMap<int, int> map;
+    map.insert(1, 10);
+
+    auto transaction = map.begin_transaction();
+    int value = 0;
+    ASSERT_TRUE(transaction.get(1, value));
+    transaction.put(1, value + 1);
+    transaction.put(2, 20);
+    EXPECT_TRUE(transaction.commit());
+
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(11, value);
+    ASSERT_TRUE(map.get_by_key(2, value));
+    EXPECT_EQ(20, value);
+}
+
+TEST(TransactionTest, VersionConflictAppliesNothing) {
+    SafeMap<int, int> map;
+    map.insert(1, 10);
+
+    auto transaction = map.begin_transaction();
+    int value = 0;
+    ASSERT_TRUE(transaction.get(1, value));
+    transaction.put(1, value + 1);
+    transaction.put(2, 20);
+
+    // 提交前另一个写入者修改了读过的key
+    ASSERT_TRUE(map.update_value(1, 100));
+    EXPECT_FALSE(transaction.commit());
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(100, value);
+    EXPECT_FALSE(map.get_by_key(2, value));
+
+    // 事务已清空, 重新读取后可以提交
+    ASSERT_TRUE(transaction.get(1, value));
+    transaction.put(1, value + 1);
+    EXPECT_TRUE(transaction.commit());
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(101, value);
+}
+
+TEST(TransactionTest, ReadOfMissingKeyConflictsWithInsert) {
+    SafeMap<int, int> map;
+
+    auto transaction = map.begin_transaction();
+    int value = 0;
+    EXPECT_FALSE(transaction.get(1, value));
+    transaction.put(1, 10);
+
+    ASSERT_TRUE(map.insert(1, 5));
+    EXPECT_FALSE(transaction.commit());
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(5, value);
+}
+
+TEST(CompareAndSetTest, ExpectedZeroFailsOnExistingKey) {
+    SafeMap<int, int> map;
+    uint64_t version = 0;
+    ASSERT_TRUE(map.insert(1, 10, -1, version));
+
+    uint64_t current = 0;
+    EXPECT_FALSE(map.compare_and_set(1, 0, 20, current));
+    EXPECT_EQ(version, current);
+    int value = 0;
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(10, value);
+
+    // 用当前版本号可以写入, 新版本号更大
+    uint64_t next = 0;
+    EXPECT_TRUE(map.compare_and_set(1, current, 30, next));
+    EXPECT_GT(next, current);
+    EXPECT_FALSE(map.compare_and_set(1, current, 40));
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(30, value);
+}
+
+TEST(CompareAndSetTest, ExpiredKeyCountsAsMissing) {
+    SafeMap<int, int> map;
+    uint64_t version = 0;
+    ASSERT_TRUE(map.insert(1, 10, 1, version));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // 已过期但还未被清理: 旧版本号不再匹配, 期望不存在时可以写入
+    EXPECT_FALSE(map.compare_and_set(1, version, 20));
+    EXPECT_FALSE(map.erase_if_version(1, version));
+    uint64_t new_version = 0;
+    EXPECT_TRUE(map.compare_and_set(1, 0, 30, new_version));
+    EXPECT_NE(0u, new_version);
+
+    // 写入的数据永不过期
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int value = 0;
+    uint64_t read_version = 0;
+    ASSERT_TRUE(map.get_by_key(1, value, read_version));
+    EXPECT_EQ(30, value);
+    EXPECT_EQ(new_version, read_version);
+}
+
+TEST(CompareAndSetTest, EraseIfVersion) {
+    SafeMap<int, int> map;
+    uint64_t version = 0;
+    ASSERT_TRUE(map.insert(1, 10, -1, version));
+
+    EXPECT_FALSE(map.erase_if_version(1, 0));
+    EXPECT_FALSE(map.erase_if_version(1, version + 1));
+    EXPECT_TRUE(map.erase_if_version(1, version));
+    int value = 0;
+    EXPECT_FALSE(map.get_by_key(1, value));
+    EXPECT_FALSE(map.erase_if_version(1, version));
+}
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <climits>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+#include "value_interner.h"
+
+namespace {
+
+using InternedMap = SafeMap<int, Interned<std::string>>;
+
+/*
+    * @brief 等待驻留表中的值释放到只剩remaining个
+    * 删除和替换只标记节点, 节点在tick线程全量检查时移出_queue后才释放值
+    * @return 期限内释放完成返回true
+*/
+bool released_in_time(ValueInterner<std::string>& interner, size_t remaining = 0) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (interner.size() != remaining && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return interner.size() == remaining;
+}
+
+}
+
+// 使用独立的驻留表, 不受其他测试中默认驻留表的影响
+TEST(ValueInternerTest, EqualValuesShareOnePointer) {
+    ValueInterner<std::string> interner;
+    InternedMap map;
+    map.insert(1, Interned<std::string>(interner.intern("shared")));
+    map.insert(2, Interned<std::string>(interner.intern("shared")));
+    map.insert(3, Interned<std::string>(interner.intern("other")));
+    EXPECT_EQ(2u, interner.size());
+
+    Interned<std::string> first;
+    Interned<std::string> second;
+    ASSERT_TRUE(map.get_by_key(1, first));
+    ASSERT_TRUE(map.get_by_key(2, second));
+    EXPECT_EQ("shared", first.get());
+    EXPECT_EQ(&first.get(), &second.get());
+    // map中的两份加上这里的两份
+    EXPECT_EQ(4, first.use_count());
+}
+
+TEST(ValueInternerTest, EraseReleasesValue) {
+    ValueInterner<std::string> interner;
+    InternedMap map;
+    map.insert(1, Interned<std::string>(interner.intern("value")));
+    map.insert(2, Interned<std::string>(interner.intern("value")));
+    EXPECT_EQ(1u, interner.size());
+
+    // 还有持有者时保留
+    ASSERT_TRUE(map.erase_by_key(1));
+    Interned<std::string> value;
+    ASSERT_TRUE(map.get_by_key(2, value));
+    EXPECT_EQ("value", value.get());
+    value = Interned<std::string>();
+    ASSERT_TRUE(map.erase_by_key(2));
+    EXPECT_TRUE(released_in_time(interner));
+}
+
+TEST(ValueInternerTest, UpdateReleasesOldValue) {
+    ValueInterner<std::string> interner;
+    InternedMap map;
+    map.insert(1, Interned<std::string>(interner.intern("old")));
+    ASSERT_TRUE(map.update_value(1, Interned<std::string>(interner.intern("new"))));
+    Interned<std::string> value;
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ("new", value.get());
+    value = Interned<std::string>();
+
+    // 只剩新值
+    EXPECT_TRUE(released_in_time(interner, 1));
+    ASSERT_TRUE(map.erase_by_key(1));
+    EXPECT_TRUE(released_in_time(interner));
+}
+
+TEST(ValueInternerTest, ExpiryReleasesValue) {
+    ValueInterner<std::string> interner;
+    InternedMap map;
+    map.insert(1, Interned<std::string>(interner.intern("short")), 1);
+    map.insert(2, Interned<std::string>(interner.intern("short")), 1);
+    EXPECT_EQ(1u, interner.size());
+
+    // 不访问map, 由tick线程清除过期数据
+    EXPECT_TRUE(released_in_time(interner));
+    EXPECT_TRUE(map.get_by_order(INT_MAX).empty());
+}
+
+TEST(ValueInternerTest, DestroyingMapReleasesValues) {
+    ValueInterner<std::string> interner;
+    {
+        InternedMap map;
+        for (int i = 0; i < 100; ++i) {
+            map.insert(i, Interned<std::string>(interner.intern(std::to_string(i % 10))));
+        }
+        EXPECT_EQ(10u, interner.size());
+    }
+    EXPECT_EQ(0u, interner.size());
+}
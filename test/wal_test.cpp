@@ -0,0 +1,216 @@
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+std::string temp_path(const std::string& name) {
+    std::string path = ::testing::TempDir() + name;
+    std::remove(path.c_str());
+    return path;
+}
+
+WalOptions every_batch() {
+    WalOptions options;
+    options.fsync_policy = WalFsyncPolicy::kEveryBatch;
+    return options;
+}
+
+void insert_range(SafeMap<int, int>& map, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        map.insert(i, i * 10);
+    }
+}
+
+void expect_range(SafeMap<int, int>& map, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        int value = 0;
+        EXPECT_TRUE(map.get_by_key(i, value)) << "key " << i;
+        EXPECT_EQ(i * 10, value);
+    }
+}
+
+}
+
+TEST(WalTest, RecoverTruncatesTornTailBeforeNewWrites) {
+    std::string wal_path = temp_path("wal_torn.log");
+    std::string snapshot_path = temp_path("wal_torn.snap");
+    {
+        SafeMap<int, int> map;
+        ASSERT_TRUE(map.enable_wal(wal_path, every_batch()));
+        insert_range(map, 0, 10);
+        ASSERT_TRUE(map.sync_wal());
+        map.disable_wal();
+    }
+
+    // 模拟崩溃时写了一半的记录: 长度声明为100字节, 实际只有3字节
+    FILE* file = std::fopen(wal_path.c_str(), "ab");
+    ASSERT_NE(nullptr, file);
+    uint32_t header[2] = {100, 0};
+    std::fwrite(header, sizeof(header), 1, file);
+    std::fwrite("abc", 3, 1, file);
+    std::fclose(file);
+
+    {
+        SafeMap<int, int> map;
+        ASSERT_TRUE(map.recover(snapshot_path, wal_path));
+        expect_range(map, 0, 10);
+        ASSERT_TRUE(map.enable_wal(wal_path, every_batch()));
+        insert_range(map, 10, 20);
+        ASSERT_TRUE(map.erase_by_key(3));
+        ASSERT_TRUE(map.sync_wal());
+        map.disable_wal();
+    }
+
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.recover(snapshot_path, wal_path));
+    expect_range(map, 0, 3);
+    expect_range(map, 4, 20);
+    int value;
+    EXPECT_FALSE(map.get_by_key(3, value));
+    std::remove(wal_path.c_str());
+}
+
+TEST(WalTest, RecoverWithoutLogStartsEmpty) {
+    SafeMap<int, int> map;
+    EXPECT_TRUE(map.recover(temp_path("wal_none.snap"), temp_path("wal_none.log")));
+    EXPECT_TRUE(map.get_by_order(1).empty());
+}
+
+TEST(WalTest, FailedWriteIsReportedBySync) {
+    // /dev/full上的写入总是返回ENOSPC
+    WriteAheadLog wal;
+    ASSERT_TRUE(wal.open("/dev/full", every_batch()));
+    EXPECT_TRUE(wal.append("record"));
+    EXPECT_FALSE(wal.sync());
+    EXPECT_FALSE(wal.append("after failure"));
+    EXPECT_FALSE(wal.sync());
+}
+
+TEST(WalTest, FailedGroupCommitIsReportedByNextAppend) {
+    WalOptions options = every_batch();
+    options.group_commit_interval_ms = 1;
+    WriteAheadLog wal;
+    ASSERT_TRUE(wal.open("/dev/full", options));
+    EXPECT_TRUE(wal.append("record"));
+
+    // 等待组提交线程写入失败
+    bool failed = false;
+    for (int i = 0; i < 1000 && !failed; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        failed = !wal.append("probe");
+    }
+    EXPECT_TRUE(failed);
+    EXPECT_FALSE(wal.sync());
+}
+
+TEST(WalTest, MapRefusesWritesAfterLogFails) {
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.enable_wal("/dev/full", every_batch()));
+    ASSERT_TRUE(map.insert(1, 10));
+    EXPECT_TRUE(map.wal_healthy());
+    EXPECT_FALSE(map.sync_wal());
+    EXPECT_FALSE(map.wal_healthy());
+
+    // 日志失败后的修改都被拒绝, 内存中的数据保持不变
+    uint64_t version = 0;
+    int value = 0;
+    ASSERT_TRUE(map.get_by_key(1, value, version));
+    EXPECT_FALSE(map.insert(2, 20));
+    EXPECT_FALSE(map.erase_by_key(1));
+    EXPECT_FALSE(map.update_value(1, 11));
+    EXPECT_FALSE(map.compare_and_set(1, version, 12));
+    EXPECT_EQ(0, map.set_ttl_batch({1}, 1000));
+    EXPECT_TRUE(map.drain_by_order(1).empty());
+    EXPECT_FALSE(map.get_by_key(2, value));
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(10, value);
+
+    // 重新开启日志后恢复
+    std::string wal_path = temp_path("wal_reopen.log");
+    ASSERT_TRUE(map.enable_wal(wal_path));
+    EXPECT_TRUE(map.wal_healthy());
+    EXPECT_TRUE(map.insert(2, 20));
+    EXPECT_TRUE(map.sync_wal());
+    map.disable_wal();
+    std::remove(wal_path.c_str());
+}
+
+TEST(WalTest, RecoverReplaysLogAfterSnapshot) {
+    std::string wal_path = temp_path("wal_snapshot.log");
+    std::string empty_snapshot = temp_path("wal_snapshot_empty.snap");
+    std::string snapshot_path = temp_path("wal_snapshot.snap");
+    {
+        SafeMap<int, int> map;
+        ASSERT_TRUE(map.enable_wal(wal_path, every_batch()));
+        // 序号为0的快照: 加载后序号会前进, 重放日志仍要从序号1开始
+        ASSERT_TRUE(map.save_snapshot(empty_snapshot));
+        insert_range(map, 0, 10);
+        ASSERT_TRUE(map.save_snapshot(snapshot_path));
+        insert_range(map, 10, 20);
+        ASSERT_TRUE(map.sync_wal());
+        map.disable_wal();
+    }
+
+    for (auto& path : {empty_snapshot, snapshot_path}) {
+        SafeMap<int, int> map;
+        ASSERT_TRUE(map.recover(path, wal_path));
+        expect_range(map, 0, 20);
+        std::remove(path.c_str());
+    }
+    std::remove(wal_path.c_str());
+}
+
+TEST(WalTest, RejectsNonPositiveGroupCommitInterval) {
+    std::string wal_path = temp_path("wal_interval.log");
+    WalOptions options;
+    options.group_commit_interval_ms = 0;
+    WriteAheadLog wal;
+    EXPECT_FALSE(wal.open(wal_path, options));
+    options.group_commit_interval_ms = -1;
+    EXPECT_FALSE(wal.open(wal_path, options));
+
+    // 开启失败时保留已开启的日志
+    SafeMap<int, int> map;
+    ASSERT_TRUE(map.enable_wal(wal_path, every_batch()));
+    EXPECT_FALSE(map.enable_wal(wal_path, options));
+    EXPECT_TRUE(map.insert(1, 10));
+    EXPECT_TRUE(map.sync_wal());
+    map.disable_wal();
+    std::remove(wal_path.c_str());
+}
+
+TEST(WalTest, SwitchingLogFlushesTheOldOne) {
+    std::string first_path = temp_path("wal_switch_1.log");
+    std::string second_path = temp_path("wal_switch_2.log");
+    std::string snapshot_path = temp_path("wal_switch.snap");
+    {
+        // 组提交间隔很长, 记录只会在关闭旧日志时写入
+        WalOptions options;
+        options.group_commit_interval_ms = 600000;
+        SafeMap<int, int> map;
+        ASSERT_TRUE(map.enable_wal(first_path, options));
+        insert_range(map, 0, 10);
+        ASSERT_TRUE(map.enable_wal(second_path, every_batch()));
+        insert_range(map, 10, 20);
+        ASSERT_TRUE(map.sync_wal());
+        map.disable_wal();
+    }
+
+    SafeMap<int, int> first;
+    ASSERT_TRUE(first.recover(snapshot_path, first_path));
+    expect_range(first, 0, 10);
+    int value;
+    EXPECT_FALSE(first.get_by_key(10, value));
+
+    SafeMap<int, int> second;
+    ASSERT_TRUE(second.recover(snapshot_path, second_path));
+    expect_range(second, 10, 20);
+    EXPECT_FALSE(second.get_by_key(0, value));
+    std::remove(first_path.c_str());
+    std::remove(second_path.c_str());
+}
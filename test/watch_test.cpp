@@ -0,0 +1,237 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+using SteadyClock = std::chrono::steady_clock;
+
+/*
+    * @brief 收集监听回调, 回调在通知线程中执行
+*/
+class Collector {
+public:
+    void push(int key, int value) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _events.emplace_back(key, value);
+        _cv.notify_all();
+    }
+
+    /*
+        * @brief 等待至少count条通知
+        * @return 期限内等到返回true
+    */
+    bool wait_for(size_t count, int timeout_ms = 2000) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, count] {
+            return _events.size() >= count;
+        });
+    }
+
+    std::vector<std::pair<int, int>> events() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _events;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<std::pair<int, int>> _events;
+};
+
+}
+
+TEST(WatchTest, WaitForKeyReturnsExistingOrTimesOut) {
+    SafeMap<int, int> map;
+    map.insert(1, 10);
+
+    int value = 0;
+    ASSERT_TRUE(map.wait_for_key(1, value, 0));
+    EXPECT_EQ(10, value);
+
+    auto start = SteadyClock::now();
+    EXPECT_FALSE(map.wait_for_key(2, value, 50));
+    EXPECT_GE(SteadyClock::now() - start, std::chrono::milliseconds(50));
+
+    // 已过期的数据视为不存在
+    map.insert(3, 30, 10);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(map.wait_for_key(3, value, 20));
+}
+
+TEST(WatchTest, WaitForKeyWakesOnInsert) {
+    SafeMap<int, int> map;
+    std::atomic<bool> inserted(false);
+    std::atomic<bool> woke_early(false);
+    int value = 0;
+    bool found = false;
+    std::thread waiter([&] {
+        found = map.wait_for_key(7, value, -1);
+        woke_early = !inserted;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    // 同一分片上其他key的插入不会让等待者返回
+    for (int i = 0; i < 200; ++i) {
+        if (i != 7) {
+            map.insert(i, i);
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    inserted = true;
+    map.insert(7, 70);
+    waiter.join();
+
+    EXPECT_TRUE(found);
+    EXPECT_FALSE(woke_early);
+    EXPECT_EQ(70, value);
+}
+
+TEST(WatchTest, WaitForVersionWakesOnUpdateOnly) {
+    SafeMap<int, int> map;
+    uint64_t first;
+    ASSERT_TRUE(map.insert(1, 10, 600000, first));
+
+    // 已知版本之后没有新版本, 修改过期时间不产生新版本
+    int value = 0;
+    uint64_t version = 0;
+    EXPECT_EQ(1, map.set_ttl_batch({1}, 900000));
+    EXPECT_FALSE(map.wait_for_version(1, first, value, version, 30));
+    EXPECT_EQ(0u, version);
+
+    std::thread writer([&map] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        map.update_value(1, 11);
+    });
+    ASSERT_TRUE(map.wait_for_version(1, first, value, version, 2000));
+    writer.join();
+    EXPECT_EQ(11, value);
+    EXPECT_GT(version, first);
+
+    // 更早的版本立即返回当前数据
+    ASSERT_TRUE(map.wait_for_version(1, 0, value, version, 0));
+    EXPECT_EQ(11, value);
+}
+
+TEST(WatchTest, CallbacksArriveInOrderUntilUnwatch) {
+    SafeMap<int, int> map;
+    Collector collector;
+    int id = map.watch(1, [&collector](const KeyValue<int, int>& entry) {
+        collector.push(entry.get_key(), entry.get_value());
+    });
+
+    map.insert(1, 10);
+    map.insert(2, 20);
+    map.update_value(1, 11);
+    map.erase_by_key(1);
+    map.insert(1, 12);
+    ASSERT_TRUE(collector.wait_for(3));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::vector<std::pair<int, int>> expected = {{1, 10}, {1, 11}, {1, 12}};
+    EXPECT_EQ(expected, collector.events());
+
+    EXPECT_TRUE(map.unwatch(id));
+    EXPECT_FALSE(map.unwatch(id));
+    map.update_value(1, 13);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(3u, collector.events().size());
+}
+
+TEST(WatchTest, CallbackCanCallBackIntoTheMap) {
+    SafeMap<int, int> map;
+    Collector collector;
+    // 回调在不持有锁的情况下执行, 可以读写同一个map
+    map.watch(1, [&map, &collector](const KeyValue<int, int>& entry) {
+        int value = 0;
+        map.get_by_key(entry.get_key(), value);
+        map.insert(100 + entry.get_value(), value);
+        collector.push(entry.get_key(), value);
+    });
+    map.insert(1, 5);
+    ASSERT_TRUE(collector.wait_for(1));
+
+    int value = 0;
+    int mirrored = 0;
+    ASSERT_TRUE(map.wait_for_key(105, mirrored, 2000));
+    ASSERT_TRUE(map.get_by_key(1, value));
+    EXPECT_EQ(value, mirrored);
+}
+
+TEST(WatchTest, DestructorReleasesBlockedWaiter) {
+    std::unique_ptr<SafeMap<int, int>> map(new SafeMap<int, int>());
+    std::atomic<bool> returned(false);
+    bool found = true;
+    std::thread waiter([&] {
+        int value;
+        found = map->wait_for_key(1, value, -1);
+        returned = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_FALSE(returned);
+
+    // 析构函数唤醒等待者并等待它离开
+    map.reset();
+    auto deadline = SteadyClock::now() + std::chrono::seconds(2);
+    while (!returned && SteadyClock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!returned) {
+        waiter.detach();
+        FAIL() << "wait_for_key did not return after the map was destroyed";
+    }
+    waiter.join();
+    EXPECT_FALSE(found);
+}
+
+TEST(WatchTest, DestructorWaitsForRunningCallbackAndDropsPending) {
+    std::unique_ptr<SafeMap<int, int>> map(new SafeMap<int, int>());
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool entered = false;
+    bool release = false;
+    std::atomic<int> calls(0);
+    std::atomic<bool> finished(false);
+    map->watch(1, [&](const KeyValue<int, int>&) {
+        ++calls;
+        std::unique_lock<std::mutex> lock(mutex);
+        entered = true;
+        cv.notify_all();
+        cv.wait(lock, [&] {
+            return release;
+        });
+        finished = true;
+    });
+
+    map->insert(1, 1);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(2), [&] {
+            return entered;
+        }));
+    }
+    // 回调执行期间产生的通知排在队列中
+    map->update_value(1, 2);
+    map->update_value(1, 3);
+
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+        cv.notify_all();
+    });
+    map.reset();
+    // 析构函数返回时正在执行的回调已经结束, 排队的通知被丢弃
+    EXPECT_TRUE(finished);
+    EXPECT_EQ(1, calls);
+    releaser.join();
+}
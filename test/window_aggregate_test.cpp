@@ -0,0 +1,197 @@
+#include <chrono>
+#include <climits>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "safe_map.h"
+
+namespace {
+
+/*
+    * @brief 等待聚合结果中的count变为expected, 过期数据由tick线程删除
+    * @return 期限内等到返回true
+*/
+template<typename K, typename V>
+bool wait_for_count(SafeMap<K, V>& map, int id, int expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    WindowAggregateResult result;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (map.get_window_aggregate(id, result) && result.count == expected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+double average(const WindowAggregateResult& result) {
+    return result.count == 0 ? 0 : result.sum / result.count;
+}
+
+}
+
+TEST(WindowAggregateTest, TracksInsertsAndErases) {
+    SafeMap<int, int> map;
+    int id = map.add_window_aggregate(600000);
+    WindowAggregateResult result;
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(0, result.count);
+    EXPECT_DOUBLE_EQ(0, result.sum);
+
+    for (int i = 1; i <= 10; ++i) {
+        map.insert(i, i * 10);
+    }
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(10, result.count);
+    EXPECT_DOUBLE_EQ(550, result.sum);
+    EXPECT_DOUBLE_EQ(10, result.min);
+    EXPECT_DOUBLE_EQ(100, result.max);
+    EXPECT_DOUBLE_EQ(55, average(result));
+
+    // 删除最小值和最大值, 重复的值只删除一份
+    map.insert(11, 50);
+    ASSERT_TRUE(map.erase_by_key(1));
+    ASSERT_TRUE(map.erase_by_key(10));
+    ASSERT_TRUE(map.erase_by_key(5));
+    EXPECT_FALSE(map.erase_by_key(10));
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(8, result.count);
+    EXPECT_DOUBLE_EQ(440, result.sum);
+    EXPECT_DOUBLE_EQ(20, result.min);
+    EXPECT_DOUBLE_EQ(90, result.max);
+
+    // 覆盖旧值
+    ASSERT_TRUE(map.update_value(2, 1000));
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(8, result.count);
+    EXPECT_DOUBLE_EQ(1420, result.sum);
+    EXPECT_DOUBLE_EQ(30, result.min);
+    EXPECT_DOUBLE_EQ(1000, result.max);
+
+    ASSERT_TRUE(map.remove_window_aggregate(id));
+    EXPECT_FALSE(map.remove_window_aggregate(id));
+    EXPECT_FALSE(map.get_window_aggregate(id, result));
+}
+
+TEST(WindowAggregateTest, OldEntriesSlideOut) {
+    SafeMap<int, int> map;
+    int id = map.add_window_aggregate(100);
+    map.insert(1, 1);
+    map.insert(2, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    map.insert(3, 3);
+
+    // 滑出窗口的数据仍在map中, 只是不再参与聚合
+    WindowAggregateResult result;
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(1, result.count);
+    EXPECT_DOUBLE_EQ(3, result.sum);
+    EXPECT_DOUBLE_EQ(3, result.min);
+    int value;
+    EXPECT_TRUE(map.get_by_key(1, value));
+
+    // 滑出后再删除不会被减去两次
+    ASSERT_TRUE(map.erase_by_key(1));
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(1, result.count);
+    EXPECT_DOUBLE_EQ(3, result.sum);
+}
+
+TEST(WindowAggregateTest, ExpiredEntriesLeaveAndExtendedTtlKeeps) {
+    SafeMap<int, int> map;
+    int id = map.add_window_aggregate(600000);
+    map.insert(1, 1, 50);
+    map.insert(2, 2, 50);
+    map.insert(3, 3, 50);
+    map.insert(4, 4);
+
+    // 延长过期时间的数据不会在原来的过期时间被移出
+    EXPECT_EQ(1, map.set_ttl_batch({2}, 600000));
+    auto all = map.get_by_order(INT_MAX);
+    ASSERT_EQ(4u, all.size());
+    EXPECT_EQ(1, map.extend_ttl_by_time_range(all[2].get_insert_time(), all[3].get_insert_time(), 600000));
+
+    ASSERT_TRUE(wait_for_count(map, id, 3));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    WindowAggregateResult result;
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(3, result.count);
+    EXPECT_DOUBLE_EQ(9, result.sum);
+    EXPECT_DOUBLE_EQ(2, result.min);
+    EXPECT_DOUBLE_EQ(4, result.max);
+    EXPECT_DOUBLE_EQ(3, average(result));
+
+    // 缩短过期时间后同样会被移出
+    EXPECT_EQ(1, map.set_ttl_batch({4}, 10));
+    ASSERT_TRUE(wait_for_count(map, id, 2));
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_DOUBLE_EQ(5, result.sum);
+    EXPECT_DOUBLE_EQ(3, result.max);
+}
+
+TEST(WindowAggregateTest, DrainRemovesEntries) {
+    SafeMap<int, int> map;
+    int id = map.add_window_aggregate(600000);
+    for (int i = 1; i <= 10; ++i) {
+        map.insert(i, i);
+    }
+
+    EXPECT_EQ(3u, map.drain_by_order(3).size());
+    WindowAggregateResult result;
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(7, result.count);
+    EXPECT_DOUBLE_EQ(49, result.sum);
+    EXPECT_DOUBLE_EQ(4, result.min);
+
+    EXPECT_EQ(2u, map.drain_by_order(2, false).size());
+    auto all = map.get_by_order(INT_MAX);
+    ASSERT_EQ(5u, all.size());
+    EXPECT_EQ(2u, map.drain_by_time_range(all[0].get_insert_time(), all[1].get_insert_time()).size());
+    ASSERT_TRUE(map.get_window_aggregate(id, result));
+    EXPECT_EQ(3, result.count);
+    EXPECT_DOUBLE_EQ(6 + 7 + 8, result.sum);
+    EXPECT_DOUBLE_EQ(6, result.min);
+    EXPECT_DOUBLE_EQ(8, result.max);
+}
+
+TEST(WindowAggregateTest, SeedsFromPopulatedMap) {
+    SafeMap<int, std::string> map;
+    map.insert(1, "a");
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    map.insert(2, "bb");
+    map.insert(3, "ccc");
+    map.insert(4, "dddd", 10);
+    map.insert(5, "eeeee");
+    ASSERT_TRUE(map.erase_by_key(5));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // 注册时已过期、已删除或不在窗口内的数据都不参与初始化
+    auto length = [](const std::string& value) {
+        return static_cast<double>(value.size());
+    };
+    int recent = map.add_window_aggregate(100, length);
+    int all = map.add_window_aggregate(600000, length);
+    EXPECT_NE(recent, all);
+
+    WindowAggregateResult result;
+    ASSERT_TRUE(map.get_window_aggregate(recent, result));
+    EXPECT_EQ(2, result.count);
+    EXPECT_DOUBLE_EQ(5, result.sum);
+    EXPECT_DOUBLE_EQ(2, result.min);
+    EXPECT_DOUBLE_EQ(3, result.max);
+    ASSERT_TRUE(map.get_window_aggregate(all, result));
+    EXPECT_EQ(3, result.count);
+    EXPECT_DOUBLE_EQ(6, result.sum);
+    EXPECT_DOUBLE_EQ(1, result.min);
+
+    // 初始化后继续增量更新
+    map.insert(6, "ffffff");
+    ASSERT_TRUE(map.erase_by_key(1));
+    ASSERT_TRUE(map.get_window_aggregate(all, result));
+    EXPECT_EQ(3, result.count);
+    EXPECT_DOUBLE_EQ(11, result.sum);
+    EXPECT_DOUBLE_EQ(2, result.min);
+    EXPECT_DOUBLE_EQ(6, result.max);
+}